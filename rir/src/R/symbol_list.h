@@ -58,8 +58,20 @@
     V(Missing, "missing")                                                      \
     V(seq, "seq")                                                              \
     V(lapply, "lapply")                                                        \
+    V(sapply, "sapply")                                                        \
+    V(simplify2array, "simplify2array")                                        \
+    V(FUN, "FUN")                                                              \
+    V(X, "X")                                                                  \
+    V(i, "i")                                                                  \
+    V(answer, "answer")                                                        \
+    V(higher, "higher")                                                        \
     V(aslist, "as.list")                                                       \
     V(isvector, "is.vector")                                                   \
+    V(ischaracter, "is.character")                                             \
+    V(Length, "length")                                                        \
+    V(List, "list")                                                            \
+    V(Vector, "vector")                                                        \
+    V(NamesAssign, "names<-")                                                  \
     V(substr, "substr")                                                        \
     V(Class, "class")                                                          \
     V(OldClass, "oldClass")                                                    \
@@ -12,11 +12,14 @@
 #include "compiler/translations/pir_2_rir/pir_2_rir.h"
 #include "compiler/translations/rir_2_pir/rir_2_pir.h"
 #include "compiler/translations/rir_2_pir/rir_2_pir_compiler.h"
+#include "interpreter/CodeCache.h"
+#include "interpreter/CompilationQueue.h"
 #include "interpreter/interp_incl.h"
 #include "ir/BC.h"
 #include "ir/Compiler.h"
 
 #include <list>
+#include <map>
 #include <memory>
 #include <string>
 
@@ -65,9 +68,13 @@ REXPORT SEXP rir_compile(SEXP what, SEXP env) {
         SEXP body = BODY(what);
         if (TYPEOF(body) == EXTERNALSXP)
             return what;
+        SEXP ast = body;
+        if (TYPEOF(body) == BCODESXP)
+            ast = VECTOR_ELT(CDR(body), 0);
 
         // Change the input closure inplace
         Compiler::compileClosure(what);
+        CodeCache::install(what, ast);
 
         return what;
     } else {
@@ -204,8 +211,47 @@ REXPORT SEXP pir_setDebugFlags(SEXP debugFlags) {
     return R_NilValue;
 }
 
+size_t pir::Parameter::MODULE_CACHE_BYTES =
+    getenv("PIR_MODULE_CACHE_BYTES") ? atol(getenv("PIR_MODULE_CACHE_BYTES"))
+                                     : 16 << 20;
+
+// Optimized versions are kept across compilations in a module per tier, see
+// pir::Module. After a deopt the feedback they were compiled with is stale,
+// thus the modules are dropped before the next compilation. They are dropped
+// as well once something they refer to was collected, or once they use more
+// than MODULE_CACHE_BYTES.
+static std::map<FunctionSignature::OptimizationLevel, pir::Module*> modules;
+static bool modulesStale = false;
+
+void pirInvalidateModules() { modulesStale = true; }
+
+// The module and what it refers to in pinned, which has to be protected
+// during the compilation
+static pir::Module* persistentModule(FunctionSignature::OptimizationLevel tier,
+                                     SEXP& pinned) {
+    if (modulesStale) {
+        for (auto& m : modules)
+            delete m.second;
+        modules.clear();
+        modulesStale = false;
+    }
+    auto& m = modules[tier];
+    pinned = R_NilValue;
+    if (m && m->memoryUsage() <= pir::Parameter::MODULE_CACHE_BYTES)
+        if (SEXP p = m->pin())
+            pinned = p;
+    if (m && pinned == R_NilValue) {
+        delete m;
+        m = nullptr;
+    }
+    if (!m)
+        m = new pir::Module;
+    return m;
+}
+
 SEXP pirCompile(SEXP what, const Assumptions& assumptions,
-                const std::string& name, const pir::DebugOptions& debug) {
+                const std::string& name, const pir::DebugOptions& debug,
+                FunctionSignature::OptimizationLevel tier) {
 
     if (!isValidClosureSEXP(what)) {
         Rf_error("not a compiled closure");
@@ -218,17 +264,20 @@ SEXP pirCompile(SEXP what, const Assumptions& assumptions,
 
     bool dryRun = debug.includes(pir::DebugFlag::DryRun);
     // compile to pir
-    pir::Module* m = new pir::Module;
+    SEXP pinned;
+    pir::Module* m = persistentModule(tier, pinned);
+    PROTECT(pinned);
     pir::StreamLogger logger(debug);
     logger.title("Compiling " + name);
-    pir::Rir2PirCompiler cmp(m, logger);
+    pir::Rir2PirCompiler cmp(m, logger, tier);
     cmp.compileClosure(what, name, assumptions,
                        [&](pir::ClosureVersion* c) {
                            logger.flush();
                            cmp.optimizeModule();
+                           m->markOptimized();
 
                            // compile back to rir
-                           pir::Pir2RirCompiler p2r(logger);
+                           pir::Pir2RirCompiler p2r(logger, tier);
                            auto fun = p2r.compile(c, dryRun);
 
                            // Install
@@ -237,15 +286,47 @@ SEXP pirCompile(SEXP what, const Assumptions& assumptions,
 
                            Protect p(fun->container());
                            DispatchTable::unpack(BODY(what))->insert(fun);
+                           CodeCache::remember(what);
                        },
                        [&]() {
                            if (debug.includes(pir::DebugFlag::ShowWarnings))
                                std::cerr << "Compilation failed\n";
                        });
 
+    UNPROTECT(2);
+    return what;
+}
+
+rir::Function* pirCompileContinuation(SEXP what, const Assumptions& assumptions,
+                                      const std::string& name, Opcode* entry,
+                                      size_t stackSize,
+                                      const pir::DebugOptions& debug) {
+    assert(isValidClosureSEXP(what) && DispatchTable::check(BODY(what)));
+
+    PROTECT(what);
+
+    rir::Function* res = nullptr;
+    pir::Module* m = new pir::Module;
+    pir::StreamLogger logger(debug);
+    logger.title("Compiling continuation of " + name);
+    pir::Rir2PirCompiler cmp(m, logger);
+    cmp.compileContinuation(what, name, entry, stackSize, assumptions,
+                            [&](pir::ClosureVersion* c) {
+                                logger.flush();
+                                cmp.optimizeModule();
+
+                                pir::Pir2RirCompiler p2r(logger);
+                                res = p2r.compile(c, false);
+                            },
+                            [&]() {
+                                if (debug.includes(
+                                        pir::DebugFlag::ShowWarnings))
+                                    std::cerr << "Compilation failed\n";
+                            });
+
     delete m;
     UNPROTECT(1);
-    return what;
+    return res;
 }
 
 // Used in test infrastructure for counting invocation of different versions
@@ -263,6 +344,102 @@ REXPORT SEXP rir_invocation_count(SEXP what) {
     return res;
 }
 
+// Number of deopts of the optimized versions, by reason
+REXPORT SEXP rir_deopt_count(SEXP what) {
+    if (!isValidClosureSEXP(what)) {
+        Rf_error("not a compiled closure");
+    }
+    auto dt = DispatchTable::check(BODY(what));
+    assert(dt);
+
+    SEXP res = PROTECT(Rf_allocVector(INTSXP, DeoptReason::NumReasons));
+    SEXP names = PROTECT(Rf_allocVector(STRSXP, DeoptReason::NumReasons));
+    for (size_t i = 0; i < DeoptReason::NumReasons; ++i) {
+        auto reason = (DeoptReason::Reason)i;
+        INTEGER(res)[i] = dt->deoptCount(reason);
+        SET_STRING_ELT(names, i, Rf_mkChar(DeoptReason::name(reason)));
+    }
+    Rf_setAttrib(res, R_NamesSymbol, names);
+    UNPROTECT(2);
+    return res;
+}
+
+// Number of calls until the closure is optimized again after deopts
+REXPORT SEXP rir_compile_backoff(SEXP what) {
+    if (!isValidClosureSEXP(what)) {
+        Rf_error("not a compiled closure");
+    }
+    auto dt = DispatchTable::check(BODY(what));
+    assert(dt);
+    return Rf_ScalarInteger(dt->compileBackoff());
+}
+
+// The type feedback recorded in the body of the baseline version, one list
+// per record_type_ instruction in order
+REXPORT SEXP rir_type_feedback(SEXP what) {
+    if (!isValidClosureSEXP(what)) {
+        Rf_error("not a compiled closure");
+    }
+    auto dt = DispatchTable::check(BODY(what));
+    assert(dt);
+    Code* code = dt->baseline()->body();
+
+    std::vector<ObservedValues> records;
+    for (Opcode* pc = code->code(); pc < code->endCode(); pc = BC::next(pc)) {
+        if (*pc == Opcode::record_type_)
+            records.push_back(BC::decodeShallow(pc).immediate.typeFeedback);
+    }
+
+    const char* fields[] = {"types", "maxLength", "maybeNA", "value", "class",
+                            ""};
+    SEXP res = PROTECT(Rf_allocVector(VECSXP, records.size()));
+    for (size_t i = 0; i < records.size(); ++i) {
+        auto& feedback = records[i];
+        SEXP record = Rf_mkNamed(VECSXP, fields);
+        SET_VECTOR_ELT(res, i, record);
+
+        SEXP types = Rf_allocVector(STRSXP, feedback.numTypes);
+        SET_VECTOR_ELT(record, 0, types);
+        for (size_t t = 0; t < feedback.numTypes; ++t)
+            SET_STRING_ELT(types, t,
+                           Rf_mkChar(Rf_type2char(feedback.seen[t].sexptype)));
+        int maxLength = feedback.maxLength;
+        if (feedback.maxLength == ObservedValues::LengthOverflow)
+            maxLength = NA_INTEGER;
+        SET_VECTOR_ELT(record, 1, Rf_ScalarInteger(maxLength));
+        SET_VECTOR_ELT(record, 2, Rf_ScalarLogical(feedback.maybeNA));
+        if (feedback.stableValue)
+            SET_VECTOR_ELT(record, 3, feedback.getValue(code));
+        if (feedback.stableClass)
+            SET_VECTOR_ELT(record, 4, feedback.getClass(code));
+    }
+    UNPROTECT(1);
+    return res;
+}
+
+REXPORT SEXP rir_pool_size() {
+    SEXP res = PROTECT(Rf_allocVector(INTSXP, 2));
+    SEXP names = PROTECT(Rf_allocVector(STRSXP, 2));
+    INTEGER(res)[0] = Pool::size();
+    INTEGER(res)[1] = Pool::srcSize();
+    SET_STRING_ELT(names, 0, Rf_mkChar("constants"));
+    SET_STRING_ELT(names, 1, Rf_mkChar("sources"));
+    Rf_setAttrib(res, R_NamesSymbol, names);
+    UNPROTECT(2);
+    return res;
+}
+
+REXPORT SEXP rir_compilation_queue_size() {
+    return Rf_ScalarInteger(compilationQueue().size());
+}
+
+REXPORT SEXP rir_codeCacheExport() { return CodeCache::exportCache(); }
+
+REXPORT SEXP rir_codeCacheImport(SEXP cache) {
+    CodeCache::importCache(cache);
+    return R_NilValue;
+}
+
 REXPORT SEXP pir_compile(SEXP what, SEXP name, SEXP debugFlags,
                          SEXP debugStyle) {
     if (debugFlags != R_NilValue &&
@@ -335,27 +512,37 @@ REXPORT SEXP pir_check(SEXP f, SEXP checksSxp, SEXP env) {
     return res ? R_TrueValue : R_FalseValue;
 }
 
-SEXP rirOptDefaultOpts(SEXP closure, const Assumptions& assumptions,
-                       SEXP name) {
+SEXP rirOptDefaultOpts(SEXP closure, const Assumptions& assumptions, SEXP name,
+                       FunctionSignature::OptimizationLevel tier) {
     std::string n = "";
     if (TYPEOF(name) == SYMSXP)
         n = CHAR(PRINTNAME(name));
     // PIR can only optimize closures, not expressions
     if (isValidClosureSEXP(closure))
-        return pirCompile(closure, assumptions, n, PirDebug);
+        return pirCompile(closure, assumptions, n, PirDebug, tier);
     else
         return closure;
 }
 
+rir::Function* rirOptContinuation(SEXP closure, const Assumptions& assumptions,
+                                  SEXP name, Opcode* entry, size_t stackSize) {
+    std::string n = "";
+    if (TYPEOF(name) == SYMSXP)
+        n = CHAR(PRINTNAME(name));
+    return pirCompileContinuation(closure, assumptions, n, entry, stackSize,
+                                  PirDebug);
+}
+
 SEXP rirOptDefaultOptsDryrun(SEXP closure, const Assumptions& assumptions,
-                             SEXP name) {
+                             SEXP name,
+                             FunctionSignature::OptimizationLevel tier) {
     std::string n = "";
     if (TYPEOF(name) == SYMSXP)
         n = CHAR(PRINTNAME(name));
     // PIR can only optimize closures, not expressions
     if (isValidClosureSEXP(closure))
         return pirCompile(closure, assumptions, n,
-                          PirDebug | pir::DebugFlag::DryRun);
+                          PirDebug | pir::DebugFlag::DryRun, tier);
     else
         return closure;
 }
@@ -4,25 +4,49 @@
 #include "R/r.h"
 #include "compiler/debugging/debugging.h"
 #include "runtime/Assumptions.h"
+#include "runtime/FunctionSignature.h"
 #include <stdint.h>
 
 #define REXPORT extern "C"
 
+namespace rir {
+struct Function;
+enum class Opcode : uint8_t;
+} // namespace rir
+
 extern int R_ENABLE_JIT;
 extern rir::pir::DebugOptions PirDebug;
 
 REXPORT SEXP rir_invocation_count(SEXP what);
+REXPORT SEXP rir_deopt_count(SEXP what);
+REXPORT SEXP rir_pool_size();
 REXPORT SEXP rir_eval(SEXP exp, SEXP env);
 REXPORT SEXP pir_compile(SEXP closure, SEXP name, SEXP debugFlags,
                          SEXP debugStyle);
 REXPORT SEXP rir_compile(SEXP what, SEXP env);
+REXPORT SEXP rir_codeCacheExport();
+REXPORT SEXP rir_codeCacheImport(SEXP cache);
 REXPORT SEXP pir_tests();
 REXPORT SEXP pir_check(SEXP f, SEXP check, SEXP env);
 REXPORT SEXP pir_setDebugFlags(SEXP debugFlags);
 SEXP pirCompile(SEXP closure, const rir::Assumptions& assumptions,
-                const std::string& name, const rir::pir::DebugOptions& debug);
-extern SEXP rirOptDefaultOpts(SEXP closure, const rir::Assumptions&, SEXP name);
-extern SEXP rirOptDefaultOptsDryrun(SEXP closure, const rir::Assumptions&,
-                                    SEXP name);
+                const std::string& name, const rir::pir::DebugOptions& debug,
+                rir::FunctionSignature::OptimizationLevel tier =
+                    rir::FunctionSignature::OptimizationLevel::Optimized);
+extern SEXP rirOptDefaultOpts(SEXP closure, const rir::Assumptions&, SEXP name,
+                              rir::FunctionSignature::OptimizationLevel tier);
+// Drops the optimized versions kept across compilations, eg. after a deopt
+void pirInvalidateModules();
+rir::Function* pirCompileContinuation(SEXP closure,
+                                      const rir::Assumptions& assumptions,
+                                      const std::string& name,
+                                      rir::Opcode* entry, size_t stackSize,
+                                      const rir::pir::DebugOptions& debug);
+extern rir::Function* rirOptContinuation(SEXP closure, const rir::Assumptions&,
+                                         SEXP name, rir::Opcode* entry,
+                                         size_t stackSize);
+extern SEXP rirOptDefaultOptsDryrun(
+    SEXP closure, const rir::Assumptions&, SEXP name,
+    rir::FunctionSignature::OptimizationLevel tier);
 
 #endif // API_H_
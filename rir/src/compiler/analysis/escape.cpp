@@ -0,0 +1,60 @@
+#include "escape.h"
+#include "../pir/pir_impl.h"
+#include "../util/visitor.h"
+
+#include <unordered_map>
+
+namespace rir {
+namespace pir {
+
+bool EscapeAnalysis::isAllocation(Value* v) {
+    // Environments are tied to a context by their position, copies in deopt
+    // branches can only be created for the ones belonging to the innermost one
+    if (auto mk = MkEnv::Cast(v))
+        return mk->context == 1;
+    return MkArg::Cast(v) || MkCls::Cast(v) || MkFunCls::Cast(v) ||
+           MkDots::Cast(v) || LdArgDots::Cast(v);
+}
+
+EscapeAnalysis::EscapeAnalysis(Code* code) {
+    std::vector<Instruction*> candidates;
+    std::unordered_map<Instruction*, std::vector<Instruction*>> uses;
+
+    Visitor::run(code->entry, [&](Instruction* i) {
+        if (isAllocation(i) && !i->bb()->isDeopt()) {
+            candidates.push_back(i);
+            deoptOnly_.insert(i);
+        }
+        i->eachArg([&](Value* v) {
+            if (isAllocation(v))
+                uses[Instruction::Cast(v)].push_back(i);
+        });
+    });
+
+    // Starting optimistically, an allocation escapes if it is used by
+    // anything but deopt branches and other deopt only allocations.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto a : candidates) {
+            if (!deoptOnly_.count(a))
+                continue;
+            for (auto u : uses[a]) {
+                if (!u->bb()->isDeopt() && !deoptOnly_.count(u)) {
+                    deoptOnly_.erase(a);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // The visitor sees every block after its dominators, thus allocations
+    // come before their uses.
+    for (auto a : candidates)
+        if (deoptOnly_.count(a))
+            order.push_back(a);
+}
+
+} // namespace pir
+} // namespace rir
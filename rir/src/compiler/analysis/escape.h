@@ -0,0 +1,51 @@
+#ifndef PIR_ESCAPE_H
+#define PIR_ESCAPE_H
+
+#include "../pir/pir.h"
+
+#include <unordered_set>
+#include <vector>
+
+namespace rir {
+namespace pir {
+
+/*
+ * Escape analysis for the objects allocated by a function: environments
+ * (MkEnv), promises (MkArg), closures (MkCls, MkFunCls) and ... lists (MkDots,
+ * LdArgDots).
+ *
+ * Deopt exits need these objects to reconstruct the interpreter state, but
+ * the fast path often does not. E.g. once ScopeResolution replaced all loads
+ * from an environment by SSA values, or ForceDominance inlined a promise. An
+ * allocation is "deopt only", if all its uses are in deopt branches, or in
+ * other deopt only allocations (e.g. a promise capturing a deopt only
+ * environment). All other allocations escape.
+ *
+ * Since inlined closures and promises are part of the function, this covers
+ * the environments and promises of inlinees too.
+ */
+class EscapeAnalysis {
+  public:
+    explicit EscapeAnalysis(Code* code);
+
+    static bool isAllocation(Value* v);
+
+    bool deoptOnly(Value* v) const {
+        return deoptOnly_.count(Instruction::Cast(v));
+    }
+
+    // In program order, ie. allocations come before the allocations which
+    // capture them.
+    const std::vector<Instruction*>& deoptOnlyAllocations() const {
+        return order;
+    }
+
+  private:
+    std::unordered_set<Instruction*> deoptOnly_;
+    std::vector<Instruction*> order;
+};
+
+} // namespace pir
+} // namespace rir
+
+#endif
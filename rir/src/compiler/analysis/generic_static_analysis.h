@@ -76,6 +76,11 @@ class StaticAnalysis {
     }
     // For lookup, after fixed-point was found
     virtual AbstractResult apply(AbstractState&, Instruction*) const = 0;
+    // Refines the state flowing from a branch into one of its successors, eg.
+    // with what is known about the condition of the branch. Only called if
+    // refinesBranches is set.
+    virtual void refineBranch(AbstractState&, BB* /* from */,
+                              BB* /* branch */) const {}
 
     constexpr static size_t MAX_CACHE_SIZE = 128 / sizeof(AbstractState);
 
@@ -100,6 +105,7 @@ class StaticAnalysis {
     AbstractState exitpoint;
 
     bool done = false;
+    bool refinesBranches = false;
     LogStream& log;
 
     ClosureVersion* closure;
@@ -333,8 +339,16 @@ class StaticAnalysis {
                     return;
                 }
 
-                mergeBranch(bb, bb->trueBranch(), state, changed);
-                mergeBranch(bb, bb->falseBranch(), state, changed);
+                if (refinesBranches && bb->falseBranch()) {
+                    AbstractState trueState = state;
+                    refineBranch(trueState, bb, bb->trueBranch());
+                    mergeBranch(bb, bb->trueBranch(), trueState, changed);
+                    refineBranch(state, bb, bb->falseBranch());
+                    mergeBranch(bb, bb->falseBranch(), state, changed);
+                } else {
+                    mergeBranch(bb, bb->trueBranch(), state, changed);
+                    mergeBranch(bb, bb->falseBranch(), state, changed);
+                }
 
                 changed[id] = false;
             });
@@ -54,7 +54,18 @@ LoopDetection::LoopDetection(Code* code, bool determineNesting) {
             }
         }
 
-        loops.emplace_back(Loop{header, body});
+        BB* preheader = nullptr;
+        for (const auto& p : cfg.immediatePredecessors(header)) {
+            if (body.count(p))
+                continue;
+            if (preheader || !p->isJmp()) {
+                preheader = nullptr;
+                break;
+            }
+            preheader = p;
+        }
+
+        loops.emplace_back(Loop{header, preheader, body});
     }
 
     // reconstruct the loop hierarchy
@@ -85,7 +96,8 @@ LoopDetection::LoopDetection(Code* code, bool determineNesting) {
         }
     }
 
-    // TODO: compute or add the loop preheader
+    // Note: loops whose entry edge is critical have no preheader, see
+    // LoopInvariantCodeMotion for how to add them.
 }
 
 } // namespace pir
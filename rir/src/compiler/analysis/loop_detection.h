@@ -37,6 +37,9 @@ class LoopDetection {
     class Loop {
         // target of loop entry edge(s) and back edge(s)
         BB* header_;
+        // the only block outside of the loop which enters it, if it jumps
+        // directly to the header (nullptr otherwise)
+        BB* preheader_;
         // set of all nodes in the loop, including the header and tails
         BBSet body_;
         // pointer (or nullptr) to (nearest) outer loop containing this loop
@@ -45,9 +48,9 @@ class LoopDetection {
         bool isInnermost_;
 
       public:
-        Loop(BB* header, const BBSet& body)
-            : header_(header), body_(std::move(body)), outer_(nullptr),
-              isInnermost_(true) {}
+        Loop(BB* header, BB* preheader, const BBSet& body)
+            : header_(header), preheader_(preheader), body_(std::move(body)),
+              outer_(nullptr), isInnermost_(true) {}
 
         Loop(const Loop&) = delete;
         Loop& operator=(const Loop&) = delete;
@@ -55,6 +58,7 @@ class LoopDetection {
         Loop& operator=(Loop&&) = default;
 
         BB* header() const { return header_; }
+        BB* preheader() const { return preheader_; }
         size_t size() const { return body_.size(); }
         bool contains(BB* node) const { return body_.count(node); }
         bool isInnermost() const { return isInnermost_; }
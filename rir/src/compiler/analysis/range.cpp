@@ -0,0 +1,330 @@
+#include "range.h"
+#include "../pir/pir_impl.h"
+#include "R/r.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace rir {
+namespace pir {
+
+constexpr int64_t IntRange::MIN;
+constexpr int64_t IntRange::MAX;
+
+// inc_ does not check for overflows. A loop over a vector of length INT_MAX
+// would thus already misbehave in the interpreter. Assuming lengths stay
+// below, loop indices bounded by a length can be incremented once more.
+static constexpr int64_t MAX_LENGTH = IntRange::MAX - 1;
+
+// A symbolic bound implies a constant one, since lengths are bounded.
+static IntRange& tighten(IntRange& r) {
+    if (r.len)
+        r.hi = std::min(r.hi, MAX_LENGTH + r.offset);
+    return r;
+}
+
+IntRange IntRange::add(int64_t c) const {
+    if (lo + c < MIN || hi + c > MAX)
+        return IntRange();
+    IntRange r = *this;
+    r.lo += c;
+    r.hi += c;
+    r.offset += c;
+    return tighten(r);
+}
+
+static IntRange sum(const IntRange& a, const IntRange& b) {
+    if (b.isConstant())
+        return a.add(b.lo);
+    if (a.isConstant())
+        return b.add(a.lo);
+    IntRange r;
+    if (a.lo + b.lo < IntRange::MIN || a.hi + b.hi > IntRange::MAX)
+        return r;
+    r.lo = a.lo + b.lo;
+    r.hi = a.hi + b.hi;
+    r.maybeNA = a.maybeNA || b.maybeNA;
+    return r;
+}
+
+static IntRange negate(const IntRange& a) {
+    IntRange r;
+    r.lo = -a.hi;
+    r.hi = -a.lo;
+    r.maybeNA = a.maybeNA;
+    return r;
+}
+
+IntRange IntRange::join(const IntRange& a, const IntRange& b) {
+    IntRange r;
+    r.lo = std::min(a.lo, b.lo);
+    r.hi = std::max(a.hi, b.hi);
+    r.maybeNA = a.maybeNA || b.maybeNA;
+    // Lengths are never negative, thus a constant upper bound below the
+    // offset of the other side satisfies its symbolic bound as well.
+    if (a.len && a.len == b.len) {
+        r.len = a.len;
+        r.offset = std::max(a.offset, b.offset);
+    } else if (a.len && b.hi <= a.offset) {
+        r.len = a.len;
+        r.offset = a.offset;
+    } else if (b.len && a.hi <= b.offset) {
+        r.len = b.len;
+        r.offset = b.offset;
+    }
+    return tighten(r);
+}
+
+void IntRange::print(std::ostream& out) const {
+    out << "[";
+    if (lo == MIN)
+        out << "-inf";
+    else
+        out << lo;
+    out << ", ";
+    if (hi == MAX)
+        out << "inf";
+    else
+        out << hi;
+    out << "]";
+    if (len) {
+        out << " <= ";
+        len->printRef(out);
+        if (offset)
+            out << (offset > 0 ? " + " : " - ") << std::abs(offset);
+    }
+    if (maybeNA)
+        out << " or NA";
+}
+
+bool RangeState::isTracked(Value* v) {
+    return Instruction::Cast(v) &&
+           v->type.isA(PirType(RType::integer).scalar().notObject());
+}
+
+IntRange RangeState::get(Value* v) const {
+    auto r = ranges.find(v);
+    if (r == ranges.end())
+        return IntRange();
+    return r->second;
+}
+
+AbstractResult RangeState::merge(const RangeState& other) {
+    AbstractResult res;
+    for (auto& e : other.ranges) {
+        auto mine = ranges.find(e.first);
+        if (mine == ranges.end()) {
+            ranges.emplace(e);
+            res.update();
+            continue;
+        }
+        auto& old = mine->second;
+        auto r = IntRange::join(old, e.second);
+        if (r.lo < old.lo)
+            r.lo = IntRange::MIN;
+        if (r.hi > old.hi)
+            r.hi = IntRange::MAX;
+        if (r.len && old.len && r.offset > old.offset)
+            r.len = nullptr;
+        tighten(r);
+        if (r != old) {
+            old = r;
+            res.lostPrecision();
+        }
+    }
+    return res;
+}
+
+void RangeState::forget(Instruction* len) {
+    for (auto& e : ranges)
+        if (e.second.len == len)
+            e.second.len = nullptr;
+}
+
+void RangeState::print(std::ostream& out, bool tty) const {
+    for (auto& e : ranges) {
+        e.first->printRef(out);
+        out << ": ";
+        e.second.print(out);
+        out << "\n";
+    }
+}
+
+AbstractResult RangeAnalysis::apply(RangeState& state, Instruction* i) const {
+    if (!RangeState::isTracked(i))
+        return AbstractResult::None;
+
+    auto arg = [&](size_t n) { return state.get(i->arg(n).val()); };
+
+    IntRange r;
+    switch (i->tag) {
+    case Tag::LdConst: {
+        SEXP c = LdConst::Cast(i)->c();
+        if (IS_SIMPLE_SCALAR(c, INTSXP) && INTEGER(c)[0] != NA_INTEGER)
+            r = IntRange::constant(INTEGER(c)[0]);
+        break;
+    }
+    case Tag::Length:
+    case Tag::ForSeqSize:
+        // In a loop, bounds relative to the previous iteration are stale now
+        state.forget(i);
+        r.lo = 0;
+        r.maybeNA = false;
+        r.len = i;
+        tighten(r);
+        break;
+    case Tag::Inc:
+        r = arg(0).add(1);
+        break;
+    case Tag::Dec:
+        r = arg(0).add(-1);
+        break;
+    case Tag::Add:
+        r = sum(arg(0), arg(1));
+        break;
+    case Tag::Sub: {
+        auto b = arg(1);
+        r = b.isConstant() ? arg(0).add(-b.lo) : sum(arg(0), negate(b));
+        break;
+    }
+    case Tag::AsInt:
+    case Tag::CastType:
+        if (RangeState::isTracked(i->arg(0).val()))
+            r = arg(0);
+        break;
+    case Tag::Phi: {
+        bool first = true;
+        Phi::Cast(i)->eachArg([&](BB*, Value* v) {
+            // Inputs which are not defined yet, come from a back edge which
+            // was not analyzed so far
+            if (RangeState::isTracked(v) && !state.has(v))
+                return;
+            r = first ? state.get(v) : IntRange::join(r, state.get(v));
+            first = false;
+        });
+        if (first)
+            return AbstractResult::None;
+        break;
+    }
+    default:
+        break;
+    }
+
+    if (state.has(i) && state.get(i) == r)
+        return AbstractResult::None;
+    state.set(i, r);
+    return AbstractResult::Updated;
+}
+
+// 1 for TRUE, 0 for FALSE and -1 for anything else
+static int logicalConstant(Value* v) {
+    if (v == True::instance())
+        return 1;
+    if (v == False::instance())
+        return 0;
+    if (auto ld = LdConst::Cast(v)) {
+        if (ld->c() == R_TrueValue)
+            return 1;
+        if (ld->c() == R_FalseValue)
+            return 0;
+    }
+    return -1;
+}
+
+void RangeAnalysis::refineBranch(RangeState& state, BB* from,
+                                 BB* branch) const {
+    auto br = Branch::Cast(from->last());
+    if (!br)
+        return;
+    bool holds = branch == from->trueBranch();
+
+    // Find the comparison, which decides the branch
+    Value* cond = br->arg<0>().val();
+    bool maybeNA = false;
+    while (true) {
+        if (AsTest::Cast(cond) || AsLogical::Cast(cond) ||
+            CastType::Cast(cond)) {
+            cond = Instruction::Cast(cond)->arg(0).val();
+            continue;
+        }
+        if (Eq::Cast(cond) || Neq::Cast(cond)) {
+            auto cmp = Instruction::Cast(cond);
+            auto lhs = cmp->arg(0).val();
+            auto rhs = cmp->arg(1).val();
+            int c = logicalConstant(rhs);
+            if (c == -1) {
+                std::swap(lhs, rhs);
+                c = logicalConstant(rhs);
+            }
+            if (c == -1)
+                return;
+            // `cond == FALSE` not being TRUE could also mean that cond is NA
+            if (!holds)
+                maybeNA = true;
+            holds = (holds == (c == 1)) == (Eq::Cast(cond) != nullptr);
+            cond = lhs;
+            continue;
+        }
+        break;
+    }
+
+    // Normalize to a < b
+    Value* a;
+    Value* b;
+    if (auto lt = Lt::Cast(cond)) {
+        a = lt->lhs();
+        b = lt->rhs();
+    } else if (auto gt = Gt::Cast(cond)) {
+        a = gt->rhs();
+        b = gt->lhs();
+    } else {
+        return;
+    }
+    if (!RangeState::isTracked(a) || !RangeState::isTracked(b))
+        return;
+
+    auto ra = state.get(a);
+    auto rb = state.get(b);
+    if (maybeNA && (ra.maybeNA || rb.maybeNA))
+        return;
+    if (holds) {
+        // a < b, and neither of them is NA
+        ra.maybeNA = rb.maybeNA = false;
+        ra.hi = std::min(ra.hi, rb.hi - 1);
+        rb.lo = std::max(rb.lo, ra.lo + 1);
+        if (rb.len && (!ra.len || ra.len == rb.len)) {
+            ra.offset = ra.len ? std::min(ra.offset, rb.offset - 1)
+                               : rb.offset - 1;
+            ra.len = rb.len;
+        }
+    } else {
+        // b <= a, unless one of them is NA
+        if (ra.maybeNA || rb.maybeNA)
+            return;
+        rb.hi = std::min(rb.hi, ra.hi);
+        ra.lo = std::max(ra.lo, rb.lo);
+        if (ra.len && (!rb.len || rb.len == ra.len)) {
+            rb.offset = rb.len ? std::min(rb.offset, ra.offset) : ra.offset;
+            rb.len = ra.len;
+        }
+    }
+    // Dead branch
+    if (ra.lo > ra.hi || rb.lo > rb.hi)
+        return;
+    state.set(a, tighten(ra));
+    state.set(b, tighten(rb));
+}
+
+bool RangeAnalysis::inBounds(Instruction* i, Value* vec, Value* idx) const {
+    if (!RangeState::isTracked(idx))
+        return false;
+    auto r =
+        StaticAnalysis::at<PositioningStyle::BeforeInstruction>(i).get(idx);
+    if (r.maybeNA || r.lo < 1 || !r.len || r.offset > 0)
+        return false;
+    return r.len->arg(0).val()->followCastsAndForce() ==
+           vec->followCastsAndForce();
+}
+
+} // namespace pir
+} // namespace rir
@@ -0,0 +1,100 @@
+#ifndef PIR_RANGE_H
+#define PIR_RANGE_H
+
+#include "generic_static_analysis.h"
+
+#include <climits>
+#include <cstdint>
+#include <unordered_map>
+
+namespace rir {
+namespace pir {
+
+/*
+ * The range of values a scalar integer can take.
+ *
+ * Besides a constant interval [lo, hi], a range can have a symbolic upper
+ * bound `len + offset`, where len is a Length or ForSeqSize instruction. This
+ * is what we need to prove that the induction variable of a loop over a vector
+ * stays within its bounds.
+ */
+struct IntRange {
+    static constexpr int64_t MIN = -INT_MAX;
+    static constexpr int64_t MAX = INT_MAX;
+
+    int64_t lo = MIN;
+    int64_t hi = MAX;
+    bool maybeNA = true;
+    Instruction* len = nullptr;
+    int64_t offset = 0;
+
+    static IntRange constant(int64_t c) {
+        IntRange r;
+        r.lo = r.hi = c;
+        r.maybeNA = false;
+        return r;
+    }
+
+    bool isConstant() const { return !maybeNA && lo == hi; }
+    bool isTop() const { return lo == MIN && hi == MAX && maybeNA && !len; }
+
+    // Adds a constant, in case of an overflow the result is NA
+    IntRange add(int64_t c) const;
+
+    // Least range containing both a and b
+    static IntRange join(const IntRange& a, const IntRange& b);
+
+    bool operator==(const IntRange& other) const {
+        return lo == other.lo && hi == other.hi && maybeNA == other.maybeNA &&
+               len == other.len && (!len || offset == other.offset);
+    }
+    bool operator!=(const IntRange& other) const { return !(*this == other); }
+
+    void print(std::ostream& out) const;
+};
+
+/*
+ * Ranges of all scalar integer values, which are defined at a certain point.
+ * Values missing in the map are either not integers, in which case their range
+ * is unknown, or they are not defined yet.
+ */
+class RangeState {
+    std::unordered_map<Value*, IntRange> ranges;
+
+  public:
+    static bool isTracked(Value* v);
+
+    bool has(Value* v) const { return ranges.count(v); }
+    IntRange get(Value* v) const;
+    void set(Value* v, const IntRange& r) { ranges[v] = r; }
+    // Drops all bounds relative to len
+    void forget(Instruction* len);
+
+    // Merging at a loop header happens once per iteration of the analysis. To
+    // reach a fixed-point, bounds which still grow are widened right away.
+    AbstractResult merge(const RangeState& other);
+    AbstractResult mergeExit(const RangeState& other) { return merge(other); }
+
+    void print(std::ostream& out, bool tty) const;
+};
+
+class RangeAnalysis : public StaticAnalysis<RangeState> {
+  public:
+    RangeAnalysis(ClosureVersion* cls, LogStream& log)
+        : StaticAnalysis("Range", cls, cls, log) {
+        refinesBranches = true;
+    }
+
+    AbstractResult apply(RangeState& state,
+                         Instruction* i) const override final;
+    void refineBranch(RangeState& state, BB* from,
+                      BB* branch) const override final;
+
+    // Is idx a valid 1-based index into vec, when executing i
+    bool inBounds(Instruction* i, Value* vec, Value* idx) const;
+};
+
+} // namespace pir
+} // namespace rir
+
+#endif
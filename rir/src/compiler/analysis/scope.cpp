@@ -150,11 +150,13 @@ AbstractResult ScopeAnalysis::doCompute(ScopeAnalysisState& state,
         effect.update();
     } else if (auto le = LdFunctionEnv::Cast(i)) {
         // LdFunctionEnv happen inside promises and refer back to the caller
-        // environment, ie. the instruction that created the promise.
-        assert(staticClosureEnv != Env::notClosed());
-        assert(!state.envs.aliases.count(le) ||
-               state.envs.aliases.at(le) == staticClosureEnv);
-        state.envs.aliases[le] = staticClosureEnv;
+        // environment, ie. the instruction that created the promise. In
+        // continuations it is the (unknown) environment of the replaced frame.
+        if (staticClosureEnv != Env::notClosed()) {
+            assert(!state.envs.aliases.count(le) ||
+                   state.envs.aliases.at(le) == staticClosureEnv);
+            state.envs.aliases[le] = staticClosureEnv;
+        }
     } else if (auto ldfun = LdFun::Cast(i)) {
         // Loadfun has collateral forcing if we touch intermediate envs.
         // But if we statically find the closure to load, then there is no issue
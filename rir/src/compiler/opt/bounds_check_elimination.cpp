@@ -0,0 +1,60 @@
+#include "../analysis/range.h"
+#include "../pir/pir_impl.h"
+#include "../util/visitor.h"
+#include "R/r.h"
+#include "pass_definitions.h"
+
+namespace rir {
+namespace pir {
+
+void BoundsCheckElimination::apply(RirCompiler&, ClosureVersion* function,
+                                   LogStream& log) const {
+    // Vectors which can be indexed without dispatch and where an index within
+    // bounds never causes an error
+    static const PirType vector = PirType::vecs().notObject();
+    static const PirType atomicVector = PirType::num().notObject();
+    static const PirType scalarValue =
+        (PirType::num() | RType::str).scalar().notObject();
+
+    bool hasCandidates = false;
+    Visitor::run(function->entry, [&](Instruction* i) {
+        if (Extract1_1D::Cast(i) || Extract2_1D::Cast(i) ||
+            Subassign1_1D::Cast(i) || Subassign2_1D::Cast(i))
+            hasCandidates = true;
+    });
+    if (!hasCandidates)
+        return;
+
+    RangeAnalysis ranges(function, log);
+
+    auto dropChecks = [&](Instruction* i, Value* vec, Value* idx) {
+        if (!i->effects.includes(Effect::Error) &&
+            !i->effects.includes(Effect::Warn))
+            return;
+        if (ranges.inBounds(i, vec, idx)) {
+            i->effects.reset(Effect::Error);
+            i->effects.reset(Effect::Warn);
+        }
+    };
+
+    Visitor::run(function->entry, [&](Instruction* i) {
+        if (auto e = Extract1_1D::Cast(i)) {
+            if (e->vec()->type.isA(vector))
+                dropChecks(e, e->vec(), e->idx());
+        } else if (auto e = Extract2_1D::Cast(i)) {
+            if (e->vec()->type.isA(vector))
+                dropChecks(e, e->vec(), e->idx());
+        } else if (auto s = Subassign1_1D::Cast(i)) {
+            if (s->lhs()->type.isA(atomicVector) &&
+                s->rhs()->type.isA(scalarValue))
+                dropChecks(s, s->lhs(), s->idx());
+        } else if (auto s = Subassign2_1D::Cast(i)) {
+            if (s->lhs()->type.isA(atomicVector) &&
+                s->rhs()->type.isA(scalarValue))
+                dropChecks(s, s->lhs(), s->idx());
+        }
+    });
+}
+
+} // namespace pir
+} // namespace rir
@@ -6,6 +6,7 @@
 
 #include "R/r.h"
 #include "pass_definitions.h"
+#include "utils/Pool.h"
 
 #include <unordered_map>
 #include <unordered_set>
@@ -18,6 +19,44 @@ class TheCleanup {
   public:
     explicit TheCleanup(ClosureVersion* function) : function(function) {}
     ClosureVersion* function;
+
+    // Splices ... lists of known length (eg. after inlining a wrapper) into
+    // the call, thus they are not allocated
+    static NamedCall* expandDots(NamedCall* call) {
+        bool expand = false;
+        for (size_t i = 0; i < call->nCallArgs(); ++i) {
+            auto dots = MkDots::Cast(call->arg(i + 1).val());
+            if (!dots || call->names[i] != R_DotsSymbol)
+                continue;
+            expand = true;
+            dots->eachArg([&](Value* v) {
+                if (!v->type.isA(PirType(RType::prom) | RType::missing))
+                    expand = false;
+            });
+            if (!expand)
+                return nullptr;
+        }
+        if (!expand)
+            return nullptr;
+
+        std::vector<Value*> args;
+        std::vector<rir::BC::PoolIdx> names;
+        for (size_t i = 0; i < call->nCallArgs(); ++i) {
+            auto arg = call->arg(i + 1).val();
+            auto dots = MkDots::Cast(arg);
+            if (dots && call->names[i] == R_DotsSymbol) {
+                dots->eachArg([&](Value* v) {
+                    args.push_back(v);
+                    names.push_back(rir::Pool::insert(R_NilValue));
+                });
+            } else {
+                args.push_back(arg);
+                names.push_back(rir::Pool::insert(call->names[i]));
+            }
+        }
+        return new NamedCall(call->env(), call->cls(), args, names,
+                             call->srcIdx);
+    }
     void operator()() {
         std::unordered_set<size_t> used_p;
         std::unordered_map<BB*, std::unordered_set<Phi*>> usedBB;
@@ -128,6 +167,12 @@ class TheCleanup {
                         removed = true;
                         next = bb->remove(ip);
                     }
+                } else if (auto call = NamedCall::Cast(i)) {
+                    if (auto expanded = expandDots(call)) {
+                        bb->replace(ip, expanded);
+                        call->replaceUsesWith(expanded);
+                        i = expanded;
+                    }
                 }
 
                 if (!removed) {
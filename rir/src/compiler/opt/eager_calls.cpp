@@ -43,8 +43,8 @@ void EagerCalls::apply(RirCompiler& cmp, ClosureVersion* closure,
         // this is guaranteed to cause problems, since many variables are called
         // "c". Therefore we keep the ldfun in this case, unless we already know
         // that the function "c" comes from the global env.
-        // TODO: Implement this with a dependency on the binding cell instead of
-        // an eager check.
+        // If the ldvar reads a static environment, pir2rir replaces the guard
+        // with a dependency on the binding, see Pir2Rir::elideBindingGuard.
         auto funEnv = Env::Cast(ldfun->env());
         if (ldfun->varName != symbol::c ||
             (funEnv && funEnv->rho == R_GlobalEnv)) {
@@ -58,6 +58,7 @@ void EagerCalls::apply(RirCompiler& cmp, ClosureVersion* closure,
         ip++;
 
         auto assume = new Assume(test, cp);
+        assume->reason.reason = DeoptReason::Calltarget;
         ip = bb->insert(ip, assume);
         ip++;
 
@@ -49,10 +49,11 @@ void ElideEnvSpec::apply(RirCompiler&, ClosureVersion* function,
                                 auto condition = new IsObject(arg);
                                 ip = bb->insert(ip, condition);
                                 ip++;
-                                ip = bb->insert(
-                                    ip,
-                                    (new Assume(condition, checkpoint.at(i)))
-                                        ->Not());
+                                auto assume =
+                                    new Assume(condition, checkpoint.at(i));
+                                assume->reason = {DeoptReason::Typecheck,
+                                                  arg->typeFeedbackOrigin};
+                                ip = bb->insert(ip, assume->Not());
                                 ip++;
                             }
                     });
@@ -89,7 +90,10 @@ void ElideEnvSpec::apply(RirCompiler&, ClosureVersion* function,
                                 stubbedEnvs.insert(environment);
                                 environment = MkEnv::Cast(force->env());
                                 auto condition = new IsEnvStub(environment);
-                                BBTransform::insertAssume(condition, cp, true);
+                                auto assume = BBTransform::insertAssume(
+                                    condition, cp, true);
+                                assume->reason.reason =
+                                    DeoptReason::EnvStubMaterialized;
                             }
                         } else {
                             bannedEnvs.insert(environment);
@@ -39,8 +39,8 @@ void HoistInstruction::apply(RirCompiler& cmp, ClosureVersion* function,
          *    * i has an effect, but there is no conflicting effect between t
          *      and b, thus reordering is not observable.
          *
-         * TODO: compute loop boundaries for placement instead of taking the
-         *       whatever block happens to be dominated by all inputs.
+         * Placement with respect to loop boundaries is done by
+         * LoopInvariantCodeMotion.
          */
         auto ip = bb->begin();
         while (ip != bb->end()) {
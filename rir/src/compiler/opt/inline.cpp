@@ -28,6 +28,16 @@ class TheInliner {
         if (version->size() > Parameter::INLINER_MAX_SIZE)
             return;
 
+        // Surplus arguments of closures with ... are passed in it
+        auto argsMatch = [](ClosureVersion* inlinee, size_t nCallArgs) {
+            auto passed =
+                inlinee->nargs() - inlinee->assumptions().numMissing();
+            if (passed == nCallArgs)
+                return true;
+            return passed < nCallArgs &&
+                   inlinee->owner()->formals().hasDots();
+        };
+
         Visitor::run(version->entry, [&](BB* bb) {
             // Dangerous iterater usage, works since we do only update it in
             // one place.
@@ -49,11 +59,7 @@ class TheInliner {
                     if (inlineeCls->rirFunction()->uninlinable)
                         continue;
                     inlinee = call->tryDispatch(inlineeCls);
-                    if (!inlinee)
-                        continue;
-                    if (inlinee->nargs() -
-                            inlinee->assumptions().numMissing() !=
-                        call->nCallArgs())
+                    if (!inlinee || !argsMatch(inlinee, call->nCallArgs()))
                         continue;
                     staticEnv = mkcls->lexicalEnv();
                     callerFrameState = call->frameState();
@@ -62,11 +68,7 @@ class TheInliner {
                     if (inlineeCls->rirFunction()->uninlinable)
                         continue;
                     inlinee = call->tryDispatch();
-                    if (!inlinee)
-                        continue;
-                    if (inlinee->nargs() -
-                            inlinee->assumptions().numMissing() !=
-                        call->nCallArgs())
+                    if (!inlinee || !argsMatch(inlinee, call->nCallArgs()))
                         continue;
                     // if we don't know the closure of the inlinee, we can't
                     // inline.
@@ -206,6 +208,16 @@ class TheInliner {
                             }
                         }
 
+                        if (auto lddots = LdArgDots::Cast(i)) {
+                            std::vector<Value*> dots;
+                            for (size_t a = lddots->id; a < arguments.size();
+                                 ++a)
+                                dots.push_back(arguments[a]);
+                            auto mk = new MkDots(dots);
+                            bb->replace(ip, mk);
+                            lddots->replaceUsesWith(mk);
+                        }
+
                         if (ld) {
                             Value* a = arguments[ld->id];
                             if (auto mk = MkArg::Cast(a)) {
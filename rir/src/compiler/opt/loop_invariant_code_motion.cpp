@@ -0,0 +1,220 @@
+#include "../analysis/loop_detection.h"
+#include "../pir/pir_impl.h"
+#include "../transform/bb.h"
+#include "../util/cfg.h"
+#include "../util/visitor.h"
+#include "R/r.h"
+#include "pass_definitions.h"
+
+#include <unordered_set>
+
+namespace rir {
+namespace pir {
+
+/*
+ * Gives every loop with a single entry edge a preheader, ie. a block outside
+ * of the loop which jumps to the header and is the only way into the loop.
+ * Loops with multiple entries are left alone.
+ */
+static void createPreheaders(ClosureVersion* function) {
+    CFG cfg(function);
+    LoopDetection loops(function);
+    std::vector<std::pair<BB*, BB*>> edges;
+    for (auto& loop : loops) {
+        BB* entry = nullptr;
+        bool single = true;
+        for (auto pred : cfg.immediatePredecessors(loop.header())) {
+            if (loop.contains(pred))
+                continue;
+            if (entry)
+                single = false;
+            entry = pred;
+        }
+        if (entry && single && !entry->isJmp())
+            edges.emplace_back(entry, loop.header());
+    }
+    for (auto& e : edges)
+        BBTransform::splitEdge(function->nextBBId++, e.first, e.second,
+                               function);
+}
+
+// Assumptions are deopt barriers for the AvailableCheckpoints analysis. But
+// deoptimizing to a checkpoint before a passed assumption just checks it
+// again, thus we can group all assumptions on the same checkpoint.
+static bool isBarrier(Instruction* i) {
+    return i->isDeoptBarrier() && !Assume::Cast(i);
+}
+
+// The checkpoint which is available at the end of bb, ie. there are no deopt
+// barriers between the checkpoint and the end of bb.
+static Checkpoint* checkpointAtEnd(BB* bb, const CFG& cfg) {
+    while (true) {
+        for (auto i : *bb)
+            if (isBarrier(i))
+                return nullptr;
+        if (!cfg.hasSinglePred(bb))
+            return nullptr;
+        BB* pred = cfg.immediatePredecessors(bb).front();
+        if (!pred->isEmpty()) {
+            if (auto cp = Checkpoint::Cast(pred->last()))
+                return pred->trueBranch() == bb ? cp : nullptr;
+        }
+        bb = pred;
+    }
+}
+
+// Pure instructions, which are cheap enough to be executed even if the loop
+// body is not. Instructions which allocate a fresh object are excluded, since
+// moving them out of the loop would share the object between iterations.
+static bool isHoistablePure(Instruction* i) {
+    switch (i->tag) {
+    case Tag::LdConst:
+    case Tag::IsType:
+    case Tag::IsObject:
+    case Tag::Is:
+    case Tag::Identical:
+    case Tag::Length:
+        return i->effects.empty();
+    default:
+        return false;
+    }
+}
+
+// Instructions which produce the same result without any effect, when they
+// are executed again with the same inputs. Loads additionally need the
+// environment they read from to stay the same.
+static bool isLoad(Instruction* i) {
+    return LdVar::Cast(i) || LdFun::Cast(i) || LdVarSuper::Cast(i);
+}
+static bool isIdempotent(Instruction* i) {
+    return isLoad(i) || Force::Cast(i) || ChkMissing::Cast(i) ||
+           ChkClosure::Cast(i);
+}
+
+// CastType asserts a type which is only established by a guard. We only move
+// the ones inserted by TypeSpeculation, together with their Assume.
+static bool castJustifiedBy(CastType* cast, Assume* assume) {
+    auto arg = cast->arg<0>().val();
+    if (auto isType = IsType::Cast(assume->condition()))
+        return assume->assumeTrue && isType->arg<0>().val() == arg &&
+               isType->typeTest.isA(cast->type);
+    if (auto isObj = IsObject::Cast(assume->condition()))
+        return !assume->assumeTrue && isObj->arg<0>().val() == arg &&
+               arg->type.notObject().isA(cast->type);
+    return false;
+}
+
+void LoopInvariantCodeMotion::apply(RirCompiler&, ClosureVersion* function,
+                                    LogStream&) const {
+    createPreheaders(function);
+
+    CFG cfg(function);
+    DominanceGraph dom(function);
+    // Sorted by size, ie. inner loops are processed first, such that
+    // instructions can bubble up through the whole loop nest.
+    LoopDetection loops(function, true);
+
+    for (auto& loop : loops) {
+        BB* header = loop.header();
+        BB* preheader = loop.preheader();
+        if (!preheader)
+            continue;
+
+        std::vector<BB*> latches;
+        for (auto pred : cfg.immediatePredecessors(header))
+            if (loop.contains(pred))
+                latches.push_back(pred);
+        auto executedEveryIteration = [&](BB* bb) {
+            for (auto l : latches)
+                if (!dom.dominates(bb, l))
+                    return false;
+            return true;
+        };
+
+        auto isInvariant = [&](Instruction* i) {
+            bool invariant = true;
+            i->eachArg([&](Value* v) {
+                if (Checkpoint::Cast(v))
+                    return;
+                if (auto a = Instruction::Cast(v))
+                    if (loop.contains(a->bb()))
+                        invariant = false;
+            });
+            return invariant;
+        };
+
+        // Loads are only moved if nothing else in the loop can modify the
+        // environments they read from.
+        auto loopMayChangeEnv = [&](Instruction* load) {
+            for (auto bb : loop)
+                for (auto i : *bb)
+                    if (i != load &&
+                        (i->changesEnv() ||
+                         i->effects.includes(Effect::ExecuteCode) ||
+                         i->effects.includes(Effect::Reflection)))
+                        return true;
+            return false;
+        };
+
+        Checkpoint* cp = checkpointAtEnd(preheader, cfg);
+        std::vector<Assume*> hoistedAssumes;
+        auto hoist = [&](BB* bb, BB::Instrs::iterator it) {
+            if (isBarrier(*it))
+                cp = nullptr;
+            if (auto a = Assume::Cast(*it)) {
+                a->checkpoint(cp);
+                hoistedAssumes.push_back(a);
+            }
+            return bb->moveToLast(it, preheader);
+        };
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto bb : loop) {
+                // Effects are only moved from the beginning of the header,
+                // where they are executed as the first thing in the loop
+                // anyway. Moving them anywhere else could execute them even
+                // though the loop exits before reaching them.
+                bool prefix = bb == header;
+
+                auto it = bb->begin();
+                while (it != bb->end()) {
+                    auto i = *it;
+                    bool move = false;
+
+                    if (Phi::Cast(i) || i->branchOrExit() || !isInvariant(i)) {
+                        // stays
+                    } else if (isHoistablePure(i)) {
+                        move = true;
+                    } else if (Assume::Cast(i)) {
+                        // Assumptions are checked once before entering the
+                        // loop. If they hold there, they hold in every
+                        // iteration. We only do this for assumptions which are
+                        // checked in every iteration, otherwise we might
+                        // deoptimize because of a path which is never taken.
+                        move = cp && executedEveryIteration(bb);
+                    } else if (auto cast = CastType::Cast(i)) {
+                        for (auto a : hoistedAssumes)
+                            if (castJustifiedBy(cast, a))
+                                move = true;
+                    } else if (prefix && isIdempotent(i)) {
+                        move = !isLoad(i) || !loopMayChangeEnv(i);
+                    }
+
+                    if (move) {
+                        it = hoist(bb, it);
+                        changed = true;
+                        continue;
+                    }
+                    if (i->hasObservableEffects())
+                        prefix = false;
+                    ++it;
+                }
+            }
+        }
+    }
+}
+
+} // namespace pir
+} // namespace rir
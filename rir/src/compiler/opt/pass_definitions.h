@@ -134,10 +134,33 @@ class PASS(TypeInference);
 class PASS(TypeSpeculation);
 
 /*
- * Loop Invariant Code motion
+ * Hoists instructions to the earliest block dominated by all their inputs.
  */
 class PASS(HoistInstruction);
 
+/*
+ * Loop invariant code motion. Uses loop detection to move invariant type
+ * checks, assumptions, lengths and loads of bindings, which the loop does not
+ * change, into the preheader of the loop.
+ */
+class PASS(LoopInvariantCodeMotion);
+
+/*
+ * Uses range analysis to find vector accesses, where the index is known to be
+ * within the bounds of the vector, eg. the induction variable of a for loop
+ * over that vector. Those accesses cannot fail, so their error and warning
+ * effects are removed.
+ */
+class PASS(BoundsCheckElimination);
+
+/*
+ * Uses escape analysis to find environments, promises and closures which are
+ * only needed when deoptimizing. Those are created in the deopt branches
+ * instead. Together with ScopeResolution and ForceDominance, which replace
+ * loads and forces by SSA values, this removes them from the fast path.
+ */
+class PASS(ScalarReplacement);
+
 class PhaseMarker : public PirTranslator {
   public:
     explicit PhaseMarker(const std::string& name) : PirTranslator(name) {}
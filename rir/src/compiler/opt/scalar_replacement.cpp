@@ -0,0 +1,59 @@
+#include "../analysis/escape.h"
+#include "../pir/pir_impl.h"
+#include "../util/visitor.h"
+#include "pass_definitions.h"
+
+#include <functional>
+#include <unordered_map>
+
+namespace rir {
+namespace pir {
+
+void ScalarReplacement::apply(RirCompiler&, ClosureVersion* function,
+                              LogStream&) const {
+    EscapeAnalysis escape(function);
+    auto& allocations = escape.deoptOnlyAllocations();
+    if (allocations.empty())
+        return;
+
+    std::vector<BB*> deopts;
+    Visitor::run(function->entry, [&](BB* bb) {
+        if (bb->isDeopt())
+            deopts.push_back(bb);
+    });
+
+    for (auto deopt : deopts) {
+        // Every deopt branch gets its own copy of the objects it needs. They
+        // are created at the beginning of the branch, arguments first.
+        std::unordered_map<Instruction*, Instruction*> copies;
+        std::function<Instruction*(Instruction*)> materialize =
+            [&](Instruction* a) {
+                auto c = copies.find(a);
+                if (c != copies.end())
+                    return c->second;
+                auto copy = a->clone();
+                copy->eachArg([&](InstrArg& arg) {
+                    if (escape.deoptOnly(arg.val()))
+                        arg.val() = materialize(Instruction::Cast(arg.val()));
+                });
+                deopt->insert(deopt->begin() + copies.size(), copy);
+                copies.emplace(a, copy);
+                return copy;
+            };
+
+        std::vector<Instruction*> instrs(deopt->begin(), deopt->end());
+        for (auto i : instrs) {
+            i->eachArg([&](InstrArg& arg) {
+                if (escape.deoptOnly(arg.val()))
+                    arg.val() = materialize(Instruction::Cast(arg.val()));
+            });
+        }
+    }
+
+    // The originals are unused now, the ones capturing others go first
+    for (auto a = allocations.rbegin(); a != allocations.rend(); ++a)
+        (*a)->eraseAndRemove();
+}
+
+} // namespace pir
+} // namespace rir
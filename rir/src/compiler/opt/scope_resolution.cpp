@@ -377,6 +377,11 @@ class TheScopeResolution {
 
                     bool isActualLoad =
                         LdVar::Cast(i) || LdFun::Cast(i) || LdVarSuper::Cast(i);
+                    // An empty ... is bound to missing, loading it for a
+                    // call is not an error
+                    bool isDotsLoad =
+                        LdVar::Cast(i) &&
+                        LdVar::Cast(i)->varName == R_DotsSymbol;
 
                     // In case the scope analysis is sure that this is
                     // actually the same as some other PIR value. So let's just
@@ -384,7 +389,8 @@ class TheScopeResolution {
                     if (res.isSingleValue()) {
                         if (auto val = getSingleLocalValue(res)) {
                             if (val->type.isA(i->type)) {
-                                if (isActualLoad && val->type.maybeMissing()) {
+                                if (isActualLoad && val->type.maybeMissing() &&
+                                    !isDotsLoad) {
                                     // LdVar checks for missingness, so we need
                                     // to preserve this.
                                     auto chk = new ChkMissing(val);
@@ -422,7 +428,7 @@ class TheScopeResolution {
                         if (auto resPhi =
                                 tryInsertPhis(i->env(), res, bb, ip, false)) {
                             Value* val = resPhi;
-                            if (val->type.maybeMissing()) {
+                            if (val->type.maybeMissing() && !isDotsLoad) {
                                 // LdVar checks for missingness, so we need
                                 // to preserve this.
                                 auto chk = new ChkMissing(val);
@@ -90,6 +90,7 @@ void TypeSpeculation::apply(RirCompiler&, ClosureVersion* function,
             ip++;
             auto assume = new Assume(condition, cp);
             assume->assumeTrue = assumeTrue;
+            assume->reason = {DeoptReason::Typecheck, i->typeFeedbackOrigin};
             ip = bb->insert(ip, assume);
             ip++;
             ip = bb->insert(ip, cast);
@@ -12,6 +12,11 @@ struct Parameter {
     static bool DEOPT_CHAOS_SEED;
     static size_t MAX_INPUT_SIZE;
     static unsigned RIR_WARMUP;
+    static unsigned OPT_WARMUP;
+    static unsigned OSR_THRESHOLD;
+    static bool DEFERRED_COMPILATION;
+    static unsigned DEFERRED_COMPILATION_BUDGET;
+    static size_t MODULE_CACHE_BYTES;
 
     static size_t INLINER_MAX_SIZE;
     static size_t INLINER_MAX_INLINEE_SIZE;
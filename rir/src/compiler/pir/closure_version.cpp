@@ -92,6 +92,15 @@ ClosureVersion* ClosureVersion::clone(const Assumptions& newAssumptions) {
     ctx.assumptions = ctx.assumptions | newAssumptions;
     auto c = owner_->declareVersion(ctx);
     c->properties = properties;
+    c->osrEntry = osrEntry;
+    c->entry = BBTransform::clone(entry, c, c);
+    return c;
+}
+
+ClosureVersion* ClosureVersion::copy() const {
+    auto c = new ClosureVersion(owner_, optimizationContext_, properties);
+    c->osrEntry = osrEntry;
+    c->optimized = optimized;
     c->entry = BBTransform::clone(entry, c, c);
     return c;
 }
@@ -53,6 +53,9 @@ class ClosureVersion : public Code {
 
   public:
     ClosureVersion* clone(const Assumptions& newAssumptions);
+    // A copy which is not a version of the closure, eg. to be lowered without
+    // destroying the original
+    ClosureVersion* copy() const;
 
     const Assumptions& assumptions() const {
         return optimizationContext_.assumptions;
@@ -63,6 +66,16 @@ class ClosureVersion : public Code {
 
     Properties properties;
 
+    // Continuations start at this pc of the rir baseline body instead of the
+    // function entry. They run in the environment of the interrupted baseline
+    // frame and take its operand stack as arguments.
+    Opcode* osrEntry = nullptr;
+    bool isContinuation() const { return osrEntry; }
+
+    // Set after the optimizations ran. Such versions are kept in the module
+    // and not optimized again by later compilations.
+    bool optimized = false;
+
     Closure* owner() const { return owner_; }
     size_t nargs() const;
     const std::string& name() const { return name_; }
@@ -286,8 +286,10 @@ void Instruction::replaceUsesWithLimits(Value* replace, BB* start,
 
     // Propagate typefeedback
     if (auto rep = Instruction::Cast(replace)) {
-        if (!rep->type.isA(typeFeedback) && rep->typeFeedback.isVoid())
+        if (!rep->type.isA(typeFeedback) && rep->typeFeedback.isVoid()) {
             rep->typeFeedback = typeFeedback;
+            rep->typeFeedbackOrigin = typeFeedbackOrigin;
+        }
     }
 }
 
@@ -304,8 +306,10 @@ void Instruction::replaceUsesWith(Value* replace) {
 
     // Propagate typefeedback
     if (auto rep = Instruction::Cast(replace)) {
-        if (!rep->type.isA(typeFeedback) && rep->typeFeedback.isVoid())
+        if (!rep->type.isA(typeFeedback) && rep->typeFeedback.isVoid()) {
             rep->typeFeedback = typeFeedback;
+            rep->typeFeedbackOrigin = typeFeedbackOrigin;
+        }
     }
 }
 
@@ -445,6 +449,8 @@ void LdFun::printArgs(std::ostream& out, bool tty) const {
 
 void LdArg::printArgs(std::ostream& out, bool tty) const { out << id; }
 
+void LdArgDots::printArgs(std::ostream& out, bool tty) const { out << id; }
+
 void StVar::printArgs(std::ostream& out, bool tty) const {
     if (isStArg)
         out << "(StArg) ";
@@ -617,6 +623,7 @@ void FrameState::printArgs(std::ostream& out, bool tty) const {
 }
 
 void ScheduledDeopt::consumeFrameStates(Deopt* deopt) {
+    reason = deopt->reason;
     std::vector<FrameState*> frameStates;
     {
         auto sp = deopt->frameState();
@@ -762,6 +769,9 @@ Assumptions CallInstruction::inferAvailableAssumptions() const {
             auto missing = cls->nargs() - nCallArgs();
             given.numMissing(missing);
             given.add(Assumption::NotTooFewArguments);
+        } else if (cls->formals().hasDots()) {
+            // The surplus arguments are passed in ...
+            given.add(Assumption::NotTooFewArguments);
         }
     }
     given.add(Assumption::NotTooManyArguments);
@@ -785,8 +795,10 @@ NamedCall::NamedCall(Value* callerEnv, Value* fun,
     assert(names_.size() == args.size());
     pushArg(fun, RType::closure);
     for (unsigned i = 0; i < args.size(); ++i) {
-        pushArg(args[i], PirType(RType::prom) | RType::missing);
         auto name = Pool::get(names_[i]);
+        pushArg(args[i], name == R_DotsSymbol
+                             ? PirType::dots()
+                             : PirType(RType::prom) | RType::missing);
         assert(TYPEOF(name) == SYMSXP || name == R_NilValue);
         names.push_back(name);
     }
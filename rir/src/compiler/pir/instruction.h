@@ -711,6 +711,23 @@ class FLI(LdArg, 0, Effects::None()) {
     int minReferenceCount() const override { return MAX_REFCOUNT; }
 };
 
+// Loads the arguments from the given position on as a ... list, or missing if
+// there are none
+class FLI(LdArgDots, 0, Effects::None()) {
+  public:
+    size_t id;
+
+    explicit LdArgDots(size_t id)
+        : FixedLenInstruction(PirType::dots()), id(id) {}
+
+    void printArgs(std::ostream& out, bool tty) const override;
+
+    size_t gvnBase() const override {
+        return hash_combine(InstructionImplementation::gvnBase(), id);
+    }
+    int minReferenceCount() const override { return MAX_REFCOUNT; }
+};
+
 class FLIE(Missing, 1, Effects() | Effect::ReadsEnv) {
   public:
     SEXP varName;
@@ -1610,6 +1627,19 @@ class BuiltinCallFactory {
                             const std::vector<Value*>& args, unsigned srcIdx);
 };
 
+// A ... list of statically known length, eg. the one passed to an inlined
+// closure. Without values it is missing.
+class VLI(MkDots, Effects::None()) {
+  public:
+    explicit MkDots(const std::vector<Value*>& values)
+        : VarLenInstruction(PirType::dots()) {
+        for (auto v : values)
+            pushArg(v, PirType::any());
+    }
+
+    int minReferenceCount() const override { return MAX_REFCOUNT; }
+};
+
 class VLIE(MkEnv, Effects::None()) {
   public:
     std::vector<SEXP> varName;
@@ -1751,6 +1781,8 @@ class Checkpoint : public FixedLenInstruction<Tag::Checkpoint, Checkpoint, 0,
 class Deopt : public FixedLenInstruction<Tag::Deopt, Deopt, 1, Effects::Any(),
                                          HasEnvSlot::No, Controlflow::Exit> {
   public:
+    // Why the optimized code was left, recorded by the runtime
+    DeoptReason reason = DeoptReason::unknown();
     explicit Deopt(FrameState* frameState)
         : FixedLenInstruction(PirType::voyd(), {{NativeType::frameState}},
                               {{frameState}}) {}
@@ -1764,6 +1796,8 @@ class Deopt : public FixedLenInstruction<Tag::Deopt, Deopt, 1, Effects::Any(),
 class FLI(Assume, 2, Effect::TriggerDeopt) {
   public:
     bool assumeTrue = true;
+    // The kind of speculation and the feedback it is based on
+    DeoptReason reason = DeoptReason::unknown();
     Assume(Value* test, Value* checkpoint)
         : FixedLenInstruction(PirType::voyd(),
                               {{NativeType::test, NativeType::checkpoint}},
@@ -1787,6 +1821,7 @@ class ScheduledDeopt
                                Controlflow::Exit> {
   public:
     std::vector<FrameInfo> frames;
+    DeoptReason reason = DeoptReason::unknown();
     ScheduledDeopt() : VarLenInstruction(PirType::voyd()) {}
     void consumeFrameStates(Deopt* deopt);
     void printArgs(std::ostream& out, bool tty) const override;
@@ -42,6 +42,7 @@
     V(LdVar)                                                                   \
     V(LdConst)                                                                 \
     V(LdArg)                                                                   \
+    V(LdArgDots)                                                               \
     V(StVarSuper)                                                              \
     V(LdVarSuper)                                                              \
     V(StVar)                                                                   \
@@ -63,6 +64,7 @@
     V(StaticCall)                                                              \
     V(CallBuiltin)                                                             \
     V(CallSafeBuiltin)                                                         \
+    V(MkDots)                                                                  \
     V(MkEnv)                                                                   \
     V(PushContext)                                                             \
     V(PopContext)                                                              \
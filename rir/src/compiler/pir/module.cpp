@@ -1,5 +1,7 @@
 #include "module.h"
+#include "../util/visitor.h"
 #include "pir_impl.h"
+#include "utils/Pool.h"
 
 namespace rir {
 namespace pir {
@@ -25,11 +27,99 @@ Closure* Module::getOrDeclareRirClosure(const std::string& name, SEXP closure,
                                         rir::Function* f) {
     auto env = getEnv(CLOENV(closure));
     if (!closures.count(Idx(f, env))) {
+        addWeakRef(CLOENV(closure), closure);
         closures[Idx(f, env)] = new Closure(name, closure, f, env);
     }
     return closures.at(Idx(f, env));
 }
 
+Module::Module() {
+    weakRefs = CONS_NR(R_NilValue, R_NilValue);
+    R_PreserveObject(weakRefs);
+}
+
+SEXP Module::addWeakRef(SEXP env, SEXP value) {
+    assert(TYPEOF(env) == ENVSXP);
+    SEXP ref = PROTECT(R_MakeWeakRef(env, value, R_NilValue, FALSE));
+    SETCDR(weakRefs, CONS_NR(ref, CDR(weakRefs)));
+    UNPROTECT(1);
+    return ref;
+}
+
+SEXP Module::pin() const {
+    std::vector<SEXP> keys;
+    for (SEXP r = CDR(weakRefs); r != R_NilValue; r = CDR(r)) {
+        // Keys of collected environments are cleared
+        SEXP key = R_WeakRefKey(CAR(r));
+        if (key == R_NilValue)
+            return nullptr;
+        keys.push_back(key);
+    }
+    // The pool slots are not retained, they might be reused by now
+    for (auto& c : weakConstants) {
+        SEXP value = R_WeakRefValue(c.second);
+        if (value == R_NilValue)
+            value = R_WeakRefKey(c.second);
+        if (value == R_NilValue || Pool::get(c.first) != value)
+            return nullptr;
+    }
+
+    // Nothing allocated so far, thus nothing was collected in between
+    SEXP res = Rf_allocVector(VECSXP, keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+        SET_VECTOR_ELT(res, i, keys[i]);
+    return res;
+}
+
+// Only vectors are counted, they are the constants which can get big
+static size_t constantSize(SEXP c) {
+    switch (TYPEOF(c)) {
+    case LGLSXP:
+    case INTSXP:
+        return XLENGTH(c) * sizeof(int);
+    case REALSXP:
+        return XLENGTH(c) * sizeof(double);
+    case CPLXSXP:
+        return XLENGTH(c) * sizeof(Rcomplex);
+    case STRSXP:
+    case VECSXP:
+        return XLENGTH(c) * sizeof(SEXP);
+    case RAWSXP:
+        return XLENGTH(c);
+    default:
+        return 0;
+    }
+}
+
+void Module::markOptimized() {
+    auto retain = [&](Instruction* i) {
+        bytes += sizeof(Instruction) + i->nargs() * sizeof(InstrArg);
+        if (auto ld = LdConst::Cast(i)) {
+            SEXP c = ld->c();
+            if (TYPEOF(c) == ENVSXP) {
+                weakConstants.emplace_back(ld->idx, addWeakRef(c));
+            } else if (TYPEOF(c) == CLOSXP) {
+                weakConstants.emplace_back(ld->idx,
+                                           addWeakRef(CLOENV(c), c));
+            } else {
+                Pool::retainConstant(ld->idx);
+                constants.push_back(ld->idx);
+                bytes += constantSize(c);
+            }
+        }
+        // Hints are only needed by the optimizer, nothing keeps them alive
+        if (auto ld = LdFun::Cast(i))
+            ld->hint = nullptr;
+    };
+    eachPirClosureVersion([&](ClosureVersion* v) {
+        if (v->optimized)
+            return;
+        v->optimized = true;
+        Visitor::run(v->entry, retain);
+        v->eachPromise([&](Promise* p) { Visitor::run(p->entry, retain); });
+    });
+}
+
 void Module::eachPirClosure(PirClosureIterator it) {
     for (auto& c : closures)
         it(c.second);
@@ -48,6 +138,7 @@ Env* Module::getEnv(SEXP rho) {
         return environments.at(rho);
 
     assert(TYPEOF(rho) == ENVSXP);
+    addWeakRef(rho);
     Env* parent = getEnv(ENCLOS(rho));
     Env* env = new Env(rho, parent);
     environments[rho] = env;
@@ -55,6 +146,9 @@ Env* Module::getEnv(SEXP rho) {
 }
 
 Module::~Module() {
+    R_ReleaseObject(weakRefs);
+    for (auto i : constants)
+        Pool::releaseConstant(i);
     for (auto& e : environments)
         delete e.second;
     for (auto& cs : closures)
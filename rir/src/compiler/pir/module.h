@@ -2,6 +2,7 @@
 #define PIR_MODULE_H
 
 #include "R/r.h"
+#include "ir/BC_inc.h"
 #include <functional>
 #include <iostream>
 #include <map>
@@ -15,12 +16,49 @@
 namespace rir {
 namespace pir {
 
+/*
+ * Module
+ *
+ * Optimized versions stay in the module after they were compiled back to rir,
+ * thus later compilations reuse them for inlining and static calls. Closures
+ * and environments are looked up by address, but the module only holds weak
+ * references to them: environments are never kept alive, closures only as
+ * long as their environment is. Once one of them is collected the module must
+ * not be used anymore, see pin. Inner functions are reached through the code
+ * of their outer closure.
+ *
+ * The constant pool entries loaded by optimized versions are retained, except
+ * for closures and environments, which are referenced weakly as well.
+ */
 class Module {
     std::unordered_map<SEXP, Env*> environments;
+    // Pairlist of the weak references, with a preserved head cell
+    SEXP weakRefs;
+    // Closures and environments loaded by optimized versions
+    std::vector<std::pair<BC::PoolIdx, SEXP>> weakConstants;
+    std::vector<BC::PoolIdx> constants;
+    size_t bytes = 0;
+
+    // The value is kept alive as long as the environment is
+    SEXP addWeakRef(SEXP env, SEXP value = R_NilValue);
 
   public:
+    Module();
+    Module(const Module&) = delete;
+
     Env* getEnv(SEXP);
 
+    // Approximate size of the optimized versions and their constants
+    size_t memoryUsage() const { return bytes; }
+
+    // The environments the module refers to, which keep its closures alive.
+    // To be protected while the module is used. nullptr if something the
+    // module refers to was collected already.
+    SEXP pin() const;
+
+    // Marks the versions as optimized, they are kept for later compilations
+    void markOptimized();
+
     void print(std::ostream& out = std::cout, bool tty = false);
 
     Closure* getOrDeclareRirFunction(const std::string& name, rir::Function* f,
@@ -217,6 +217,10 @@ struct PirType {
         return PirType(RType::cons) | RType::nil;
     }
     static constexpr PirType any() { return val().orLazy(); }
+    // The value of `...`, missing if it is empty
+    static constexpr PirType dots() {
+        return PirType(RType::cons) | RType::missing;
+    }
 
     RIR_INLINE bool maybeMissing() const {
         if (!isRType())
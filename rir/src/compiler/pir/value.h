@@ -1,6 +1,7 @@
 #ifndef COMPILER_VALUE_H
 #define COMPILER_VALUE_H
 
+#include "ir/Deoptimization.h"
 #include "type.h"
 
 #include <functional>
@@ -24,6 +25,8 @@ class Value {
   public:
     PirType type;
     PirType typeFeedback = PirType::optimistic();
+    // The record_type_ instruction the feedback was read from, if any
+    FeedbackOrigin typeFeedbackOrigin = {nullptr, nullptr};
     Tag tag;
     Value(PirType type, Tag tag) : type(type), tag(tag) {}
     virtual void printRef(std::ostream& out) const = 0;
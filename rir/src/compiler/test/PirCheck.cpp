@@ -1,5 +1,6 @@
 #include "PirCheck.h"
 #include "../../ir/Compiler.h"
+#include "../analysis/loop_detection.h"
 #include "../analysis/query.h"
 #include "../analysis/verifier.h"
 #include "../pir/pir_impl.h"
@@ -95,6 +96,25 @@ static bool testNoExternalCalls(ClosureVersion* f) {
     });
 }
 
+static bool testNoLoadInLoop(ClosureVersion* f) {
+    LoopDetection loops(f);
+    for (auto& loop : loops)
+        for (auto bb : loop)
+            for (auto i : *bb)
+                if (LdVar::Cast(i) || LdFun::Cast(i) || LdVarSuper::Cast(i))
+                    return false;
+    return true;
+}
+
+static bool testNoBoundsChecks(ClosureVersion* f) {
+    return Visitor::check(f->entry, [&](Instruction* i) {
+        if (!Extract1_1D::Cast(i) && !Extract2_1D::Cast(i) &&
+            !Subassign1_1D::Cast(i) && !Subassign2_1D::Cast(i))
+            return true;
+        return !i->effects.includes(Effect::Error);
+    });
+}
+
 static bool testReturns42L(ClosureVersion* f) {
     if (!Query::noEnv(f))
         return false;
@@ -16,6 +16,8 @@ namespace rir {
     V(NoEnv)                                                                   \
     V(NoPromise)                                                               \
     V(NoExternalCalls)                                                         \
+    V(NoLoadInLoop)                                                            \
+    V(NoBoundsChecks)                                                          \
     V(Returns42L)                                                              \
     V(NoAsInt)                                                                 \
     V(NoEq)                                                                    \
@@ -57,6 +57,7 @@ BB* BBTransform::clone(BB* src, Code* target, ClosureVersion* targetClosure) {
                     auto c = targetClosure->createProm(p->srcPoolIdx());
                     c->entry = clone(p->entry, c, targetClosure);
                     mk->updatePromise(c);
+                    promMap[p] = c;
                 }
             }
         }
@@ -76,13 +77,15 @@ BB* BBTransform::splitEdge(size_t next_id, BB* from, BB* to, Code* target) {
     else
         from->next1 = split;
 
-    Visitor::run(split, [&](Instruction* i) {
+    // Only the phis in to are affected, phis further down might still merge
+    // the other branch of from.
+    for (auto i : *to) {
         if (auto phi = Phi::Cast(i)) {
             for (size_t j = 0; j < phi->nargs(); ++j)
                 if (phi->inputAt(j) == from)
                     phi->updateInputAt(j, split);
         }
-    });
+    }
 
     return split;
 }
@@ -189,22 +192,23 @@ BB* BBTransform::lowerExpect(Code* code, BB* src, BB::Instrs::iterator position,
     return split;
 }
 
-void BBTransform::insertAssume(Value* condition, Checkpoint* cp, BB* bb,
-                               BB::Instrs::iterator& position,
-                               bool assumePositive) {
+Assume* BBTransform::insertAssume(Value* condition, Checkpoint* cp, BB* bb,
+                                  BB::Instrs::iterator& position,
+                                  bool assumePositive) {
     position = bb->insert(position, (Instruction*)condition);
     auto assume = new Assume(condition, cp);
     if (!assumePositive)
         assume->Not();
     position = bb->insert(position + 1, assume);
     position++;
+    return assume;
 };
 
-void BBTransform::insertAssume(Value* condition, Checkpoint* cp,
-                               bool assumePositive) {
+Assume* BBTransform::insertAssume(Value* condition, Checkpoint* cp,
+                                  bool assumePositive) {
     auto contBB = cp->bb()->trueBranch();
     auto contBegin = contBB->begin();
-    insertAssume(condition, cp, contBB, contBegin, assumePositive);
+    return insertAssume(condition, cp, contBB, contBegin, assumePositive);
 }
 
 void BBTransform::renumber(Code* fun) {
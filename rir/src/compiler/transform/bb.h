@@ -8,6 +8,7 @@
 namespace rir {
 namespace pir {
 
+class Assume;
 class FrameState;
 class Checkpoint;
 class BBTransform {
@@ -22,11 +23,11 @@ class BBTransform {
                            BB::Instrs::iterator position, Value* condition,
                            bool expected, BB* deoptBlock,
                            const std::string& debugMesage);
-    static void insertAssume(Value* condition, Checkpoint* cp, BB* bb,
-                             BB::Instrs::iterator& position,
-                             bool assumePositive);
-    static void insertAssume(Value* condition, Checkpoint* cp,
-                             bool assumePositive);
+    static Assume* insertAssume(Value* condition, Checkpoint* cp, BB* bb,
+                                BB::Instrs::iterator& position,
+                                bool assumePositive);
+    static Assume* insertAssume(Value* condition, Checkpoint* cp,
+                                bool assumePositive);
 
     // Renumber in dominance order. This ensures that controlflow always goes
     // from smaller id to bigger id, except for back-edges.
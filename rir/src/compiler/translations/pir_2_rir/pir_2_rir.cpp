@@ -22,6 +22,7 @@
 #include <chrono>
 #include <iomanip>
 #include <list>
+#include <memory>
 #include <sstream>
 
 namespace rir {
@@ -500,6 +501,11 @@ class Pir2Rir {
     bool dryRun;
     LogStream& log;
 
+    // (symbol, environment, builtin) triples of the guards removed by
+    // elideBindingGuard, see rir::Function::bindingDependencies
+    std::vector<SEXP> bindingDependencies;
+    bool elideBindingGuard(Assume* assume);
+
     class CodeBuffer {
       private:
         struct Src {
@@ -990,6 +996,12 @@ rir::Code* Pir2Rir::compileCode(Context& ctx, Code* code) {
                 break;
             }
 
+            case Tag::LdArgDots: {
+                auto ld = LdArgDots::Cast(instr);
+                cb.add(BC::ldargDots(ld->id));
+                break;
+            }
+
             case Tag::StVarSuper: {
                 auto stvar = StVarSuper::Cast(instr);
                 cb.add(BC::stvarSuper(stvar->varName));
@@ -1162,37 +1174,43 @@ rir::Code* Pir2Rir::compileCode(Context& ctx, Code* code) {
                 auto call = StaticCall::Cast(instr);
                 SEXP originalClosure = call->cls()->rirClosure();
                 auto dt = DispatchTable::unpack(BODY(originalClosure));
+                // If dispatching goes wrong, let's put the baseline there
+                SEXP version = dt->baseline()->container();
+                Protect p;
                 if (auto trg = call->tryOptimisticDispatch()) {
-                    // Avoid recursivly compiling the same closure
+                    // Avoid recursivly compiling the same closure. A version
+                    // still being compiled is found by the dispatch on the
+                    // first call.
                     auto fun = compiler.alreadyCompiled(trg);
-                    SEXP funCont = nullptr;
-
+                    // Versions kept in the module from earlier compilations
+                    // are installed already
+                    if (!fun && !compiler.isCompiling(trg)) {
+                        auto installed = dt->find(trg->assumptions());
+                        if (installed &&
+                            installed->signature().optimization >=
+                                compiler.tier)
+                            fun = installed;
+                    }
                     if (fun) {
-                        funCont = fun->container();
+                        version = fun->container();
                     } else if (!compiler.isCompiling(trg)) {
                         fun = compiler.compile(trg, dryRun);
-                        funCont = fun->container();
-                        Protect p(funCont);
+                        version = p(fun->container());
                         assert(originalClosure &&
                                "Cannot compile synthetic closure");
                         dt->insert(fun);
+                    } else {
+                        version = R_NilValue;
                     }
-                    auto bc = BC::staticCall(call->nCallArgs(),
-                                             Pool::get(call->srcIdx),
-                                             originalClosure, funCont,
-                                             call->inferAvailableAssumptions());
-                    auto hint = bc.immediate.staticCallFixedArgs.versionHint;
-                    cb.add(std::move(bc));
-                    if (!funCont)
-                        compiler.needsPatching(trg, hint);
-                } else {
-                    // Something went wrong with dispatching, let's put the
-                    // baseline there
-                    cb.add(BC::staticCall(
-                        call->nCallArgs(), Pool::get(call->srcIdx),
-                        originalClosure, dt->baseline()->container(),
-                        call->inferAvailableAssumptions()));
                 }
+                // The callee and its version are owned by this code, thus
+                // they are not kept alive once the code is not needed anymore
+                auto& cs = ctx.cs();
+                cb.add(BC::staticCall(call->nCallArgs(),
+                                      Pool::get(call->srcIdx),
+                                      cs.addExtraPoolEntry(originalClosure),
+                                      cs.addExtraPoolEntry(version),
+                                      call->inferAvailableAssumptions()));
                 break;
             }
 
@@ -1226,6 +1244,11 @@ rir::Code* Pir2Rir::compileCode(Context& ctx, Code* code) {
                 break;
             }
 
+            case Tag::MkDots: {
+                cb.add(BC::mkDots(instr->nargs()));
+                break;
+            }
+
             case Tag::MkEnv: {
                 auto mkenv = MkEnv::Cast(instr);
                 cb.add(BC::mkEnv(mkenv->varName, mkenv->context, mkenv->stub));
@@ -1275,6 +1298,7 @@ rir::Code* Pir2Rir::compileCode(Context& ctx, Code* code) {
                     Rf_allocVector(RAWSXP, sizeof(DeoptMetadata) +
                                                nframes * sizeof(FrameInfo));
                 auto m = new (DATAPTR(store)) DeoptMetadata;
+                m->reason = deopt->reason;
                 m->numFrames = nframes;
 
                 size_t i = 0;
@@ -1351,7 +1375,93 @@ static bool coinFlip() {
     return coin(gen);
 };
 
+// Nothing in the code can change the bindings of static environments (apart
+// from warning handlers and finalizers, which we do not track). Promises are
+// not part of the code, forcing them is an effect of the force instruction.
+static bool bindingsStable(Code* code) {
+    Effects mayRunCode =
+        Effects(Effect::ExecuteCode) | Effect::Force | Effect::Reflection;
+    bool stable = true;
+    Visitor::run(code->entry, [&](Instruction* i) {
+        if (i->effects.intersects(mayRunCode) || StVarSuper::Cast(i) ||
+            (i->changesEnv() && !MkEnv::Cast(i->env())))
+            stable = false;
+    });
+    return stable;
+}
+
+static DeoptReason& deoptReason(BB* deoptBranch) {
+    if (auto deopt = Deopt::Cast(deoptBranch->last()))
+        return deopt->reason;
+    return ScheduledDeopt::Cast(deoptBranch->last())->reason;
+}
+
+// Deopt branches are a single BB, only the arguments defined in the branch
+// itself need to be relocated
+static BB* cloneDeoptBranch(Code* code, BB* deoptBranch) {
+    auto copy = BB::cloneInstrs(deoptBranch, code->nextBBId++, code);
+    std::unordered_map<Value*, Instruction*> relocs;
+    for (size_t i = 0; i < deoptBranch->size(); ++i)
+        relocs[deoptBranch->at(i)] = copy->at(i);
+    for (auto i : *copy) {
+        i->eachArg([&](InstrArg& arg) {
+            auto r = relocs.find(arg.val());
+            if (r != relocs.end())
+                arg.val() = r->second;
+        });
+    }
+    return copy;
+}
+
+// EagerCalls guards builtins with Assume(Identical(LdVar(name, env), builtin)).
+// If env is a static environment, the guard can be replaced by a dependency of
+// the function on the binding, which the interpreter checks before entering
+// the function.
+bool Pir2Rir::elideBindingGuard(Assume* assume) {
+    auto test = Identical::Cast(assume->condition());
+    if (!assume->assumeTrue || !test)
+        return false;
+    auto given = LdVar::Cast(test->arg(0).val());
+    auto expected = LdConst::Cast(test->arg(1).val());
+    if (!given || !expected || TYPEOF(expected->c()) != BUILTINSXP)
+        return false;
+    auto env = Env::Cast(given->env());
+    if (!env || !env->rho ||
+        Rf_findVar(given->varName, env->rho) != expected->c())
+        return false;
+
+    for (size_t i = 0; i < bindingDependencies.size(); i += 3)
+        if (bindingDependencies[i] == given->varName &&
+            bindingDependencies[i + 1] == env->rho)
+            return true;
+    bindingDependencies.push_back(given->varName);
+    bindingDependencies.push_back(env->rho);
+    bindingDependencies.push_back(expected->c());
+    return true;
+}
+
 void Pir2Rir::lower(Code* code) {
+    // Guards of builtin bindings are only removed from the function body,
+    // promises might run long after the dependencies were checked.
+    bool elideBindingGuards = code == cls && bindingsStable(code);
+    std::unordered_set<Instruction*> elidedGuards;
+
+    // Assumptions guarded by the same checkpoint share its deopt branch. To
+    // let the runtime know which speculation failed, every distinct reason
+    // gets its own copy of the branch.
+    std::unordered_map<BB*, std::vector<BB*>> deoptBranches;
+    auto deoptBranchFor = [&](Assume* assume) {
+        auto original = assume->checkpoint()->deoptBranch();
+        auto& branches = deoptBranches[original];
+        for (auto b : branches)
+            if (deoptReason(b) == assume->reason)
+                return b;
+        auto branch =
+            branches.empty() ? original : cloneDeoptBranch(code, original);
+        deoptReason(branch) = assume->reason;
+        branches.push_back(branch);
+        return branch;
+    };
 
     Visitor::runPostChange(code->entry, [&](BB* bb) {
         auto it = bb->begin();
@@ -1373,6 +1483,13 @@ void Pir2Rir::lower(Code* code) {
                 newDeopt->consumeFrameStates(deopt);
                 bb->replace(it, newDeopt);
             } else if (auto expect = Assume::Cast(*it)) {
+                if (elideBindingGuards && elideBindingGuard(expect)) {
+                    elidedGuards.insert(
+                        Instruction::Cast(expect->condition()));
+                    next = bb->remove(it);
+                    it = next;
+                    continue;
+                }
                 auto condition = expect->condition();
                 if (Parameter::DEOPT_CHAOS && coinFlip()) {
                     condition = expect->assumeTrue ? (Value*)False::instance()
@@ -1389,9 +1506,9 @@ void Pir2Rir::lower(Code* code) {
                     code->printCode(dump, false, false);
                     debugMessage += dump.str();
                 }
-                BBTransform::lowerExpect(
-                    code, bb, it, condition, expect->assumeTrue,
-                    expect->checkpoint()->bb()->falseBranch(), debugMessage);
+                BBTransform::lowerExpect(code, bb, it, condition,
+                                         expect->assumeTrue,
+                                         deoptBranchFor(expect), debugMessage);
                 // lowerExpect splits the bb from current position. There
                 // remains nothing to process. Breaking seems more robust
                 // than trusting the modified iterator.
@@ -1402,6 +1519,19 @@ void Pir2Rir::lower(Code* code) {
         }
     });
 
+    // Remove the loads and tests of the elided guards, unless they are shared
+    // with other instructions
+    for (auto test : elidedGuards) {
+        if (!test->unused())
+            continue;
+        auto given = Instruction::Cast(test->arg(0).val());
+        auto expected = Instruction::Cast(test->arg(1).val());
+        test->bb()->remove(test);
+        for (auto i : {given, expected})
+            if (i && i->unused())
+                i->bb()->remove(i);
+    }
+
     Visitor::run(code->entry, [&](BB* bb) {
         auto it = bb->begin();
         while (it != bb->end()) {
@@ -1482,21 +1612,33 @@ rir::Function* Pir2Rir::finalize() {
     FunctionWriter function;
     Context ctx(function);
 
-    FunctionSignature signature(FunctionSignature::Environment::CalleeCreated,
-                                FunctionSignature::OptimizationLevel::Optimized,
-                                cls->assumptions());
+    // Continuations run in the environment of the frame they replace
+    FunctionSignature signature(
+        cls->isContinuation() ? FunctionSignature::Environment::CallerProvided
+                              : FunctionSignature::Environment::CalleeCreated,
+        compiler.tier, cls->assumptions());
+    if (cls->isContinuation())
+        signature.osrEntry =
+            cls->osrEntry - cls->owner()->rirFunction()->body()->code();
 
     // PIR does not support default args currently.
     for (size_t i = 0; i < cls->nargs(); ++i) {
         function.addArgWithoutDefault();
         signature.pushDefaultArgument();
     }
+    signature.hasDotsFormals = cls->owner()->formals().hasDots();
 
     assert(signature.formalNargs() == cls->nargs());
     ctx.push(R_NilValue);
     auto body = compileCode(ctx, cls);
     log.finalPIR(cls);
     function.finalize(body, signature);
+    if (!bindingDependencies.empty()) {
+        SEXP deps = Rf_allocVector(VECSXP, bindingDependencies.size());
+        for (size_t i = 0; i < bindingDependencies.size(); ++i)
+            SET_VECTOR_ELT(deps, i, bindingDependencies[i]);
+        function.function()->bindingDependencies(deps);
+    }
 #ifdef ENABLE_SLOWASSERT
     CodeVerifier::verifyFunctionLayout(function.function()->container(),
                                        globalContext());
@@ -1510,16 +1652,12 @@ rir::Function* Pir2Rir::finalize() {
 rir::Function* Pir2RirCompiler::compile(ClosureVersion* cls, bool dryRun) {
     auto& log = logger.get(cls);
     done[cls] = nullptr;
-    Pir2Rir pir2rir(*this, cls, dryRun, log);
+    // Lowering destroys the version, the module keeps the optimized one
+    std::unique_ptr<ClosureVersion> copy(cls->copy());
+    Pir2Rir pir2rir(*this, copy.get(), dryRun, log);
     auto fun = pir2rir.finalize();
     done[cls] = fun;
     log.flush();
-    if (fixup.count(cls)) {
-        auto fixups = fixup.find(cls);
-        for (auto idx : fixups->second)
-            Pool::patch(idx, fun->container());
-        fixup.erase(fixups);
-    }
     return fun;
 }
 
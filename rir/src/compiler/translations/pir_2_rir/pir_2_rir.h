@@ -14,24 +14,26 @@ namespace pir {
 
 class Pir2RirCompiler {
   public:
-    explicit Pir2RirCompiler(StreamLogger& logger) : logger(logger) {}
+    explicit Pir2RirCompiler(StreamLogger& logger,
+                             FunctionSignature::OptimizationLevel tier =
+                                 FunctionSignature::OptimizationLevel::Optimized)
+        : logger(logger), tier(tier) {}
     Pir2RirCompiler(const Pir2RirCompiler&) = delete;
     Pir2RirCompiler& operator=(const Pir2RirCompiler&) = delete;
 
     rir::Function* compile(ClosureVersion* cls, bool dryRun);
 
     StreamLogger& logger;
+    // Tier of the signature of all generated functions
+    const FunctionSignature::OptimizationLevel tier;
 
     Function* alreadyCompiled(ClosureVersion* cls) {
         return done.count(cls) ? done.at(cls) : nullptr;
     }
     bool isCompiling(ClosureVersion* cls) { return done.count(cls); }
 
-    void needsPatching(ClosureVersion* c, size_t i) { fixup[c].insert(i); }
-
   private:
     std::unordered_map<ClosureVersion*, Function*> done;
-    std::unordered_map<ClosureVersion*, std::unordered_set<size_t>> fixup;
 };
 
 } // namespace pir
@@ -170,6 +170,95 @@ Value* Rir2Pir::tryCreateArg(rir::Code* promiseCode, Builder& insert,
     return theArg;
 }
 
+Rir2Pir::CallTargetVersions Rir2Pir::compileCallTargets(
+    const ObservedCallees& feedback, rir::Code* srcCode, size_t nargs,
+    const Assumptions& given, const std::string& name, bool& complete) const {
+    // If the feedback is not saturated, we have seen all targets
+    complete = feedback.numTargets < ObservedCallees::MaxTargets;
+
+    CallTargetVersions versions;
+    for (size_t i = 0; i < feedback.numTargets; ++i) {
+        auto target = feedback.getTarget(srcCode, i);
+        if (!isValidClosureSEXP(target) ||
+            DispatchTable::unpack(BODY(target))->baseline()->unoptimizable) {
+            complete = false;
+            continue;
+        }
+
+        // Like the monomorphic case, only targets which take the arguments
+        // positionally
+        FormalArgs formals(FORMALS(target));
+        size_t needed = formals.nargs();
+        if (needed < nargs && !formals.hasDots()) {
+            complete = false;
+            continue;
+        }
+        Assumptions targetGiven = given;
+        if (needed > nargs)
+            targetGiven.numMissing(needed - nargs);
+        targetGiven.add(Assumption::NotTooFewArguments);
+        targetGiven.add(Assumption::NotTooManyArguments);
+        targetGiven.add(Assumption::CorrectOrderOfArguments);
+        compiler.compileClosure(
+            target, name, targetGiven,
+            [&](ClosureVersion* f) { versions.emplace_back(target, f); },
+            [&]() { complete = false; });
+    }
+    return versions;
+}
+
+Value* Rir2Pir::insertCallSwitch(
+    rir::Code* srcCode, Opcode* nextPos, RirStack& stack, Builder& insert,
+    Value* callee, const CallTargetVersions& versions,
+    const std::vector<Value*>& args, unsigned ast,
+    const std::function<Value*()>& fallback) const {
+    assert(!versions.empty());
+
+    BB* merge = insert.createBB();
+    std::vector<std::pair<BB*, Value*>> results;
+    for (auto& v : versions) {
+        // Unlike the monomorphic guard, the callee itself is compared. A
+        // mismatch does not necessarily deopt, thus the ldfun is needed
+        // anyway.
+        Value* expected = insert(new LdConst(v.first));
+        insert(new Branch(insert(new Identical(callee, expected))));
+        BB* match = insert.createBB();
+        BB* next = insert.createBB();
+        insert.setBranch(match, next);
+
+        insert.enterBB(match);
+        auto fs = insert.registerFrameState(srcCode, nextPos, stack);
+        auto res = insert(
+            new StaticCall(insert.env, v.second->owner(), args, fs, ast));
+        results.emplace_back(insert.getCurrentBB(), res);
+        insert.setNext(merge);
+
+        insert.enterBB(next);
+    }
+
+    if (auto res = fallback()) {
+        results.emplace_back(insert.getCurrentBB(), res);
+        insert.setNext(merge);
+    }
+
+    insert.enterBB(merge);
+    Value* res;
+    if (results.size() == 1) {
+        res = results.back().second;
+    } else {
+        Phi* phi = insert(new Phi());
+        for (auto r : results)
+            phi->addInput(r.first, r.second);
+        phi->updateType();
+        res = phi;
+    }
+    // The calls are deopt barriers, but not the last instruction
+    stack.push(res);
+    addCheckpoint(srcCode, nextPos, stack, insert);
+    stack.pop();
+    return res;
+}
+
 bool Rir2Pir::compileBC(const BC& bc, Opcode* pos, Opcode* nextPos,
                         rir::Code* srcCode, RirStack& stack, Builder& insert,
                         CallTargetFeedback& callTargetFeedback) const {
@@ -291,8 +380,10 @@ bool Rir2Pir::compileBC(const BC& bc, Opcode* pos, Opcode* nextPos,
     }
 
     case Opcode::record_type_: {
-        if (bc.immediate.typeFeedback.numTypes)
+        if (bc.immediate.typeFeedback.numTypes) {
             at(0)->typeFeedback.merge(bc.immediate.typeFeedback);
+            at(0)->typeFeedbackOrigin = {srcCode, pos};
+        }
         break;
     }
 
@@ -307,14 +398,29 @@ bool Rir2Pir::compileBC(const BC& bc, Opcode* pos, Opcode* nextPos,
         Value* callee = top();
         SEXP monomorphic = nullptr;
 
-        // TODO: Support ...
-        for (auto argi : bc.callExtra().immediateCallArguments) {
-            if (argi == DOTS_ARG_IDX) {
-                log.warn("Cannot compile call with ... arguments");
-                return false;
+        // Calls passing ... become named calls, where the dots list of the
+        // current environment is an argument named `...`. The interpreter
+        // splices in its elements. Such calls are not specialized.
+        bool forwardsDots = false;
+        {
+            size_t i = 0;
+            for (auto argi : bc.callExtra().immediateCallArguments) {
+                if (argi == DOTS_ARG_IDX)
+                    forwardsDots = true;
+                else if (bc.bc == Opcode::named_call_implicit_ &&
+                         Pool::get(bc.callExtra().callArgumentNames[i]) ==
+                             R_DotsSymbol) {
+                    log.warn("Cannot compile call with an argument named ...");
+                    return false;
+                }
+                i++;
             }
         }
 
+        // Polymorphic call sites dispatch to the observed closures by
+        // comparing the callee against each of them
+        bool polymorphic = false;
+
         // See if the call feedback suggests a monomorphic target
         // TODO: Deopts in promises are not supported by the promise inliner. So
         // currently it does not pay off to put any deopts in there.
@@ -331,19 +437,25 @@ bool Rir2Pir::compileBC(const BC& bc, Opcode* pos, Opcode* nextPos,
                 if (*deoptPos == Opcode::record_call_) {
                     auto fs =
                         insert.registerFrameState(srcCode, deoptPos, stack);
-                    insert(new Deopt(fs));
+                    auto deopt = insert(new Deopt(fs));
+                    deopt->reason = {DeoptReason::Calltarget,
+                                     {srcCode, deoptPos}};
                     stack.clear();
                     break;
                 }
             }
 
-            if (feedback.taken > 1 && feedback.numTargets == 1)
+            if (feedback.taken > 1 && feedback.numTargets == 1) {
                 monomorphic = feedback.getTarget(srcCode, 0);
+            } else if (feedback.taken > 1 && feedback.numTargets > 1 &&
+                       !forwardsDots && bc.bc == Opcode::call_implicit_) {
+                polymorphic = true;
+            }
         }
 
         bool monomorphicClosure =
-            monomorphic && isValidClosureSEXP(monomorphic);
-        bool monomorphicBuiltin = monomorphic &&
+            monomorphic && !forwardsDots && isValidClosureSEXP(monomorphic);
+        bool monomorphicBuiltin = monomorphic && !forwardsDots &&
                                   TYPEOF(monomorphic) == BUILTINSXP &&
                                   // TODO implement support for call_builtin_
                                   // with names
@@ -370,6 +482,7 @@ bool Rir2Pir::compileBC(const BC& bc, Opcode* pos, Opcode* nextPos,
             }
             monomorphicBuiltin = monomorphicClosure = false;
             monomorphic = nullptr;
+            polymorphic = false;
         }
 
         Assume* assumption = nullptr;
@@ -390,8 +503,17 @@ bool Rir2Pir::compileBC(const BC& bc, Opcode* pos, Opcode* nextPos,
             if (ldfun && ldfun->varName != symbol::c)
                 given = insert(new LdVar(ldfun->varName, ldfun->env()));
             Value* t = insert(new Identical(given, expected));
-            auto cp = addCheckpoint(srcCode, pos, stack, insert);
-            assumption = insert(new Assume(t, cp));
+            // Like above, a failing guard deopts before the record call bc,
+            // such that the new target is recorded and we do not speculate
+            // on the old one again.
+            auto deoptPos = pos;
+            if (callTargetFeedback.count(callee) &&
+                *(pos - BC::recordCall().size()) == Opcode::record_call_)
+                deoptPos = pos - BC::recordCall().size();
+            auto cp = addCheckpoint(srcCode, deoptPos, stack, insert);
+            auto assume = new Assume(t, cp);
+            assume->reason = {DeoptReason::Calltarget, {srcCode, deoptPos}};
+            assumption = insert(assume);
         }
 
         // Compile the arguments (eager for builltins)
@@ -406,6 +528,10 @@ bool Rir2Pir::compileBC(const BC& bc, Opcode* pos, Opcode* nextPos,
                 if (argi == MISSING_ARG_IDX) {
                     args.push_back(MissingArg::instance());
                     given.remove(Assumption::NoExplicitlyMissingArgs);
+                } else if (argi == DOTS_ARG_IDX) {
+                    auto dots = new LdVar(R_DotsSymbol, insert.env);
+                    dots->type = PirType::dots();
+                    args.push_back(insert(dots));
                 } else {
                     rir::Code* promiseCode = srcCode->getPromise(argi);
                     bool eager = monomorphicBuiltin;
@@ -430,22 +556,42 @@ bool Rir2Pir::compileBC(const BC& bc, Opcode* pos, Opcode* nextPos,
                                     FORMALS(monomorphic),
                                     bc.callExtra().callArgumentNames, args);
 
-            size_t needed = RList(FORMALS(monomorphic)).length();
+            FormalArgs formals(FORMALS(monomorphic));
+            size_t needed = formals.nargs();
 
-            if (!correctOrder || needed < args.size()) {
+            // Surplus positional arguments are passed in ...
+            if (!correctOrder ||
+                (needed < args.size() &&
+                 (!formals.hasDots() ||
+                  bc.bc == Opcode::named_call_implicit_))) {
                 monomorphicClosure = false;
                 assert(assumption);
                 // Kill unnecessary speculation
                 assumption->arg<0>().val() = True::instance();
             }
 
-            missingArgs = needed - args.size();
+            if (needed > args.size())
+                missingArgs = needed - args.size();
         }
 
         // Emit the actual call
         auto ast = bc.immediate.callFixedArgs.ast;
         auto insertGenericCall = [&]() {
-            if (bc.bc == Opcode::named_call_implicit_) {
+            if (forwardsDots) {
+                std::vector<BC::PoolIdx> names;
+                size_t i = 0;
+                for (auto argi : bc.callExtra().immediateCallArguments) {
+                    if (argi == DOTS_ARG_IDX)
+                        names.push_back(Pool::insert(R_DotsSymbol));
+                    else if (bc.bc == Opcode::named_call_implicit_)
+                        names.push_back(bc.callExtra().callArgumentNames[i]);
+                    else
+                        names.push_back(Pool::insert(R_NilValue));
+                    i++;
+                }
+                push(insert(
+                    new NamedCall(insert.env, pop(), args, names, ast)));
+            } else if (bc.bc == Opcode::named_call_implicit_) {
                 push(insert(new NamedCall(insert.env, pop(), args,
                                           bc.callExtra().callArgumentNames,
                                           ast)));
@@ -480,6 +626,42 @@ bool Rir2Pir::compileBC(const BC& bc, Opcode* pos, Opcode* nextPos,
         } else if (monomorphicBuiltin) {
             pop();
             push(insert(BuiltinCallFactory::New(env, monomorphic, args, ast)));
+        } else if (polymorphic) {
+            std::string name = "";
+            if (ldfun)
+                name = CHAR(PRINTNAME(ldfun->varName));
+            bool complete;
+            auto versions =
+                compileCallTargets(callTargetFeedback.at(callee), srcCode,
+                                   args.size(), given, name, complete);
+
+            auto deoptPos = pos - BC::recordCall().size();
+            if (*deoptPos != Opcode::record_call_)
+                complete = false;
+            if (versions.empty()) {
+                insertGenericCall();
+            } else {
+                pop();
+                // Unseen targets deopt before the record call bc, such that
+                // they are recorded. Once the feedback is saturated, they go
+                // through a generic call.
+                auto fallback = [&]() -> Value* {
+                    push(callee);
+                    if (complete) {
+                        auto fs =
+                            insert.registerFrameState(srcCode, deoptPos, stack);
+                        pop();
+                        auto deopt = insert(new Deopt(fs));
+                        deopt->reason = {DeoptReason::Calltarget,
+                                         {srcCode, deoptPos}};
+                        return nullptr;
+                    }
+                    insertGenericCall();
+                    return pop();
+                };
+                push(insertCallSwitch(srcCode, nextPos, stack, insert, callee,
+                                      versions, args, ast, fallback));
+            }
         } else {
             insertGenericCall();
         }
@@ -505,23 +687,53 @@ bool Rir2Pir::compileBC(const BC& bc, Opcode* pos, Opcode* nextPos,
     case Opcode::named_call_:
     case Opcode::call_: {
         unsigned n = bc.immediate.callFixedArgs.nargs;
+        auto ast = bc.immediate.callFixedArgs.ast;
         std::vector<Value*> args(n);
         for (size_t i = 0; i < n; ++i)
             args[n - i - 1] = pop();
 
         auto target = pop();
-        if (bc.bc == Opcode::named_call_) {
+
+        // Calls with stack arguments (eg. of the inlined apply functions)
+        // dispatch to the observed closures. There is no record call bc
+        // right before them to deopt to, thus other callees always take the
+        // generic call.
+        CallTargetVersions versions;
+        if (bc.bc == Opcode::call_ && !inPromise() &&
+            callTargetFeedback.count(target)) {
+            auto& feedback = callTargetFeedback.at(target);
+            if (feedback.taken > 1 && feedback.numTargets > 0) {
+                Assumptions given;
+                given.add(Assumption::NoExplicitlyMissingArgs);
+                for (size_t i = 0; i < n; ++i) {
+                    if (args[i] == MissingArg::instance())
+                        given.remove(Assumption::NoExplicitlyMissingArgs);
+                    else
+                        writeArgTypeToAssumptions(given, args[i], i);
+                }
+                bool complete;
+                versions = compileCallTargets(feedback, srcCode, n, given, "",
+                                              complete);
+            }
+        }
+
+        if (!versions.empty()) {
+            auto fallback = [&]() -> Value* {
+                auto fs = insert.registerFrameState(srcCode, nextPos, stack);
+                return insert(new Call(env, target, args, fs, ast));
+            };
+            push(insertCallSwitch(srcCode, nextPos, stack, insert, target,
+                                  versions, args, ast, fallback));
+        } else if (bc.bc == Opcode::named_call_) {
             push(insert(new NamedCall(env, target, args,
-                                      bc.callExtra().callArgumentNames,
-                                      bc.immediate.callFixedArgs.ast)));
+                                      bc.callExtra().callArgumentNames, ast)));
         } else {
             Value* fs = nullptr;
             if (inPromise())
                 fs = Tombstone::framestate();
             else
                 fs = insert.registerFrameState(srcCode, nextPos, stack);
-            push(insert(new Call(env, target, args, fs,
-                                 bc.immediate.callFixedArgs.ast)));
+            push(insert(new Call(env, target, args, fs, ast)));
         }
         break;
     }
@@ -807,6 +1019,8 @@ bool Rir2Pir::compileBC(const BC& bc, Opcode* pos, Opcode* nextPos,
     case Opcode::ldvar_noforce_:
     case Opcode::ldvar_noforce_super_:
     case Opcode::ldarg_:
+    case Opcode::ldarg_dots_:
+    case Opcode::mk_dots_:
     case Opcode::ldloc_:
     case Opcode::stloc_:
     case Opcode::movloc_:
@@ -839,6 +1053,30 @@ bool Rir2Pir::tryCompile(rir::Code* srcCode, Builder& insert) {
     return false;
 }
 
+bool Rir2Pir::tryCompileContinuation(Builder& insert) {
+    auto version = insert.function;
+    assert(version->isContinuation());
+
+    // The operand stack of the interrupted baseline frame is passed as
+    // arguments, bottom first. The interpreter only does that for evaluated
+    // values.
+    RirStack stack;
+    auto& assumptions = version->assumptions();
+    for (size_t i = 0; i < version->nargs(); ++i) {
+        auto arg = insert(new LdArg(i));
+        arg->type = PirType::val().notMissing();
+        readArgTypeFromAssumptions(assumptions, arg->type, i);
+        stack.push(arg);
+    }
+
+    if (auto res = tryTranslate(srcFunction->body(), version->osrEntry, stack,
+                                insert)) {
+        finalize(res, insert);
+        return true;
+    }
+    return false;
+}
+
 bool Rir2Pir::tryCompilePromise(rir::Code* prom, Builder& insert) const {
     return PromiseRir2Pir(compiler, srcFunction, log, name)
         .tryCompile(prom, insert);
@@ -850,6 +1088,12 @@ Value* Rir2Pir::tryTranslatePromise(rir::Code* srcCode, Builder& insert) const {
 }
 
 Value* Rir2Pir::tryTranslate(rir::Code* srcCode, Builder& insert) const {
+    return tryTranslate(srcCode, srcCode->code(), RirStack(), insert);
+}
+
+Value* Rir2Pir::tryTranslate(rir::Code* srcCode, Opcode* entry,
+                             const RirStack& entryStack,
+                             Builder& insert) const {
     assert(!finalized);
 
     CallTargetFeedback callTargetFeedback;
@@ -862,9 +1106,10 @@ Value* Rir2Pir::tryTranslate(rir::Code* srcCode, Builder& insert) const {
     std::deque<State> worklist;
     State cur;
     cur.seen = true;
+    cur.stack = entryStack;
 
     Opcode* end = srcCode->endCode();
-    Opcode* finger = srcCode->code();
+    Opcode* finger = entry;
 
     auto popWorklist = [&]() {
         assert(!worklist.empty());
@@ -22,6 +22,11 @@ class Rir2Pir {
         return tryCompile(srcFunction->body(), insert);
     }
 
+    // Translates the baseline body of srcFunction, starting at the osr entry
+    // of the continuation the builder belongs to
+    bool tryCompileContinuation(Builder& insert)
+        __attribute__((warn_unused_result));
+
     Value* tryCreateArg(rir::Code* prom, Builder& insert, bool eager) const
         __attribute__((warn_unused_result));
 
@@ -38,6 +43,9 @@ class Rir2Pir {
 
     Value* tryTranslate(rir::Code* srcCode, Builder& insert) const
         __attribute__((warn_unused_result));
+    Value* tryTranslate(rir::Code* srcCode, Opcode* entry,
+                        const RirStack& entryStack, Builder& insert) const
+        __attribute__((warn_unused_result));
 
     void finalize(Value*, Builder& insert);
 
@@ -58,6 +66,25 @@ class Rir2Pir {
     Checkpoint* addCheckpoint(rir::Code* srcCode, Opcode* pos,
                               const RirStack& stack, Builder& insert) const;
 
+    typedef std::vector<std::pair<SEXP, ClosureVersion*>> CallTargetVersions;
+
+    // Compiles versions of the observed closures, which can be called with
+    // nargs positional arguments. Complete is set if all possible targets
+    // have a version.
+    CallTargetVersions compileCallTargets(const ObservedCallees& feedback,
+                                          rir::Code* srcCode, size_t nargs,
+                                          const Assumptions& given,
+                                          const std::string& name,
+                                          bool& complete) const;
+    // Compares the callee against the targets and calls the matching version.
+    // Other callees take the fallback, which returns the result or nullptr if
+    // it deopts. The callee and arguments must be popped off the stack.
+    Value* insertCallSwitch(rir::Code* srcCode, Opcode* nextPos,
+                            RirStack& stack, Builder& insert, Value* callee,
+                            const CallTargetVersions& versions,
+                            const std::vector<Value*>& args, unsigned ast,
+                            const std::function<Value*()>& fallback) const;
+
   private:
     bool inPromise_ = false;
 };
@@ -25,9 +25,15 @@ namespace pir {
 constexpr Assumptions::Flags Rir2PirCompiler::minimalAssumptions;
 constexpr Assumptions Rir2PirCompiler::defaultAssumptions;
 
-Rir2PirCompiler::Rir2PirCompiler(Module* module, StreamLogger& logger)
+Rir2PirCompiler::Rir2PirCompiler(Module* module, StreamLogger& logger,
+                                 FunctionSignature::OptimizationLevel tier)
     : RirCompiler(module), logger(logger) {
-    for (auto& optimization : pirConfigurations()->pirOptimizations()) {
+    assert(tier != FunctionSignature::OptimizationLevel::Baseline);
+    auto& optimizations =
+        tier == FunctionSignature::OptimizationLevel::Quick
+            ? pirConfigurations()->pirQuickOptimizations()
+            : pirConfigurations()->pirOptimizations();
+    for (auto& optimization : optimizations) {
         translations.push_back(optimization);
     }
 }
@@ -66,6 +72,63 @@ void Rir2PirCompiler::compileFunction(rir::Function* srcFunction,
     compileClosure(closure, context, success, fail);
 }
 
+void Rir2PirCompiler::compileContinuation(SEXP closure, const std::string& name,
+                                          Opcode* entry, size_t stackSize,
+                                          const Assumptions& assumptions,
+                                          MaybeCls success, Maybe fail) {
+    assert(isValidClosureSEXP(closure));
+
+    auto fun = DispatchTable::unpack(BODY(closure))->baseline();
+    assert(entry >= fun->body()->code() && entry < fun->body()->endCode());
+
+    if (!assumptions.includes(minimalAssumptions)) {
+        logger.warn("Missing minimal assumptions for continuation");
+        return fail();
+    }
+
+    if (fun->body()->codeSize > Parameter::MAX_INPUT_SIZE) {
+        logger.warn("skipping huge function");
+        return fail();
+    }
+
+    // The continuation is a separate closure (not bound to the environment of
+    // the original one), its formals are the values on the operand stack
+    Protect protect;
+    SEXP formals = protect(Rf_allocList(stackSize));
+    for (SEXP f = formals; f != R_NilValue; f = CDR(f))
+        SETCAR(f, R_MissingArg);
+    static SEXP srcRefSymbol = Rf_install("srcref");
+    auto continuation = module->getOrDeclareRirFunction(
+        name + "@osr", fun, formals, Rf_getAttrib(closure, srcRefSymbol));
+
+    OptimizationContext ctx(assumptions);
+    auto version = continuation->declareVersion(ctx);
+    version->osrEntry = entry;
+
+    Builder builder(version);
+    auto& log = logger.begin(version);
+    Rir2Pir rir2pir(*this, fun, log, continuation->name());
+
+    if (rir2pir.tryCompileContinuation(builder)) {
+        log.compilationEarlyPir(version);
+#ifdef FULLVERIFIER
+        Verify::apply(version, true);
+#else
+#ifndef NDEBUG
+        Verify::apply(version);
+#endif
+#endif
+        log.flush();
+        return success(version);
+    }
+
+    log.failed("rir2pir aborted");
+    log.flush();
+    logger.close(version);
+    continuation->erase(ctx);
+    return fail();
+}
+
 void Rir2PirCompiler::compileClosure(Closure* closure,
                                      const OptimizationContext& ctx,
                                      MaybeCls success, Maybe fail_) {
@@ -100,11 +163,6 @@ void Rir2PirCompiler::compileClosure(Closure* closure,
         fail_();
     };
 
-    if (closure->formals().hasDots()) {
-        logger.warn("no support for ...");
-        return fail();
-    }
-
     if (closure->rirFunction()->body()->codeSize > Parameter::MAX_INPUT_SIZE) {
         logger.warn("skipping huge function");
         return fail();
@@ -121,8 +179,11 @@ void Rir2PirCompiler::compileClosure(Closure* closure,
 
     Protect protect;
     auto& assumptions = version->assumptions();
-    for (unsigned i = closure->nargs() - assumptions.numMissing();
-         i < closure->nargs(); ++i) {
+    for (unsigned i = 0; i < closure->nargs(); ++i) {
+        // Formals after ... are never passed positionally
+        if (i < closure->nargs() - assumptions.numMissing() &&
+            closure->formals().isPositional(i))
+            continue;
         if (closure->formals().hasDefaultArgs()) {
             auto arg = closure->formals().defaultArgs()[i];
             if (arg != R_MissingArg) {
@@ -191,6 +252,8 @@ void Rir2PirCompiler::optimizeModule() {
     for (auto& translation : translations) {
         module->eachPirClosure([&](Closure* c) {
             c->eachVersion([&](ClosureVersion* v) {
+                if (v->optimized)
+                    return;
                 auto& log = logger.get(v);
                 log.pirOptimizationsHeader(v, translation, passnr++);
 
@@ -222,6 +285,8 @@ void Rir2PirCompiler::optimizeModule() {
 
     module->eachPirClosure([&](Closure* c) {
         c->eachVersion([&](ClosureVersion* v) {
+            if (v->optimized)
+                return;
             logger.get(v).pirOptimizationsFinished(v);
 #ifdef ENABLE_SLOWASSERT
             Verify::apply(v, true);
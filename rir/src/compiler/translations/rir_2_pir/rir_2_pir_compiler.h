@@ -19,7 +19,10 @@ class Rir2PirCompiler : public RirCompiler {
                         Assumption::NotTooManyArguments,
                     0);
 
-    Rir2PirCompiler(Module* module, StreamLogger& logger);
+    // The tier selects the pass list, see Configurations
+    Rir2PirCompiler(Module* module, StreamLogger& logger,
+                    FunctionSignature::OptimizationLevel tier =
+                        FunctionSignature::OptimizationLevel::Optimized);
 
     void compileClosure(SEXP cls, const std::string& name, MaybeCls success,
                         Maybe fail) {
@@ -36,6 +39,12 @@ class Rir2PirCompiler : public RirCompiler {
     void compileFunction(rir::Function*, const std::string& name, SEXP formals,
                          SEXP srcRef, const Assumptions& ctx, MaybeCls success,
                          Maybe fail);
+    // Compiles the rest of the baseline body of a closure, starting at a loop
+    // header with stackSize values on the operand stack (see OSR)
+    void compileContinuation(SEXP closure, const std::string& name,
+                             Opcode* entry, size_t stackSize,
+                             const Assumptions& ctx, MaybeCls success,
+                             Maybe fail);
     void optimizeModule();
 
   private:
@@ -89,11 +89,18 @@ Builder::Builder(ClosureVersion* version, Value* closureEnv)
     auto closure = version->owner();
 
     auto& assumptions = version->assumptions();
+    auto& formals = closure->formals();
     std::vector<Value*> args(closure->nargs());
     size_t nargs = closure->nargs() - assumptions.numMissing();
     for (long i = nargs - 1; i >= 0; --i) {
-        args[i] = this->operator()(new LdArg(i));
-        readArgTypeFromAssumptions(assumptions, args[i]->type, i);
+        if (!formals.isPositional(i)) {
+            args[i] = MissingArg::instance();
+        } else if ((size_t)i == formals.dotsPosition()) {
+            args[i] = this->operator()(new LdArgDots(i));
+        } else {
+            args[i] = this->operator()(new LdArg(i));
+            readArgTypeFromAssumptions(assumptions, args[i]->type, i);
+        }
     }
     for (size_t i = nargs; i < closure->nargs(); ++i)
         args[i] = MissingArg::instance();
@@ -112,5 +119,18 @@ Builder::Builder(ClosureVersion* fun, Promise* prom)
     add(ldenv);
     this->env = ldenv;
 }
+
+Builder::Builder(ClosureVersion* continuation)
+    : function(continuation), code(continuation), env(nullptr) {
+    assert(continuation->isContinuation());
+    createNextBB();
+    assert(!function->entry);
+    function->entry = bb;
+    // The continuation runs in the environment of the baseline frame it
+    // replaces, thus (like a promise) it does not create its own.
+    auto ldenv = new LdFunctionEnv();
+    add(ldenv);
+    this->env = ldenv;
+}
 } // namespace pir
 } // namespace rir
@@ -27,6 +27,7 @@ class Builder {
 
     Builder(ClosureVersion* fun, Promise* prom);
     Builder(ClosureVersion* fun, Value* enclos);
+    explicit Builder(ClosureVersion* continuation);
 
     Value* buildDefaultEnv(ClosureVersion* fun);
 
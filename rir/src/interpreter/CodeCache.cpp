@@ -0,0 +1,1107 @@
+#include "CodeCache.h"
+#include "R/Protect.h"
+#include "instance.h"
+#include "ir/BC.h"
+#include "ir/CodeVerifier.h"
+#include "ir/Compiler.h"
+#include "runtime/DispatchTable.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace rir {
+
+std::unordered_map<SEXP, SEXP> CodeCache::remembered;
+std::unordered_map<uint64_t, SEXP> CodeCache::entries;
+SEXP CodeCache::imported = nullptr;
+
+// Layout of the lists produced by the serializer
+enum CodeEntry {
+    CodeHeader,    // stackLength, localsCount, codeSize, srcLength, extraPool
+    CodeBytecode,  // RAWSXP with pool indices replaced by constant numbers
+    CodeConstants, // values referred to from the bytecode
+    CodeSources,   // asts, the first one is the ast of the code object
+    CodeSrclist,   // pairs of pcOffset and number of the source (or -1)
+    CodeExtraPool, // serialized promises, closure numbers of static call
+                   // targets, R_NilValue for everything else
+    CodeClosures,  // pairs of constant and closure number, for constants
+                   // which are closures
+    CodeEntries
+};
+
+enum FunctionEntry {
+    FunctionHeader,      // envCreation, optimization, unoptimizable,
+                         // uninlinable, hasDotsFormals
+    FunctionAssumptions, // RAWSXP with the Assumptions
+    FunctionArguments,   // triples of isEvaluated, type and length
+    FunctionBody,
+    FunctionDefaultArgs,
+    FunctionEntries
+};
+
+enum CacheEntry {
+    CacheFormals,
+    CacheBody,
+    CacheEnvironment,
+    CacheBaseline,
+    CacheVersions,
+    CacheEntries
+};
+
+// Identity of a closure referred to by persisted code
+enum ClosureEntry {
+    ClosureSymbol, // the closure is bound to it in its environment
+    ClosureEnvironment,
+    ClosureFormals,
+    ClosureBody,
+    ClosureEntries
+};
+
+static void hashBytes(uint64_t& h, const void* data, size_t length) {
+    // FNV-1a, the hash has to be stable across sessions
+    auto bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < length; ++i) {
+        h ^= bytes[i];
+        h *= 1099511628211ULL;
+    }
+}
+
+static void hashAst(uint64_t& h, SEXP s) {
+    int type = TYPEOF(s);
+    hashBytes(h, &type, sizeof(type));
+    switch (type) {
+    case SYMSXP:
+        if (s != R_MissingArg && s != R_UnboundValue)
+            hashAst(h, PRINTNAME(s));
+        break;
+    case CHARSXP:
+        hashBytes(h, CHAR(s), LENGTH(s));
+        break;
+    case LGLSXP:
+    case INTSXP:
+        hashBytes(h, INTEGER(s), XLENGTH(s) * sizeof(int));
+        break;
+    case REALSXP:
+        hashBytes(h, REAL(s), XLENGTH(s) * sizeof(double));
+        break;
+    case CPLXSXP:
+        hashBytes(h, COMPLEX(s), XLENGTH(s) * sizeof(Rcomplex));
+        break;
+    case RAWSXP:
+        hashBytes(h, RAW(s), XLENGTH(s));
+        break;
+    case STRSXP:
+        for (R_xlen_t i = 0; i < XLENGTH(s); ++i)
+            hashAst(h, STRING_ELT(s, i));
+        break;
+    case VECSXP:
+    case EXPRSXP:
+        for (R_xlen_t i = 0; i < XLENGTH(s); ++i)
+            hashAst(h, VECTOR_ELT(s, i));
+        break;
+    case LISTSXP:
+    case LANGSXP:
+        for (; s != R_NilValue; s = CDR(s)) {
+            hashAst(h, TAG(s));
+            hashAst(h, CAR(s));
+        }
+        break;
+    default: {}
+    }
+}
+
+static uint64_t hashAst(SEXP s) {
+    uint64_t h = 14695981039346656037ULL;
+    hashAst(h, s);
+    return h;
+}
+
+// Structural equality, ignoring attributes (in particular srcrefs, which
+// point to a different srcfile environment in every session)
+static bool equalAst(SEXP a, SEXP b) {
+    if (a == b)
+        return true;
+    if (TYPEOF(a) != TYPEOF(b))
+        return false;
+    switch (TYPEOF(a)) {
+    case CHARSXP:
+        return LENGTH(a) == LENGTH(b) &&
+               memcmp(CHAR(a), CHAR(b), LENGTH(a)) == 0;
+    case LGLSXP:
+    case INTSXP:
+        return XLENGTH(a) == XLENGTH(b) &&
+               memcmp(INTEGER(a), INTEGER(b), XLENGTH(a) * sizeof(int)) == 0;
+    case REALSXP:
+        return XLENGTH(a) == XLENGTH(b) &&
+               memcmp(REAL(a), REAL(b), XLENGTH(a) * sizeof(double)) == 0;
+    case CPLXSXP:
+        return XLENGTH(a) == XLENGTH(b) &&
+               memcmp(COMPLEX(a), COMPLEX(b),
+                      XLENGTH(a) * sizeof(Rcomplex)) == 0;
+    case RAWSXP:
+        return XLENGTH(a) == XLENGTH(b) &&
+               memcmp(RAW(a), RAW(b), XLENGTH(a)) == 0;
+    case STRSXP:
+        if (XLENGTH(a) != XLENGTH(b))
+            return false;
+        for (R_xlen_t i = 0; i < XLENGTH(a); ++i)
+            if (!equalAst(STRING_ELT(a, i), STRING_ELT(b, i)))
+                return false;
+        return true;
+    case VECSXP:
+    case EXPRSXP:
+        if (XLENGTH(a) != XLENGTH(b))
+            return false;
+        for (R_xlen_t i = 0; i < XLENGTH(a); ++i)
+            if (!equalAst(VECTOR_ELT(a, i), VECTOR_ELT(b, i)))
+                return false;
+        return true;
+    case LISTSXP:
+    case LANGSXP:
+        return equalAst(TAG(a), TAG(b)) && equalAst(CAR(a), CAR(b)) &&
+               equalAst(CDR(a), CDR(b));
+    default:
+        // Symbols, environments and builtins are unique
+        return false;
+    }
+}
+
+// Environments which R's serialization restores by reference
+static bool isPersistableEnv(SEXP env) {
+    return env == R_GlobalEnv || env == R_BaseEnv || env == R_BaseNamespace ||
+           R_IsNamespaceEnv(env) || R_IsPackageEnv(env);
+}
+
+static bool isPersistable(SEXP s) {
+    switch (TYPEOF(s)) {
+    case ENVSXP:
+        return isPersistableEnv(s);
+    case CLOSXP:
+    case PROMSXP:
+    case EXTERNALSXP:
+    case BCODESXP:
+    case EXTPTRSXP:
+    case WEAKREFSXP:
+        return false;
+    case VECSXP:
+    case EXPRSXP:
+        for (R_xlen_t i = 0; i < XLENGTH(s); ++i)
+            if (!isPersistable(VECTOR_ELT(s, i)))
+                return false;
+        return true;
+    case LISTSXP:
+    case LANGSXP:
+        for (; s != R_NilValue; s = CDR(s))
+            if (!isPersistable(CAR(s)))
+                return false;
+        return true;
+    default:
+        return true;
+    }
+}
+
+// The value bound to sym in the frame of env, without running active bindings
+// or forcing promises
+static SEXP bindingValue(SEXP env, SEXP sym) {
+    R_varloc_t loc = R_findVarLocInFrame(env, sym);
+    if (R_VARLOC_IS_NULL(loc) || R_BindingIsActive(sym, env))
+        return R_UnboundValue;
+    SEXP value =
+        TYPEOF(loc.cell) == SYMSXP ? SYMVALUE(loc.cell) : CAR(loc.cell);
+    if (TYPEOF(value) == PROMSXP)
+        value = PRVALUE(value);
+    return value;
+}
+
+// The original (non rir) body of a closure
+static SEXP closureAst(SEXP closure) {
+    SEXP body = BODY(closure);
+    if (auto table = DispatchTable::check(body))
+        return src_pool_at(globalContext(), table->baseline()->body()->src);
+    if (TYPEOF(body) == BCODESXP)
+        return VECTOR_ELT(CDR(body), 0);
+    return body;
+}
+
+// Numbers a closure referred to by persisted code. Returns -1 if it cannot be
+// found again in a new session, since it is not bound in its environment.
+static int closureNumber(SEXP closure,
+                         std::vector<std::pair<SEXP, SEXP>>& closures) {
+    for (size_t i = 0; i < closures.size(); ++i)
+        if (closures[i].first == closure)
+            return i;
+    SEXP env = CLOENV(closure);
+    if (!isPersistableEnv(env) || !DispatchTable::check(BODY(closure)))
+        return -1;
+
+    Protect p;
+    SEXP names = p(R_lsInternal(env, TRUE));
+    for (R_xlen_t i = 0; i < XLENGTH(names); ++i) {
+        SEXP sym = Rf_install(CHAR(STRING_ELT(names, i)));
+        if (bindingValue(env, sym) == closure) {
+            closures.emplace_back(closure, sym);
+            return closures.size() - 1;
+        }
+    }
+    return -1;
+}
+
+// The reason (kind, origin code and offset) followed by a triple per frame
+static constexpr size_t DEOPT_HEADER = 3;
+
+static SEXP serializeDeopt(SEXP store,
+                           const std::unordered_map<Code*, unsigned>& codes) {
+    auto m = (DeoptMetadata*)DATAPTR(store);
+    SEXP res = Rf_allocVector(INTSXP, DEOPT_HEADER + 3 * m->numFrames);
+    int* out = INTEGER(res);
+    out[0] = m->reason.reason;
+    out[1] = -1;
+    out[2] = 0;
+    // Feedback of inlined callees is dropped, only the reason is kept
+    auto origin = codes.find(m->reason.origin.srcCode);
+    if (m->reason.origin.pc && origin != codes.end()) {
+        out[1] = origin->second;
+        out[2] = m->reason.origin.pc - m->reason.origin.srcCode->code();
+    }
+    out += DEOPT_HEADER;
+    for (size_t i = 0; i < m->numFrames; ++i) {
+        auto& frame = m->frames[i];
+        auto code = codes.find(frame.code);
+        // Deopt into inlined callees is not supported
+        if (code == codes.end())
+            return nullptr;
+        out[3 * i] = code->second;
+        out[3 * i + 1] = frame.pc - frame.code->code();
+        out[3 * i + 2] = frame.stackSize;
+    }
+    return res;
+}
+
+static SEXP deserializeDeopt(SEXP store, const std::vector<Code*>& codes) {
+    if (TYPEOF(store) != INTSXP || (size_t)XLENGTH(store) < DEOPT_HEADER + 3 ||
+        (XLENGTH(store) - DEOPT_HEADER) % 3 != 0)
+        return nullptr;
+    size_t nframes = (XLENGTH(store) - DEOPT_HEADER) / 3;
+    int* in = INTEGER(store);
+    if ((unsigned)in[0] >= DeoptReason::NumReasons)
+        return nullptr;
+    auto validPc = [&](int code, int pc) {
+        return code >= 0 && (size_t)code < codes.size() && pc >= 0 &&
+               (unsigned)pc < codes[code]->codeSize;
+    };
+    if (in[1] >= 0 && !validPc(in[1], in[2]))
+        return nullptr;
+    for (size_t i = 0; i < nframes; ++i) {
+        int* frame = in + DEOPT_HEADER + 3 * i;
+        if (!validPc(frame[0], frame[1]) || frame[2] < 0)
+            return nullptr;
+    }
+
+    SEXP res = Rf_allocVector(RAWSXP, sizeof(DeoptMetadata) +
+                                          nframes * sizeof(FrameInfo));
+    auto m = new (DATAPTR(res)) DeoptMetadata;
+    m->reason = DeoptReason::unknown();
+    m->reason.reason = (DeoptReason::Reason)in[0];
+    if (in[1] >= 0) {
+        auto code = codes[in[1]];
+        m->reason.origin = {code, code->code() + in[2]};
+    }
+    in += DEOPT_HEADER;
+    m->numFrames = nframes;
+    for (size_t i = 0; i < nframes; ++i) {
+        auto code = codes[in[3 * i]];
+        m->frames[i] = {code->code() + in[3 * i + 1], code,
+                        (size_t)in[3 * i + 2]};
+    }
+    return res;
+}
+
+// All code objects of a function (body, default args and their promises) in a
+// deterministic order
+static void allCode(Code* c, std::vector<Code*>& res) {
+    res.push_back(c);
+    for (unsigned i = 0; i < c->extraPoolSize; ++i)
+        if (auto p = Code::check(c->getExtraPoolEntry(i)))
+            allCode(p, res);
+}
+
+static std::vector<Code*> allCode(Function* f) {
+    std::vector<Code*> res;
+    allCode(f->body(), res);
+    for (size_t i = 0; i < f->numArgs; ++i)
+        if (auto c = f->defaultArg(i))
+            allCode(c, res);
+    return res;
+}
+
+// The cache is read from a file, thus it might be corrupt or not written by
+// us at all. Everything is checked before it is used to build code objects.
+
+// Checks the types and lengths of the entries of a serialized code object
+static bool isCodeStore(SEXP store) {
+    if (TYPEOF(store) != VECSXP || XLENGTH(store) != CodeEntries)
+        return false;
+    SEXP header = VECTOR_ELT(store, CodeHeader);
+    if (TYPEOF(header) != INTSXP || XLENGTH(header) != 5)
+        return false;
+    for (int i = 0; i < 5; ++i)
+        if (INTEGER(header)[i] < 0)
+            return false;
+    R_xlen_t codeSize = INTEGER(header)[2];
+    R_xlen_t srcLength = INTEGER(header)[3];
+    SEXP bc = VECTOR_ELT(store, CodeBytecode);
+    SEXP constants = VECTOR_ELT(store, CodeConstants);
+    SEXP sources = VECTOR_ELT(store, CodeSources);
+    SEXP srclist = VECTOR_ELT(store, CodeSrclist);
+    SEXP extraPool = VECTOR_ELT(store, CodeExtraPool);
+    SEXP closures = VECTOR_ELT(store, CodeClosures);
+    if (TYPEOF(bc) != RAWSXP || codeSize == 0 || XLENGTH(bc) != codeSize ||
+        TYPEOF(constants) != VECSXP || TYPEOF(sources) != VECSXP ||
+        XLENGTH(sources) == 0 || TYPEOF(srclist) != INTSXP ||
+        XLENGTH(srclist) != 2 * srcLength || TYPEOF(extraPool) != VECSXP ||
+        XLENGTH(extraPool) != INTEGER(header)[4] ||
+        TYPEOF(closures) != INTSXP || XLENGTH(closures) % 2 != 0)
+        return false;
+
+    for (R_xlen_t i = 0; i < srcLength; ++i) {
+        int pcOffset = INTEGER(srclist)[2 * i];
+        int local = INTEGER(srclist)[2 * i + 1];
+        if (pcOffset < 0 || pcOffset >= codeSize || local < -1 ||
+            local >= XLENGTH(sources))
+            return false;
+    }
+    for (R_xlen_t i = 0; i < XLENGTH(extraPool); ++i) {
+        SEXP entry = VECTOR_ELT(extraPool, i);
+        if (entry != R_NilValue && TYPEOF(entry) != VECSXP &&
+            (TYPEOF(entry) != INTSXP || XLENGTH(entry) != 1))
+            return false;
+    }
+    for (R_xlen_t i = 0; i < XLENGTH(closures); i += 2) {
+        int constant = INTEGER(closures)[i];
+        if (constant < 0 || constant >= XLENGTH(constants))
+            return false;
+    }
+    return true;
+}
+
+static size_t fixedSize(Opcode bc) {
+    switch (bc) {
+#define DEF_INSTR(name, imm, opop, opush, pure)                                \
+    case Opcode::name:                                                         \
+        return 1 + imm * sizeof(Immediate);
+#include "ir/insns.h"
+    default:
+        return 0;
+    }
+}
+
+// Checks that the serialized bytecode decodes into whole instructions, that
+// branches target instructions and that all indices are within the constants
+// list, the locals and the extra pool of the code object.
+static bool isValidBytecode(SEXP store) {
+    SEXP bc = VECTOR_ELT(store, CodeBytecode);
+    SEXP constants = VECTOR_ELT(store, CodeConstants);
+    size_t nconstants = XLENGTH(constants);
+    size_t nlocals = INTEGER(VECTOR_ELT(store, CodeHeader))[1];
+    SEXP extraPool = VECTOR_ELT(store, CodeExtraPool);
+    auto extraPoolEntry = [&](Immediate idx) {
+        if (idx >= (size_t)XLENGTH(extraPool))
+            return -1;
+        return TYPEOF(VECTOR_ELT(extraPool, idx));
+    };
+    auto isPromise = [&](Immediate idx) {
+        return extraPoolEntry(idx) == VECSXP;
+    };
+
+    auto start = (Opcode*)RAW(bc);
+    auto end = start + XLENGTH(bc);
+    std::vector<bool> instructions(XLENGTH(bc), false);
+    std::vector<ptrdiff_t> targets;
+    std::vector<size_t> offsets;
+    for (Opcode* pc = start; pc < end; pc = BC::next(pc)) {
+        if (*pc == Opcode::invalid_ || *pc >= Opcode::num_of ||
+            fixedSize(*pc) > (size_t)(end - pc))
+            return false;
+        auto imm = [&](size_t i) {
+            Immediate res;
+            memcpy(&res, (uint8_t*)pc + 1 + i * sizeof(Immediate),
+                   sizeof(Immediate));
+            return res;
+        };
+        switch (*pc) {
+        case Opcode::call_implicit_:
+        case Opcode::named_call_:
+        case Opcode::named_call_implicit_:
+        case Opcode::mk_env_:
+        case Opcode::mk_stub_env_:
+            // Bounds the size of the variable length part
+            if (imm(0) > (size_t)(end - pc) / sizeof(Immediate))
+                return false;
+            break;
+        default: {}
+        }
+        if (BC::size(pc) > (size_t)(end - pc))
+            return false;
+        instructions[pc - start] = true;
+
+        offsets.clear();
+        BC::poolImmediates(pc, offsets);
+        for (auto o : offsets) {
+            Immediate idx;
+            memcpy(&idx, (uint8_t*)pc + o, sizeof(Immediate));
+            if (idx >= nconstants)
+                return false;
+        }
+
+        // The interpreter relies on the type of those constants
+        auto constant = [&](size_t i) { return VECTOR_ELT(constants, imm(i)); };
+        switch (*pc) {
+        case Opcode::ldfun_:
+        case Opcode::ldvar_:
+        case Opcode::ldvar_for_update_:
+        case Opcode::ldvar_noforce_:
+        case Opcode::ldvar_super_:
+        case Opcode::ldvar_noforce_super_:
+        case Opcode::ldddvar_:
+        case Opcode::starg_:
+        case Opcode::stvar_:
+        case Opcode::stvar_super_:
+        case Opcode::missing_:
+            if (TYPEOF(constant(0)) != SYMSXP)
+                return false;
+            break;
+        case Opcode::call_builtin_:
+            if (TYPEOF(constant(2)) != BUILTINSXP &&
+                TYPEOF(constant(2)) != SPECIALSXP)
+                return false;
+            break;
+        case Opcode::ldloc_:
+        case Opcode::stloc_:
+            if (imm(0) >= nlocals)
+                return false;
+            break;
+        case Opcode::movloc_:
+            if (imm(0) >= nlocals || imm(1) >= nlocals)
+                return false;
+            break;
+        case Opcode::promise_:
+        case Opcode::push_code_:
+            if (!isPromise(imm(0)))
+                return false;
+            break;
+        case Opcode::call_implicit_:
+        case Opcode::named_call_implicit_:
+            for (size_t i = 0; i < imm(0); ++i) {
+                auto arg = imm(5 + i);
+                if (arg != MISSING_ARG_IDX && arg != DOTS_ARG_IDX &&
+                    !isPromise(arg))
+                    return false;
+            }
+        // fall through
+        case Opcode::call_:
+        case Opcode::named_call_:
+            if (imm(4) != NO_CALL_SITE_CACHE)
+                return false;
+            break;
+        case Opcode::static_call_:
+            // The callee and an empty inline cache
+            if (extraPoolEntry(imm(4)) != INTSXP ||
+                extraPoolEntry(imm(5)) != NILSXP)
+                return false;
+            break;
+        case Opcode::record_call_: {
+            ObservedCallees feedback;
+            memcpy(&feedback, pc + 1, sizeof(ObservedCallees));
+            if (feedback.numTargets != 0)
+                return false;
+            break;
+        }
+        case Opcode::record_type_: {
+            ObservedValues feedback;
+            memcpy(&feedback, pc + 1, sizeof(ObservedValues));
+            if (feedback.stableValue || feedback.stableClass)
+                return false;
+            break;
+        }
+        case Opcode::br_:
+        case Opcode::brtrue_:
+        case Opcode::brfalse_:
+        case Opcode::brobj_:
+        case Opcode::beginloop_: {
+            BC::Jmp offset;
+            memcpy(&offset, pc + 1, sizeof(BC::Jmp));
+            targets.push_back((pc - start) + BC::size(pc) + offset);
+            break;
+        }
+        default: {}
+        }
+    }
+
+    for (auto t : targets)
+        if (t < 0 || t >= XLENGTH(bc) || !instructions[t])
+            return false;
+    return true;
+}
+
+SEXP CodeCache::serialize(Code* code, const CodeNumbering& baseline,
+                          ClosureNumbering& closures) {
+    auto ctx = globalContext();
+    Protect p;
+    SEXP res = p(Rf_allocVector(VECSXP, CodeEntries));
+
+    SEXP header = Rf_allocVector(INTSXP, 5);
+    SET_VECTOR_ELT(res, CodeHeader, header);
+    INTEGER(header)[0] = code->stackLength;
+    INTEGER(header)[1] = code->localsCount;
+    INTEGER(header)[2] = code->codeSize;
+    INTEGER(header)[3] = code->srcLength;
+    INTEGER(header)[4] = code->extraPoolSize;
+
+    SEXP bc = Rf_allocVector(RAWSXP, code->codeSize);
+    SET_VECTOR_ELT(res, CodeBytecode, bc);
+    memcpy(RAW(bc), code->code(), code->codeSize);
+
+    // Rewrite pool indices to indices into the constants list
+    std::vector<size_t> offsets;
+    Opcode* end = (Opcode*)RAW(bc) + code->codeSize;
+    for (Opcode* pc = (Opcode*)RAW(bc); pc < end; pc = BC::next(pc))
+        BC::poolImmediates(pc, offsets);
+    SEXP constants = p(Rf_allocVector(VECSXP, offsets.size()));
+    std::unordered_map<SEXP, Immediate> constantIdx;
+    std::vector<int> closureConstants;
+    // Extra pool entries which are static call targets, to their closure
+    // number
+    std::unordered_map<unsigned, int> callees;
+
+    for (Opcode* pc = (Opcode*)RAW(bc); pc < end; pc = BC::next(pc)) {
+        // The callee of static calls is stored by identity and the inline
+        // cache is reset, it is filled again on the next call
+        if (*pc == Opcode::static_call_) {
+            Immediate callee;
+            memcpy(&callee, (uint8_t*)pc + 1 + 4 * sizeof(Immediate),
+                   sizeof(Immediate));
+            int number =
+                closureNumber(code->getExtraPoolEntry(callee), closures);
+            if (number < 0)
+                return nullptr;
+            callees[callee] = number;
+        }
+        // Call targets are not persisted, drop the feedback
+        if (*pc == Opcode::record_call_) {
+            ObservedCallees feedback;
+            memcpy(&feedback, pc + 1, sizeof(ObservedCallees));
+            feedback.numTargets = 0;
+            memcpy(pc + 1, &feedback, sizeof(ObservedCallees));
+        }
+        // Neither are observed constants and classes
+        if (*pc == Opcode::record_type_) {
+            ObservedValues feedback;
+            memcpy(&feedback, pc + 1, sizeof(ObservedValues));
+            feedback.stableValue = feedback.stableClass = false;
+            memcpy(pc + 1, &feedback, sizeof(ObservedValues));
+        }
+        // Call site caches are not persisted either, the slot is reallocated
+        // on the next call
+        switch (*pc) {
+        case Opcode::call_:
+        case Opcode::call_implicit_:
+        case Opcode::named_call_:
+        case Opcode::named_call_implicit_: {
+            Immediate none = NO_CALL_SITE_CACHE;
+            memcpy((uint8_t*)pc + 1 + 4 * sizeof(Immediate), &none,
+                   sizeof(Immediate));
+            break;
+        }
+        default: {}
+        }
+
+        offsets.clear();
+        BC::poolImmediates(pc, offsets);
+        for (auto o : offsets) {
+            Immediate idx;
+            memcpy(&idx, (uint8_t*)pc + o, sizeof(Immediate));
+            SEXP value = cp_pool_at(ctx, idx);
+            if (!constantIdx.count(value)) {
+                Immediate local = constantIdx.size();
+                SEXP persisted;
+                if (*pc == Opcode::deopt_) {
+                    persisted = serializeDeopt(value, baseline);
+                } else if (TYPEOF(value) == CLOSXP) {
+                    // Eg. the expected callee of a call target guard
+                    int number = closureNumber(value, closures);
+                    if (number < 0)
+                        return nullptr;
+                    closureConstants.push_back(local);
+                    closureConstants.push_back(number);
+                    persisted = R_NilValue;
+                } else {
+                    persisted = isPersistable(value) ? value : nullptr;
+                }
+                if (!persisted)
+                    return nullptr;
+                SET_VECTOR_ELT(constants, local, persisted);
+                constantIdx[value] = local;
+            }
+            memcpy((uint8_t*)pc + o, &constantIdx.at(value), sizeof(Immediate));
+        }
+    }
+    SET_VECTOR_ELT(res, CodeConstants,
+                   Rf_xlengthgets(constants, constantIdx.size()));
+    SEXP closureList = Rf_allocVector(INTSXP, closureConstants.size());
+    SET_VECTOR_ELT(res, CodeClosures, closureList);
+    std::copy(closureConstants.begin(), closureConstants.end(),
+              INTEGER(closureList));
+
+    SEXP sources = p(Rf_allocVector(VECSXP, code->srcLength + 1));
+    SEXP srclist = Rf_allocVector(INTSXP, 2 * code->srcLength);
+    SET_VECTOR_ELT(res, CodeSrclist, srclist);
+    SET_VECTOR_ELT(sources, 0, src_pool_at(ctx, code->src));
+    std::unordered_map<unsigned, int> sourceIdx;
+    for (unsigned i = 0; i < code->srcLength; ++i) {
+        auto& entry = code->srclist()[i];
+        INTEGER(srclist)[2 * i] = entry.pcOffset;
+        if (entry.srcIdx == 0) {
+            INTEGER(srclist)[2 * i + 1] = -1;
+            continue;
+        }
+        if (!sourceIdx.count(entry.srcIdx)) {
+            int local = sourceIdx.size() + 1;
+            SET_VECTOR_ELT(sources, local, src_pool_at(ctx, entry.srcIdx));
+            sourceIdx[entry.srcIdx] = local;
+        }
+        INTEGER(srclist)[2 * i + 1] = sourceIdx.at(entry.srcIdx);
+    }
+    sources = Rf_xlengthgets(sources, sourceIdx.size() + 1);
+    SET_VECTOR_ELT(res, CodeSources, sources);
+    if (!isPersistable(sources))
+        return nullptr;
+
+    // Promises keep their position, the bytecode refers to them by index
+    SEXP extraPool = Rf_allocVector(VECSXP, code->extraPoolSize);
+    SET_VECTOR_ELT(res, CodeExtraPool, extraPool);
+    for (unsigned i = 0; i < code->extraPoolSize; ++i) {
+        auto callee = callees.find(i);
+        if (callee != callees.end()) {
+            SET_VECTOR_ELT(extraPool, i, Rf_ScalarInteger(callee->second));
+        } else if (auto promise = Code::check(code->getExtraPoolEntry(i))) {
+            SEXP s = serialize(promise, baseline, closures);
+            if (!s)
+                return nullptr;
+            SET_VECTOR_ELT(extraPool, i, s);
+        }
+    }
+
+    return res;
+}
+
+Code* CodeCache::deserialize(SEXP store, const std::vector<Code*>& baseline) {
+    if (!isCodeStore(store) || !isValidBytecode(store))
+        return nullptr;
+    Protect p;
+
+    int* header = INTEGER(VECTOR_ELT(store, CodeHeader));
+    unsigned codeSize = header[2];
+    unsigned srcLength = header[3];
+    unsigned extraPoolSize = header[4];
+    SEXP constants = VECTOR_ELT(store, CodeConstants);
+    SEXP sources = VECTOR_ELT(store, CodeSources);
+    SEXP srclist = VECTOR_ELT(store, CodeSrclist);
+    SEXP extraPool = VECTOR_ELT(store, CodeExtraPool);
+
+    SEXP container =
+        p(Rf_allocVector(EXTERNALSXP, Code::size(codeSize, srcLength)));
+    unsigned src = Pool::insertSrc(VECTOR_ELT(sources, 0));
+    Code* code = new (DATAPTR(container))
+        Code(nullptr, src, codeSize, srcLength, header[1]);
+    code->stackLength = header[0];
+    memcpy(code->code(), RAW(VECTOR_ELT(store, CodeBytecode)), codeSize);
+
+    std::vector<unsigned> sourceIdx(XLENGTH(sources), 0);
+    for (unsigned i = 0; i < srcLength; ++i) {
+        int local = INTEGER(srclist)[2 * i + 1];
+        unsigned idx = 0;
+        if (local >= 0) {
+            if (!sourceIdx[local])
+                sourceIdx[local] = Pool::insertSrc(VECTOR_ELT(sources, local));
+            idx = sourceIdx[local];
+        }
+        code->srclist()[i] = {(unsigned)INTEGER(srclist)[2 * i], idx};
+    }
+
+    std::unordered_map<Immediate, int> closures;
+    SEXP closureList = VECTOR_ELT(store, CodeClosures);
+    for (R_xlen_t i = 0; i < XLENGTH(closureList); i += 2)
+        closures[INTEGER(closureList)[i]] = INTEGER(closureList)[i + 1];
+
+    // Pool::insert never hands out index 0, thus it marks missing entries
+    std::vector<BC::PoolIdx> poolIdx(XLENGTH(constants), 0);
+    std::vector<size_t> offsets;
+    for (Opcode* pc = code->code(); pc < code->endCode(); pc = BC::next(pc)) {
+        offsets.clear();
+        BC::poolImmediates(pc, offsets);
+        for (auto o : offsets) {
+            Immediate local;
+            memcpy(&local, (uint8_t*)pc + o, sizeof(Immediate));
+            if (!poolIdx[local]) {
+                SEXP value = VECTOR_ELT(constants, local);
+                if (*pc == Opcode::deopt_)
+                    value = deserializeDeopt(value, baseline);
+                else if (closures.count(local))
+                    value = importedClosure(closures.at(local));
+                if (!value)
+                    return nullptr;
+                poolIdx[local] = Pool::insert(value);
+            }
+            memcpy((uint8_t*)pc + o, &poolIdx[local], sizeof(Immediate));
+        }
+    }
+    code->computeBindingCacheSize();
+
+    for (unsigned i = 0; i < extraPoolSize; ++i) {
+        SEXP entry = VECTOR_ELT(extraPool, i);
+        if (entry == R_NilValue) {
+            code->addExtraPoolEntry(R_NilValue);
+            continue;
+        }
+        if (TYPEOF(entry) == INTSXP) {
+            SEXP callee = importedClosure(INTEGER(entry)[0]);
+            if (!callee)
+                return nullptr;
+            code->addExtraPoolEntry(callee);
+            continue;
+        }
+        Code* promise = deserialize(entry, baseline);
+        if (!promise)
+            return nullptr;
+        code->addExtraPoolEntry(p(promise->container()));
+    }
+    Pool::retain(code);
+
+    return code;
+}
+
+SEXP CodeCache::serialize(Function* fun, Function* baseline,
+                          ClosureNumbering& closures) {
+    // Binding dependencies refer to environments of this session
+    if (fun->bindingDependencies())
+        return nullptr;
+
+    CodeNumbering numbering;
+    if (baseline) {
+        auto codes = allCode(baseline);
+        for (size_t i = 0; i < codes.size(); ++i)
+            numbering[codes[i]] = i;
+    }
+
+    Protect p;
+    SEXP res = p(Rf_allocVector(VECSXP, FunctionEntries));
+    auto& signature = fun->signature();
+
+    SEXP header = Rf_allocVector(INTSXP, 5);
+    SET_VECTOR_ELT(res, FunctionHeader, header);
+    INTEGER(header)[0] = (int)signature.envCreation;
+    INTEGER(header)[1] = (int)signature.optimization;
+    INTEGER(header)[2] = fun->unoptimizable;
+    INTEGER(header)[3] = fun->uninlinable;
+    INTEGER(header)[4] = signature.hasDotsFormals;
+
+    SEXP assumptions = Rf_allocVector(RAWSXP, sizeof(Assumptions));
+    SET_VECTOR_ELT(res, FunctionAssumptions, assumptions);
+    memcpy(RAW(assumptions), &signature.assumptions, sizeof(Assumptions));
+
+    SEXP arguments = Rf_allocVector(INTSXP, 3 * signature.formalNargs());
+    SET_VECTOR_ELT(res, FunctionArguments, arguments);
+    for (size_t i = 0; i < signature.formalNargs(); ++i) {
+        auto& arg = signature.arguments[i];
+        INTEGER(arguments)[3 * i] = arg.isEvaluated;
+        INTEGER(arguments)[3 * i + 1] = arg.type;
+        INTEGER(arguments)[3 * i + 2] = arg.length;
+    }
+
+    SEXP body = serialize(fun->body(), numbering, closures);
+    if (!body)
+        return nullptr;
+    SET_VECTOR_ELT(res, FunctionBody, body);
+
+    SEXP defaultArgs = Rf_allocVector(VECSXP, fun->numArgs);
+    SET_VECTOR_ELT(res, FunctionDefaultArgs, defaultArgs);
+    for (size_t i = 0; i < fun->numArgs; ++i) {
+        if (auto arg = fun->defaultArg(i)) {
+            SEXP s = serialize(arg, numbering, closures);
+            if (!s)
+                return nullptr;
+            SET_VECTOR_ELT(defaultArgs, i, s);
+        }
+    }
+
+    return res;
+}
+
+// Checks the types and lengths of the entries of a serialized function
+static bool isFunctionStore(SEXP store) {
+    if (TYPEOF(store) != VECSXP || XLENGTH(store) != FunctionEntries)
+        return false;
+    SEXP header = VECTOR_ELT(store, FunctionHeader);
+    if (TYPEOF(header) != INTSXP || XLENGTH(header) != 5)
+        return false;
+    int envCreation = INTEGER(header)[0];
+    int optimization = INTEGER(header)[1];
+    if (envCreation < 0 ||
+        envCreation > (int)FunctionSignature::Environment::CalleeCreated ||
+        optimization < 0 ||
+        optimization > (int)FunctionSignature::OptimizationLevel::Contextual)
+        return false;
+    SEXP assumptions = VECTOR_ELT(store, FunctionAssumptions);
+    SEXP arguments = VECTOR_ELT(store, FunctionArguments);
+    return TYPEOF(assumptions) == RAWSXP &&
+           XLENGTH(assumptions) == sizeof(Assumptions) &&
+           TYPEOF(arguments) == INTSXP && XLENGTH(arguments) % 3 == 0 &&
+           TYPEOF(VECTOR_ELT(store, FunctionDefaultArgs)) == VECSXP;
+}
+
+static void verify(void* container) {
+    CodeVerifier::verifyFunctionLayout((SEXP)container, globalContext());
+}
+
+Function* CodeCache::deserialize(SEXP store, Function* baseline) {
+    if (!isFunctionStore(store))
+        return nullptr;
+    // Optimized versions deopt into the baseline, thus they have the same
+    // default arguments
+    SEXP args = VECTOR_ELT(store, FunctionDefaultArgs);
+    if (baseline && (size_t)XLENGTH(args) != baseline->numArgs)
+        return nullptr;
+
+    std::vector<Code*> codes;
+    if (baseline)
+        codes = allCode(baseline);
+
+    Protect p;
+    int* header = INTEGER(VECTOR_ELT(store, FunctionHeader));
+    Assumptions assumptions;
+    memcpy(&assumptions, RAW(VECTOR_ELT(store, FunctionAssumptions)),
+           sizeof(Assumptions));
+    FunctionSignature signature(
+        (FunctionSignature::Environment)header[0],
+        (FunctionSignature::OptimizationLevel)header[1], assumptions);
+    SEXP arguments = VECTOR_ELT(store, FunctionArguments);
+    for (R_xlen_t i = 0; i < XLENGTH(arguments) / 3; ++i) {
+        FunctionSignature::ArgumentType arg(INTEGER(arguments)[3 * i],
+                                            INTEGER(arguments)[3 * i + 1]);
+        arg.length = INTEGER(arguments)[3 * i + 2];
+        signature.pushArgument(arg);
+    }
+    signature.hasDotsFormals = header[4];
+
+    Code* body = deserialize(VECTOR_ELT(store, FunctionBody), codes);
+    if (!body)
+        return nullptr;
+    p(body->container());
+
+    std::vector<SEXP> defaultArgs;
+    for (R_xlen_t i = 0; i < XLENGTH(args); ++i) {
+        if (VECTOR_ELT(args, i) == R_NilValue) {
+            defaultArgs.push_back(nullptr);
+            continue;
+        }
+        Code* arg = deserialize(VECTOR_ELT(args, i), codes);
+        if (!arg)
+            return nullptr;
+        defaultArgs.push_back(p(arg->container()));
+    }
+
+    size_t functionSize = sizeof(Function) + defaultArgs.size() * sizeof(SEXP);
+    SEXP container = p(Rf_allocVector(EXTERNALSXP, functionSize));
+    Function* fun = new (INTEGER(container))
+        Function(functionSize, body->container(), defaultArgs, signature);
+    fun->unoptimizable = header[2];
+    fun->uninlinable = header[3];
+
+    // The verifier signals an R error for malformed code. It is caught here,
+    // the caller then keeps the freshly compiled version.
+    if (!R_ToplevelExec(verify, container))
+        return nullptr;
+
+    return fun;
+}
+
+void CodeCache::remember(SEXP closure) {
+    auto r = remembered.find(closure);
+    if (r != remembered.end()) {
+        if (R_WeakRefKey(r->second) == closure)
+            return;
+        // A collected closure, which had the same address
+        R_ReleaseObject(r->second);
+    }
+    SEXP ref = R_MakeWeakRef(closure, R_NilValue, R_NilValue, FALSE);
+    R_PreserveObject(ref);
+    remembered[closure] = ref;
+}
+
+SEXP CodeCache::exportCache() {
+    auto ctx = globalContext();
+    Protect p;
+    SEXP list = p(Rf_allocVector(VECSXP, remembered.size()));
+    size_t n = 0;
+    ClosureNumbering closures;
+
+    for (auto r = remembered.begin(); r != remembered.end();) {
+        SEXP closure = R_WeakRefKey(r->second);
+        if (closure != r->first) {
+            R_ReleaseObject(r->second);
+            r = remembered.erase(r);
+            continue;
+        }
+        r++;
+
+        auto table = DispatchTable::check(BODY(closure));
+        if (!table || table->size() < 2 || !isPersistableEnv(CLOENV(closure)))
+            continue;
+
+        Protect q;
+        Function* baseline = table->baseline();
+        SEXP versions = q(Rf_allocVector(VECSXP, table->size() - 1));
+        size_t nversions = 0;
+        for (size_t i = 1; i < table->size(); ++i)
+            if (SEXP version = serialize(table->get(i), baseline, closures))
+                SET_VECTOR_ELT(versions, nversions++, version);
+        if (nversions == 0)
+            continue;
+
+        SEXP base = serialize(baseline, nullptr, closures);
+        if (!base)
+            continue;
+        SEXP entry = Rf_allocVector(VECSXP, CacheEntries);
+        SET_VECTOR_ELT(list, n++, entry);
+        SET_VECTOR_ELT(entry, CacheBaseline, base);
+        SET_VECTOR_ELT(entry, CacheVersions,
+                       Rf_xlengthgets(versions, nversions));
+        SET_VECTOR_ELT(entry, CacheFormals, FORMALS(closure));
+        SET_VECTOR_ELT(entry, CacheBody,
+                       src_pool_at(ctx, baseline->body()->src));
+        SET_VECTOR_ELT(entry, CacheEnvironment, CLOENV(closure));
+    }
+
+    SEXP res = p(Rf_allocVector(VECSXP, 3));
+    SEXP header = Rf_allocVector(INTSXP, 2);
+    SET_VECTOR_ELT(res, 0, header);
+    INTEGER(header)[0] = FORMAT_VERSION;
+    INTEGER(header)[1] = (int)Opcode::num_of;
+    SET_VECTOR_ELT(res, 1, Rf_xlengthgets(list, n));
+
+    SEXP identities = Rf_allocVector(VECSXP, closures.size());
+    SET_VECTOR_ELT(res, 2, identities);
+    for (size_t i = 0; i < closures.size(); ++i) {
+        SEXP closure = closures[i].first;
+        SEXP identity = Rf_allocVector(VECSXP, ClosureEntries);
+        SET_VECTOR_ELT(identities, i, identity);
+        SET_VECTOR_ELT(identity, ClosureSymbol, closures[i].second);
+        SET_VECTOR_ELT(identity, ClosureEnvironment, CLOENV(closure));
+        SET_VECTOR_ELT(identity, ClosureFormals, FORMALS(closure));
+        SET_VECTOR_ELT(identity, ClosureBody, closureAst(closure));
+    }
+    return res;
+}
+
+void CodeCache::importCache(SEXP cache) {
+    if (TYPEOF(cache) != VECSXP || XLENGTH(cache) != 3 ||
+        TYPEOF(VECTOR_ELT(cache, 0)) != INTSXP ||
+        XLENGTH(VECTOR_ELT(cache, 0)) != 2)
+        Rf_error("not a rir code cache");
+    int* header = INTEGER(VECTOR_ELT(cache, 0));
+    if (header[0] != FORMAT_VERSION || header[1] != (int)Opcode::num_of) {
+        Rf_warning("rir code cache was written by an incompatible version");
+        return;
+    }
+
+    if (imported)
+        R_ReleaseObject(imported);
+    imported = cache;
+    R_PreserveObject(imported);
+    entries.clear();
+
+    SEXP list = VECTOR_ELT(cache, 1);
+    if (TYPEOF(list) != VECSXP || TYPEOF(VECTOR_ELT(cache, 2)) != VECSXP)
+        Rf_error("not a rir code cache");
+    for (R_xlen_t i = 0; i < XLENGTH(list); ++i) {
+        SEXP entry = VECTOR_ELT(list, i);
+        if (TYPEOF(entry) != VECSXP || XLENGTH(entry) != CacheEntries ||
+            TYPEOF(VECTOR_ELT(entry, CacheVersions)) != VECSXP)
+            continue;
+        entries[hashAst(VECTOR_ELT(entry, CacheBody))] = entry;
+    }
+}
+
+SEXP CodeCache::importedClosure(int number) {
+    SEXP identities = VECTOR_ELT(imported, 2);
+    if (number < 0 || number >= XLENGTH(identities))
+        return nullptr;
+    SEXP identity = VECTOR_ELT(identities, number);
+    if (TYPEOF(identity) != VECSXP || XLENGTH(identity) != ClosureEntries)
+        return nullptr;
+    SEXP sym = VECTOR_ELT(identity, ClosureSymbol);
+    SEXP env = VECTOR_ELT(identity, ClosureEnvironment);
+    if (TYPEOF(sym) != SYMSXP || TYPEOF(env) != ENVSXP)
+        return nullptr;
+
+    SEXP closure = bindingValue(env, sym);
+    if (TYPEOF(closure) != CLOSXP || CLOENV(closure) != env)
+        return nullptr;
+    Protect p(closure);
+    SEXP ast = p(closureAst(closure));
+    if (!equalAst(FORMALS(closure), VECTOR_ELT(identity, ClosureFormals)) ||
+        !equalAst(ast, VECTOR_ELT(identity, ClosureBody)))
+        return nullptr;
+
+    // Static calls dispatch on the versions of the callee
+    if (!DispatchTable::check(BODY(closure))) {
+        Compiler::compileClosure(closure);
+        install(closure, ast);
+    }
+    return closure;
+}
+
+bool CodeCache::install(SEXP closure, SEXP ast) {
+    if (entries.empty())
+        return false;
+
+    auto e = entries.find(hashAst(ast));
+    if (e == entries.end())
+        return false;
+    SEXP entry = e->second;
+    if (CLOENV(closure) != VECTOR_ELT(entry, CacheEnvironment) ||
+        !equalAst(FORMALS(closure), VECTOR_ELT(entry, CacheFormals)) ||
+        !equalAst(ast, VECTOR_ELT(entry, CacheBody)))
+        return false;
+
+    // The optimized versions deopt into the cached baseline, thus we replace
+    // the freshly compiled one
+    Function* baseline = deserialize(VECTOR_ELT(entry, CacheBaseline), nullptr);
+    if (!baseline)
+        return false;
+    Protect p(baseline->container());
+    auto table = DispatchTable::unpack(BODY(closure));
+    if (baseline->signature().optimization !=
+            FunctionSignature::OptimizationLevel::Baseline ||
+        baseline->numArgs != table->baseline()->numArgs)
+        return false;
+
+    std::vector<Function*> versions;
+    SEXP cached = VECTOR_ELT(entry, CacheVersions);
+    for (R_xlen_t i = 0; i < XLENGTH(cached); ++i) {
+        if (auto version = deserialize(VECTOR_ELT(cached, i), baseline)) {
+            p(version->container());
+            if (version->signature().optimization !=
+                FunctionSignature::OptimizationLevel::Baseline)
+                versions.push_back(version);
+        }
+    }
+
+    table->baseline(baseline);
+    for (auto version : versions)
+        if (!table->contains(version->signature().assumptions))
+            table->insert(version);
+    return true;
+}
+
+} // namespace rir
@@ -0,0 +1,87 @@
+#ifndef RIR_CODE_CACHE_H
+#define RIR_CODE_CACHE_H
+
+#include "R/r.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace rir {
+
+struct Code;
+struct Function;
+struct InterpreterInstance;
+
+/*
+ * Persistent cache of compiled versions across R sessions.
+ *
+ * Closures which received optimized versions are remembered (through weak
+ * references). On export, their dispatch tables (the baseline including its
+ * type feedback, and all optimized versions) are turned into plain R lists
+ * which can be written to disk with saveRDS. On import, the entries are only
+ * indexed by a hash of the closure body. The actual code objects are
+ * reconstructed lazily, when a closure with an identical body, identical
+ * formals and the same environment is compiled to rir.
+ *
+ * Constant pool and source pool indices are process specific, thus all
+ * immediates referring to them are rewritten to indices into per code object
+ * constant lists. Deopt metadata refers to baseline code by pointer, those
+ * pointers are stored as (code object number, pc offset) pairs.
+ *
+ * The cache file is not trusted. Imported code objects are checked (types,
+ * lengths, instruction boundaries and all indices) and verified before they are
+ * installed, malformed ones are skipped and the closure keeps the code compiled
+ * in this session.
+ *
+ * Closures referred to by the code (static call targets and the constants the
+ * call target guards compare against) are stored by identity: the symbol they
+ * are bound to in their environment, their formals and body. In a new session
+ * the binding is looked up again and the code is only installed if it still
+ * holds the same closure. Static call inline caches are reset.
+ *
+ * Versions which refer to things we cannot reconstruct in a new session, like
+ * closures without such a binding, arbitrary environments or other versions,
+ * are not persisted.
+ */
+class CodeCache {
+  public:
+    static constexpr int FORMAT_VERSION = 6;
+
+    // Remember an optimized closure to be persisted on export
+    static void remember(SEXP closure);
+
+    // Returns a list, suitable for saveRDS, with all remembered closures
+    static SEXP exportCache();
+
+    // Replaces the current cache content by the entries of an exported list
+    static void importCache(SEXP cache);
+
+    // Install cached versions into a freshly rir compiled closure. The ast is
+    // the original (non rir) body of the closure.
+    static bool install(SEXP closure, SEXP ast);
+
+  private:
+    typedef std::unordered_map<Code*, unsigned> CodeNumbering;
+    // Closures referred to by the exported code, in the order of their numbers
+    typedef std::vector<std::pair<SEXP, SEXP>> ClosureNumbering;
+
+    static SEXP serialize(Function* fun, Function* baseline,
+                          ClosureNumbering& closures);
+    static Function* deserialize(SEXP store, Function* baseline);
+    static SEXP serialize(Code* code, const CodeNumbering& baseline,
+                          ClosureNumbering& closures);
+    static Code* deserialize(SEXP store, const std::vector<Code*>& baseline);
+
+    // The closure with the given number in the imported cache, nullptr if it
+    // does not exist in this session
+    static SEXP importedClosure(int number);
+
+    static std::unordered_map<SEXP, SEXP> remembered;
+    static std::unordered_map<uint64_t, SEXP> entries;
+    static SEXP imported;
+};
+
+} // namespace rir
+
+#endif
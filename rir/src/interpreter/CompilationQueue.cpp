@@ -0,0 +1,80 @@
+#include "CompilationQueue.h"
+#include "compiler/parameter.h"
+#include "instance.h"
+
+#include <cstring>
+
+namespace rir {
+
+bool CompilationQueue::enqueue(SEXP closure, const Assumptions& given,
+                               SEXP name,
+                               FunctionSignature::OptimizationLevel tier) {
+    assert(TYPEOF(closure) == CLOSXP);
+    if (closure == inFlight)
+        return false;
+    for (auto& r : pending) {
+        if (r.closure == closure && r.given == given) {
+            if (r.tier < tier)
+                r.tier = tier;
+            return false;
+        }
+    }
+    if (pending.size() == MAX_PENDING)
+        return false;
+
+    // Released again when the request is drained
+    R_PreserveObject(closure);
+    pending.push_back({closure, given, name, tier});
+    return true;
+}
+
+namespace {
+struct Compilation {
+    InterpreterInstance* ctx;
+    CompilationQueue* queue;
+    const CompilationQueue::Request& request;
+    // In flight in an enclosing drain, if the optimizer reached a safe point
+    SEXP outer;
+};
+} // namespace
+
+SEXP CompilationQueue::compile(void* data) {
+    auto c = static_cast<Compilation*>(data);
+    auto& r = c->request;
+    c->queue->inFlight = r.closure;
+    c->ctx->closureOptimizer(r.closure, r.given, r.name, r.tier);
+    return R_NilValue;
+}
+
+// Runs on normal exit and when the optimizer longjmps out with an R error
+void CompilationQueue::finish(void* data) {
+    auto c = static_cast<Compilation*>(data);
+    c->queue->inFlight = c->outer;
+    R_ReleaseObject(c->request.closure);
+}
+
+void CompilationQueue::drain(InterpreterInstance* ctx, size_t budget) {
+    while (!pending.empty() && budget--) {
+        // Pop before compiling, the optimizer might call back into the
+        // interpreter and reach the safe point again.
+        Request r = pending.front();
+        pending.pop_front();
+        Compilation c = {ctx, this, r, inFlight};
+        R_ExecWithCleanup(compile, &c, finish, &c);
+    }
+}
+
+CompilationQueue& compilationQueue() {
+    static CompilationQueue queue;
+    return queue;
+}
+
+bool pir::Parameter::DEFERRED_COMPILATION =
+    getenv("PIR_DEFERRED_COMPILATION") &&
+    0 == strncmp("1", getenv("PIR_DEFERRED_COMPILATION"), 1);
+unsigned pir::Parameter::DEFERRED_COMPILATION_BUDGET =
+    getenv("PIR_DEFERRED_COMPILATION_BUDGET")
+        ? atoi(getenv("PIR_DEFERRED_COMPILATION_BUDGET"))
+        : 1;
+
+} // namespace rir
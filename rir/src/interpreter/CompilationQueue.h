@@ -0,0 +1,63 @@
+#ifndef RIR_COMPILATION_QUEUE_H
+#define RIR_COMPILATION_QUEUE_H
+
+#include "R/r.h"
+#include "runtime/Assumptions.h"
+#include "runtime/FunctionSignature.h"
+
+#include <deque>
+
+namespace rir {
+
+struct InterpreterInstance;
+
+/*
+ * Pending optimization requests for hot closures.
+ *
+ * Instead of running the PIR pipeline at the call which crossed the warmup
+ * threshold, the interpreter enqueues the closure together with the
+ * assumptions it wants a version for, and keeps executing the current
+ * version. The queue is drained at the interpreter's safe point (the periodic
+ * user interrupt check), a bounded number of requests at a time. The
+ * optimizer installs finished versions into the dispatch table as usual, so
+ * the next call picks them up.
+ *
+ * Note: the R API is not thread safe and the PIR compiler allocates on the R
+ * heap, thus draining happens on the R thread.
+ */
+class CompilationQueue {
+  public:
+    static constexpr size_t MAX_PENDING = 32;
+
+    // Returns false if the request is already pending or being compiled, or
+    // the queue is full. A pending request for a lower tier is upgraded.
+    bool enqueue(SEXP closure, const Assumptions& given, SEXP name,
+                 FunctionSignature::OptimizationLevel tier);
+
+    // Compiles at most `budget` pending requests
+    void drain(InterpreterInstance* ctx, size_t budget);
+
+    bool empty() const { return pending.empty(); }
+    size_t size() const { return pending.size(); }
+
+    struct Request {
+        SEXP closure;
+        Assumptions given;
+        SEXP name;
+        FunctionSignature::OptimizationLevel tier;
+    };
+
+  private:
+    std::deque<Request> pending;
+    // The closure of the request the optimizer currently works on
+    SEXP inFlight = nullptr;
+
+    static SEXP compile(void* data);
+    static void finish(void* data);
+};
+
+CompilationQueue& compilationQueue();
+
+} // namespace rir
+
+#endif
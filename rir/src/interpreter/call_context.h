@@ -5,6 +5,7 @@
 #include <assert.h>
 #include <stdint.h>
 
+#include "runtime/CallSiteCache.h"
 #include "runtime/Code.h"
 #include "runtime/DispatchTable.h"
 #include "runtime/Function.h"
@@ -18,7 +19,7 @@
 namespace rir {
 
 struct CallContext {
-    CallContext(Code* c, SEXP callee, size_t nargs, SEXP ast,
+    CallContext(const Code* c, SEXP callee, size_t nargs, SEXP ast,
                 R_bcstack_t* stackArgs, Immediate* implicitArgs,
                 Immediate* names, SEXP callerEnv,
                 const Assumptions& givenAssumptions, InterpreterInstance* ctx)
@@ -67,6 +68,7 @@ struct CallContext {
     const SEXP callee;
     Assumptions givenAssumptions;
     SEXP arglist = nullptr;
+    CallSiteCache* cache = nullptr;
 
     bool hasStackArgs() const { return stackArgs != nullptr; }
     bool hasEagerCallee() const { return TYPEOF(callee) == BUILTINSXP; }
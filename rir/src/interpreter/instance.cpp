@@ -3,12 +3,11 @@
 
 namespace rir {
 
-void initializeResizeableList(ResizeableList* l, size_t capacity, SEXP parent,
+void initializeResizeableList(ResizeableList* l, size_t chunks, SEXP parent,
                               size_t index) {
-    l->capacity = capacity;
-    l->list = Rf_allocVector(VECSXP, capacity);
-    SET_VECTOR_ELT(parent, index, l->list);
-    rl_setLength(l, 0);
+    l->length = 0;
+    l->chunks = Rf_allocVector(VECSXP, chunks);
+    SET_VECTOR_ELT(parent, index, l->chunks);
 }
 
 SEXP R_Subset2Sym;
@@ -24,9 +23,8 @@ InterpreterInstance* context_create() {
     InterpreterInstance* c = new InterpreterInstance;
     c->list = Rf_allocVector(VECSXP, 2);
     R_PreserveObject(c->list);
-    initializeResizeableList(&c->cp, POOL_CAPACITY, c->list, CONTEXT_INDEX_CP);
-    initializeResizeableList(&c->src, POOL_CAPACITY, c->list,
-                             CONTEXT_INDEX_SRC);
+    initializeResizeableList(&c->cp, POOL_CHUNKS, c->list, CONTEXT_INDEX_CP);
+    initializeResizeableList(&c->src, POOL_CHUNKS, c->list, CONTEXT_INDEX_SRC);
     // first item in source and constant pools is R_NilValue so that we can use
     // the index 0 for other purposes
     src_pool_add(c, R_NilValue);
@@ -46,22 +44,32 @@ InterpreterInstance* context_create() {
     c->closureCompiler = [](SEXP closure, SEXP name) {
         return rir_compile(closure, R_NilValue);
     };
-    c->closureOptimizer = [](SEXP f, const Assumptions&, SEXP n) { return f; };
+    c->closureOptimizer = [](SEXP f, const Assumptions&, SEXP n,
+                             FunctionSignature::OptimizationLevel) {
+        return f;
+    };
+    c->continuationOptimizer = [](SEXP, const Assumptions&, SEXP, Opcode*,
+                                  size_t) -> Function* { return nullptr; };
 
     if (pir && std::string(pir).compare("off") == 0) {
         // do nothing; use defaults
     } else if (pir && std::string(pir).compare("force") == 0) {
         c->closureCompiler = [](SEXP f, SEXP n) {
             SEXP rir = rir_compile(f, R_NilValue);
-            return rirOptDefaultOpts(rir, Assumptions(), n);
+            return rirOptDefaultOpts(
+                rir, Assumptions(), n,
+                FunctionSignature::OptimizationLevel::Optimized);
         };
     } else if (pir && std::string(pir).compare("force_dryrun") == 0) {
         c->closureCompiler = [](SEXP f, SEXP n) {
             SEXP rir = rir_compile(f, R_NilValue);
-            return rirOptDefaultOptsDryrun(rir, Assumptions(), n);
+            return rirOptDefaultOptsDryrun(
+                rir, Assumptions(), n,
+                FunctionSignature::OptimizationLevel::Optimized);
         };
     } else {
         c->closureOptimizer = rirOptDefaultOpts;
+        c->continuationOptimizer = rirOptContinuation;
     }
 
     return c;
@@ -4,6 +4,7 @@
 #include "R/r.h"
 #include "ir/BC_inc.h"
 #include "runtime/Assumptions.h"
+#include "runtime/FunctionSignature.h"
 
 #include "interp_incl.h"
 
@@ -23,23 +24,37 @@ namespace rir {
 typedef std::function<SEXP(SEXP expr, SEXP env)> ExprCompiler;
 typedef std::function<SEXP(SEXP closure, SEXP name)> ClosureCompiler;
 typedef std::function<SEXP(SEXP closure, const rir::Assumptions& assumptions,
-                           SEXP name)>
+                           SEXP name,
+                           FunctionSignature::OptimizationLevel tier)>
     ClosureOptimizer;
 
-#define POOL_CAPACITY 4096
+struct Function;
+
+/** Compiles the rest of a closure body, starting at a loop header of its
+  baseline code with stackSize values on the operand stack. Returns nullptr if
+  that is not possible.
+ */
+typedef std::function<Function*(SEXP closure,
+                                const rir::Assumptions& assumptions,
+                                SEXP name, Opcode* entry, size_t stackSize)>
+    ContinuationOptimizer;
+
+#define POOL_CHUNK_BITS 12
+#define POOL_CHUNK_SIZE (1 << POOL_CHUNK_BITS)
+#define POOL_CHUNKS 16
 #define STACK_CAPACITY 4096
 
 /** Resizeable R list.
 
- Allocates large list and then tricks R into believing that the list is actually
- smaller.
+ The entries are stored in R lists of POOL_CHUNK_SIZE elements, which are
+ referenced from a list of chunks. Growing adds another chunk, existing entries
+ are never copied. Only the list of chunks is reallocated when it is full.
 
- This works because R uses non-moving GC and is used for constant and source
- pools as well as the interpreter object stack.
+ This is used for the constant and source pools.
  */
 typedef struct {
-    SEXP list;
-    size_t capacity;
+    SEXP chunks;
+    size_t length;
 } ResizeableList;
 
 #define CONTEXT_INDEX_CP 0
@@ -60,54 +75,92 @@ struct InterpreterInstance {
     ExprCompiler exprCompiler;
     ClosureCompiler closureCompiler;
     ClosureOptimizer closureOptimizer;
+    ContinuationOptimizer continuationOptimizer;
 };
 
-// TODO we might actually need to do more for the lengths (i.e. true length vs
-// length)
+RIR_INLINE size_t rl_length(ResizeableList* l) { return l->length; }
 
-RIR_INLINE size_t rl_length(ResizeableList* l) { return Rf_length(l->list); }
+RIR_INLINE SEXP rl_at(ResizeableList* l, size_t i) {
+    SLOWASSERT(i < l->length);
+    return VECTOR_ELT(VECTOR_ELT(l->chunks, i >> POOL_CHUNK_BITS),
+                      i & (POOL_CHUNK_SIZE - 1));
+}
 
-RIR_INLINE void rl_setLength(ResizeableList* l, size_t length) {
-    ((VECSEXP)l->list)->vecsxp.length = length;
-    ((VECSEXP)l->list)->vecsxp.truelength = length;
+RIR_INLINE void rl_set(ResizeableList* l, size_t i, SEXP val) {
+    SLOWASSERT(i < l->length);
+    SET_VECTOR_ELT(VECTOR_ELT(l->chunks, i >> POOL_CHUNK_BITS),
+                   i & (POOL_CHUNK_SIZE - 1), val);
 }
 
 RIR_INLINE void rl_grow(ResizeableList* l, SEXP parent, size_t index) {
-    int oldsize = rl_length(l);
-    SEXP n = Rf_allocVector(VECSXP, l->capacity * 2);
-    memcpy(DATAPTR(n), DATAPTR(l->list), l->capacity * sizeof(SEXP));
-    SET_VECTOR_ELT(parent, index, n);
-    l->list = n;
-    rl_setLength(l, oldsize);
-    l->capacity *= 2;
+    size_t chunk = l->length >> POOL_CHUNK_BITS;
+    size_t numChunks = XLENGTH(l->chunks);
+    if (chunk == numChunks) {
+        SEXP n = Rf_allocVector(VECSXP, numChunks * 2);
+        for (size_t i = 0; i < numChunks; ++i)
+            SET_VECTOR_ELT(n, i, VECTOR_ELT(l->chunks, i));
+        SET_VECTOR_ELT(parent, index, n);
+        l->chunks = n;
+    }
+    SEXP c = Rf_allocVector(VECSXP, POOL_CHUNK_SIZE);
+    SET_VECTOR_ELT(l->chunks, chunk, c);
 }
 
 RIR_INLINE void rl_append(ResizeableList* l, SEXP val, SEXP parent,
                           size_t index) {
-    size_t i = rl_length(l);
-    if (i == l->capacity) {
+    size_t i = l->length;
+    if ((i & (POOL_CHUNK_SIZE - 1)) == 0) {
         PROTECT(val);
         rl_grow(l, parent, index);
         UNPROTECT(1);
     }
-    rl_setLength(l, i + 1);
-    SET_VECTOR_ELT(l->list, i, val);
+    l->length = i + 1;
+    rl_set(l, i, val);
 }
 
 #define ostack_length(c) (R_BCNodeStackTop - R_BCNodeStackBase)
 
 #ifdef TYPED_STACK
-#define ostack_top(c) ((R_BCNodeStackTop - 1)->u.sxpval)
+// Scalar ints and reals produced by the arithmetic fast paths are stored
+// unboxed in the stack cell, tagged with their type (as in GNU R's bytecode
+// interpreter). The GC only traces cells with a zero tag. Reading a cell as a
+// SEXP boxes it in place, thus all the accessors below return proper SEXPs.
+// Careful: boxing allocates, do not hold on to values popped earlier.
+RIR_INLINE SEXP ostack_box(R_bcstack_t* cell) {
+    switch (cell->tag) {
+    case INTSXP: {
+        SEXP res = Rf_ScalarInteger(cell->u.ival);
+        cell->u.sxpval = res;
+        cell->tag = 0;
+        return res;
+    }
+    case REALSXP: {
+        SEXP res = Rf_ScalarReal(cell->u.dval);
+        cell->u.sxpval = res;
+        cell->tag = 0;
+        return res;
+    }
+    default:
+        return cell->u.sxpval;
+    }
+}
+#endif
+
+#ifdef TYPED_STACK
+#define ostack_top(c) (ostack_box(R_BCNodeStackTop - 1))
 #else
 #define ostack_top(c) (*(R_BCNodeStackTop - 1))
 #endif
 
 #ifdef TYPED_STACK
-#define ostack_at(c, i) ((R_BCNodeStackTop - 1 - (i))->u.sxpval)
+#define ostack_at(c, i) (ostack_box(R_BCNodeStackTop - 1 - (i)))
+// Only for cells boxed with ostack_box_n
 #define ostack_at_cell(cell) ((cell)->u.sxpval)
+#define ostack_tag_at(c, i) ((R_BCNodeStackTop - 1 - (i))->tag)
 #else
 #define ostack_at(c, i) (*(R_BCNodeStackTop - 1 - (i)))
 #define ostack_at_cell(cell) (*(cell))
+#define ostack_tag_at(c, i) 0
 #endif
 
 #ifdef TYPED_STACK
@@ -129,6 +182,20 @@ RIR_INLINE void rl_append(ResizeableList* l, SEXP val, SEXP parent,
 
 #define ostack_cell_at(c, i) (R_BCNodeStackTop - 1 - (i))
 
+// Boxes the top n cells, eg. the arguments of a call
+#ifdef TYPED_STACK
+#define ostack_box_n(c, n)                                                     \
+    do {                                                                       \
+        for (R_bcstack_t* __cell__ = R_BCNodeStackTop - (n);                   \
+             __cell__ < R_BCNodeStackTop; ++__cell__)                          \
+            ostack_box(__cell__);                                              \
+    } while (0)
+#else
+#define ostack_box_n(c, n)                                                     \
+    do {                                                                       \
+    } while (0)
+#endif
+
 #define ostack_empty(c) (R_BCNodeStackTop == R_BCNodeStackBase)
 
 #define ostack_popn(c, p)                                                      \
@@ -137,7 +204,7 @@ RIR_INLINE void rl_append(ResizeableList* l, SEXP val, SEXP parent,
     } while (0)
 
 #ifdef TYPED_STACK
-#define ostack_pop(c) ((--R_BCNodeStackTop)->u.sxpval)
+#define ostack_pop(c) (ostack_box(--R_BCNodeStackTop))
 #else
 #define ostack_pop(c) (*(--R_BCNodeStackTop))
 #endif
@@ -150,6 +217,20 @@ RIR_INLINE void rl_append(ResizeableList* l, SEXP val, SEXP parent,
         R_BCNodeStackTop->tag = 0;                                             \
         ++R_BCNodeStackTop;                                                    \
     } while (0)
+#define ostack_push_int(c, v)                                                  \
+    do {                                                                       \
+        int __tmp__ = (v);                                                     \
+        R_BCNodeStackTop->u.ival = __tmp__;                                    \
+        R_BCNodeStackTop->tag = INTSXP;                                        \
+        ++R_BCNodeStackTop;                                                    \
+    } while (0)
+#define ostack_push_real(c, v)                                                 \
+    do {                                                                       \
+        double __tmp__ = (v);                                                  \
+        R_BCNodeStackTop->u.dval = __tmp__;                                    \
+        R_BCNodeStackTop->tag = REALSXP;                                       \
+        ++R_BCNodeStackTop;                                                    \
+    } while (0)
 #else
 #define ostack_push(c, v)                                                      \
     do {                                                                       \
@@ -157,8 +238,18 @@ RIR_INLINE void rl_append(ResizeableList* l, SEXP val, SEXP parent,
         *R_BCNodeStackTop = __tmp__;                                           \
         ++R_BCNodeStackTop;                                                    \
     } while (0)
+#define ostack_push_int(c, v) ostack_push(c, Rf_ScalarInteger(v))
+#define ostack_push_real(c, v) ostack_push(c, Rf_ScalarReal(v))
 #endif
 
+// Pushes a copy of a cell, without boxing it
+#define ostack_push_cell(c, cell)                                              \
+    do {                                                                       \
+        R_bcstack_t __tmp__ = *(cell);                                         \
+        *R_BCNodeStackTop = __tmp__;                                           \
+        ++R_BCNodeStackTop;                                                    \
+    } while (0)
+
 RIR_INLINE void ostack_ensureSize(InterpreterInstance* c, unsigned minFree) {
     if ((R_BCNodeStackTop + minFree) >= R_BCNodeStackEnd) {
         // TODO....
@@ -186,25 +277,17 @@ class Locals final {
             R_BCNodeStackTop -= localsCount;
     }
 
-    SEXP load(unsigned offset) {
+    // Locals are stack cells, unboxed values stay unboxed
+    R_bcstack_t* load(unsigned offset) {
         SLOWASSERT(offset < localsCount &&
                    "Attempt to load invalid local variable.");
-#ifdef TYPED_STACK
-        return (base + offset)->u.sxpval;
-#else
-        return base[offset];
-#endif
+        return base + offset;
     }
 
-    void store(unsigned offset, SEXP val) {
+    void store(unsigned offset, const R_bcstack_t* cell) {
         SLOWASSERT(offset < localsCount &&
                    "Attempt to store invalid local variable.");
-#ifdef TYPED_STACK
-        (base + offset)->u.sxpval = val;
-        SLOWASSERT((base + offset)->tag == 0);
-#else
-        base[offset] = val;
-#endif
+        base[offset] = *cell;
     }
 
     Locals(Locals const&) = delete;
@@ -232,18 +315,19 @@ RIR_INLINE size_t src_pool_add(InterpreterInstance* c, SEXP v) {
 }
 
 RIR_INLINE SEXP cp_pool_at(InterpreterInstance* c, unsigned index) {
-    SLOWASSERT(c->cp.capacity > index);
-    return VECTOR_ELT(c->cp.list, index);
+    return rl_at(&c->cp, index);
 }
 
 RIR_INLINE SEXP src_pool_at(InterpreterInstance* c, unsigned index) {
-    SLOWASSERT(c->src.capacity > index);
-    return VECTOR_ELT(c->src.list, index);
+    return rl_at(&c->src, index);
 }
 
 RIR_INLINE void cp_pool_set(InterpreterInstance* c, unsigned index, SEXP e) {
-    SLOWASSERT(c->cp.capacity > index);
-    SET_VECTOR_ELT(c->cp.list, index, e);
+    rl_set(&c->cp, index, e);
+}
+
+RIR_INLINE void src_pool_set(InterpreterInstance* c, unsigned index, SEXP e) {
+    rl_set(&c->src, index, e);
 }
 
 } // namespace rir
@@ -1,16 +1,21 @@
 #include "interp.h"
 #include "ArgsLazyData.h"
+#include "api.h"
+#include "CompilationQueue.h"
 #include "LazyEnvironment.h"
 #include "R/Funtab.h"
 #include "R/RList.h"
 #include "R/Symbols.h"
 #include "compiler/parameter.h"
 #include "compiler/translations/rir_2_pir/rir_2_pir_compiler.h"
+#include "compiler/util/safe_builtins_list.h"
 #include "ir/Deoptimization.h"
 #include "runtime/TypeFeedback_inl.h"
 #include "safe_force.h"
 #include "utils/Pool.h"
+#include "vector_arith.h"
 
+#include <alloca.h>
 #include <assert.h>
 #include <deque>
 #include <set>
@@ -97,6 +102,13 @@ static RIR_INLINE SEXP createPromise(Code* code, SEXP env) {
     return p;
 }
 
+// Bindings found outside of the current frame are cached together with the
+// value of this counter, see BindingCache. It is incremented whenever the
+// interpreter hands control to code which might add, remove or shadow
+// bindings.
+static size_t globalBindingVersion = 1;
+static RIR_INLINE void invalidateGlobalBindings() { globalBindingVersion++; }
+
 static RIR_INLINE SEXP promiseValue(SEXP promise, InterpreterInstance* ctx) {
     // if already evaluated, return the value
     if (PRVALUE(promise) && PRVALUE(promise) != R_UnboundValue) {
@@ -104,6 +116,7 @@ static RIR_INLINE SEXP promiseValue(SEXP promise, InterpreterInstance* ctx) {
         assert(TYPEOF(promise) != PROMSXP);
         return promise;
     } else {
+        invalidateGlobalBindings();
         SEXP res = forcePromise(promise);
         assert(TYPEOF(res) != PROMSXP && "promise returned promise");
         return res;
@@ -149,6 +162,28 @@ static RIR_INLINE void __listAppend(SEXP* front, SEXP* last, SEXP value,
     *last = app;
 }
 
+// The arguments of a call (eg. for nargs()), recovered from the bindings of
+// the environment of the callee
+static SEXP argsFromBindings(SEXP bindings) {
+    SEXP result = R_NilValue;
+    SEXP pos = result;
+    for (; bindings != R_NilValue; bindings = CDR(bindings)) {
+        SEXP val = CAR(bindings);
+        if (val == R_MissingArg)
+            continue;
+        if (TYPEOF(val) == DOTSXP) {
+            for (; val != R_NilValue; val = CDR(val))
+                __listAppend(&result, &pos, CAR(val), TAG(val));
+            continue;
+        }
+        __listAppend(&result, &pos, val, TAG(bindings));
+    }
+
+    if (result != R_NilValue)
+        UNPROTECT(1);
+    return result;
+}
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wcast-align"
 
@@ -365,12 +400,17 @@ static RIR_INLINE SEXP rirCallTrampoline(const CallContext& call, Function* fun,
 static unsigned int count = 0;
 
 // Interrupt Signal Checker - Allows for Ctrl - C functionality to exit out
-// of infinite loops
+// of infinite loops. This is also the safe point where deferred optimization
+// requests are compiled.
 void checkUserInterrupt() {
     if (++count > UI_COUNT_DELTA) {
         R_CheckUserInterrupt();
+        invalidateGlobalBindings();
         R_RunPendingFinalizers();
         count = 0;
+        if (!compilationQueue().empty())
+            compilationQueue().drain(
+                globalContext(), pir::Parameter::DEFERRED_COMPILATION_BUDGET);
     }
 }
 
@@ -436,6 +476,7 @@ static RIR_INLINE SEXP legacySpecialCall(const CallContext& call,
                                          InterpreterInstance* ctx) {
     assert(call.ast != R_NilValue);
     assert(TYPEOF(call.callerEnv) == ENVSXP);
+    invalidateGlobalBindings();
 
     // get the ccode
     CCODE f = getBuiltin(call.callee);
@@ -448,10 +489,24 @@ static RIR_INLINE SEXP legacySpecialCall(const CallContext& call,
     return result;
 }
 
+// Safe builtins do not touch environments, as long as they do not dispatch
+static bool builtinMayChangeBindings(SEXP builtin, SEXP argslist) {
+    if (pir::SafeBuiltinsList::always(builtin))
+        return false;
+    if (!pir::SafeBuiltinsList::nonObject(builtin))
+        return true;
+    for (SEXP a = argslist; a != R_NilValue; a = CDR(a))
+        if (isObject(CAR(a)))
+            return true;
+    return false;
+}
+
 static RIR_INLINE SEXP legacyCallWithArgslist(const CallContext& call,
                                               SEXP argslist,
                                               InterpreterInstance* ctx) {
     if (TYPEOF(call.callee) == BUILTINSXP) {
+        if (builtinMayChangeBindings(call.callee, argslist))
+            invalidateGlobalBindings();
         // get the ccode
         CCODE f = getBuiltin(call.callee);
         int flag = getFlag(call.callee);
@@ -466,6 +521,7 @@ static RIR_INLINE SEXP legacyCallWithArgslist(const CallContext& call,
 
     assert(TYPEOF(call.callee) == CLOSXP &&
            TYPEOF(BODY(call.callee)) != EXTERNALSXP);
+    invalidateGlobalBindings();
     return Rf_applyClosure(call.ast, call.callee, argslist, call.callerEnv,
                            R_NilValue);
 }
@@ -626,7 +682,8 @@ static RIR_INLINE Assumptions addDynamicAssumptionsForOneTarget(
             given.add(Assumption::NotTooFewArguments);
     }
 
-    if (call.suppliedArgs <= signature.formalNargs())
+    if (call.suppliedArgs <= signature.formalNargs() ||
+        signature.hasDotsFormals)
         given.add(Assumption::NotTooManyArguments);
 
     return given;
@@ -650,13 +707,6 @@ static RIR_INLINE bool matches(const CallContext& call,
     assert(signature.envCreation ==
            FunctionSignature::Environment::CalleeCreated);
 
-    if (!call.hasStackArgs()) {
-        // We can't materialize ... in optimized code yet
-        for (size_t i = 0; i < call.suppliedArgs; ++i)
-            if (call.implicitArgIdx(i) == DOTS_ARG_IDX)
-                return false;
-    }
-
     Assumptions given = addDynamicAssumptionsForOneTarget(call, signature);
 
 #ifdef DEBUG_DISPATCH
@@ -684,23 +734,98 @@ static RIR_INLINE void supplyMissingArgs(CallContext& call,
 }
 
 static Function* dispatch(const CallContext& call, DispatchTable* vt) {
+    // The matching versions only depend on the given assumptions and the
+    // number of supplied arguments
+    if (auto fun = vt->cachedTarget(call.givenAssumptions, call.suppliedArgs))
+        return fun;
+
     // Find the most specific version of the function that can be called given
     // the current call context.
-    Function* fun = nullptr;
     for (int i = vt->size() - 1; i >= 0; i--) {
         auto candidate = vt->get(i);
         if (matches(call, candidate->signature())) {
-            fun = candidate;
-            break;
+            vt->cacheTarget(call.givenAssumptions, call.suppliedArgs, i);
+            return candidate;
         }
     }
-    assert(fun);
+    assert(false);
+    return nullptr;
+};
 
+static RIR_INLINE Function* cachedDispatch(const CallContext& call,
+                                           DispatchTable* vt) {
+    if (!call.cache)
+        return dispatch(call, vt);
+    if (auto fun = call.cache->lookup(vt, call.givenAssumptions))
+        return fun;
+    auto fun = dispatch(call, vt);
+    call.cache->insert(vt, call.givenAssumptions, fun);
     return fun;
-};
+}
+
+// Returns the inline cache of the call instruction, whose cache immediate is
+// at pos. The cache is only allocated once the site calls a rir closure.
+static RIR_INLINE CallSiteCache* callSiteCache(Code* c, Opcode* pos,
+                                               SEXP callee) {
+    if (TYPEOF(callee) != CLOSXP || !DispatchTable::check(BODY(callee)))
+        return nullptr;
+    Immediate idx;
+    memcpy(&idx, pos, sizeof(Immediate));
+    if (idx == NO_CALL_SITE_CACHE) {
+        SEXP cache = PROTECT(CallSiteCache::create()->container());
+        idx = c->addExtraPoolEntry(cache);
+        memcpy(pos, &idx, sizeof(Immediate));
+        UNPROTECT(1);
+    }
+    return CallSiteCache::unpack(c->getExtraPoolEntry(idx));
+}
+
+#define ACTIVE_BINDING_MASK (1 << 15)
+#define BINDING_LOCK_MASK (1 << 14)
+#define IS_ACTIVE_BINDING(b) ((b)->sxpinfo.gp & ACTIVE_BINDING_MASK)
+#define BINDING_IS_LOCKED(b) ((b)->sxpinfo.gp & BINDING_LOCK_MASK)
+
+// Optimized versions can rely on bindings of builtins in static environments
+// (see Pir2Rir::elideBindingGuard), instead of guarding them in the code. The
+// bindings are looked up again before entering the version, unless nothing
+// which could change bindings happened since the last time.
+static bool bindingDependenciesHold(Function* fun) {
+    SEXP deps = fun->bindingDependencies();
+    if (!deps || fun->bindingsCheckedAt == globalBindingVersion)
+        return true;
+    for (R_xlen_t i = 0; i < XLENGTH(deps); i += 3) {
+        SEXP sym = VECTOR_ELT(deps, i);
+        SEXP expected = VECTOR_ELT(deps, i + 2);
+        SEXP found = nullptr;
+        // Like Rf_findVar, but without running active bindings or forcing
+        // promises. Both count as a changed binding.
+        for (SEXP rho = VECTOR_ELT(deps, i + 1); rho != R_EmptyEnv;
+             rho = ENCLOS(rho)) {
+            if (TYPEOF(rho) != ENVSXP || OBJECT(rho))
+                return false;
+            R_varloc_t loc = R_findVarLocInFrame(rho, sym);
+            if (R_VARLOC_IS_NULL(loc))
+                continue;
+            if (IS_ACTIVE_BINDING(loc.cell))
+                return false;
+            found = TYPEOF(loc.cell) == SYMSXP ? SYMVALUE(loc.cell)
+                                               : CAR(loc.cell);
+            if (TYPEOF(found) == PROMSXP)
+                found = PRVALUE(found);
+            if (found != R_UnboundValue)
+                break;
+        }
+        if (found != expected)
+            return false;
+    }
+    fun->bindingsCheckedAt = globalBindingVersion;
+    return true;
+}
 
 unsigned pir::Parameter::RIR_WARMUP =
     getenv("PIR_WARMUP") ? atoi(getenv("PIR_WARMUP")) : 3;
+unsigned pir::Parameter::OPT_WARMUP =
+    getenv("PIR_OPT_WARMUP") ? atoi(getenv("PIR_OPT_WARMUP")) : 100;
 
 // Call a RIR function. Arguments are still untouched.
 RIR_INLINE SEXP rirCall(CallContext& call, InterpreterInstance* ctx) {
@@ -710,11 +835,19 @@ RIR_INLINE SEXP rirCall(CallContext& call, InterpreterInstance* ctx) {
     auto table = DispatchTable::unpack(body);
 
     addDynamicAssumptionsFromContext(call);
-    Function* fun = dispatch(call, table);
+    Function* fun = cachedDispatch(call, table);
     fun->registerInvocation();
 
-    if (!fun->unoptimizable &&
-        fun->invocationCount() % pir::Parameter::RIR_WARMUP == 0) {
+    // Versions of the quick tier which stay hot are recompiled with the full
+    // pipeline, for the same assumptions
+    bool tierUp = fun->signature().optimization ==
+                      FunctionSignature::OptimizationLevel::Quick &&
+                  pir::Parameter::OPT_WARMUP &&
+                  fun->invocationCount() % pir::Parameter::OPT_WARMUP == 0;
+
+    if (!fun->unoptimizable && !table->backingOff() &&
+        (tierUp ||
+         fun->invocationCount() % pir::Parameter::RIR_WARMUP == 0)) {
         Assumptions given =
             addDynamicAssumptionsForOneTarget(call, fun->signature());
         // addDynamicAssumptionForOneTarget compares arguments with the
@@ -723,26 +856,47 @@ RIR_INLINE SEXP rirCall(CallContext& call, InterpreterInstance* ctx) {
         // exactly for this number of arguments, thus we need to add this as an
         // explicit assumption.
         given.add(Assumption::NotTooFewArguments);
+        bool compile = false;
+        auto tier = FunctionSignature::OptimizationLevel::Optimized;
         if (fun == table->baseline() || given != fun->signature().assumptions) {
-            if (Assumptions(given).includes(
-                    pir::Rir2PirCompiler::minimalAssumptions)) {
-                // More assumptions are available than this version uses. Let's
-                // try compile a better matching version.
+            // More assumptions are available than this version uses. Let's
+            // try compile a better matching version, starting with the quick
+            // tier.
+            compile = Assumptions(given).includes(
+                pir::Rir2PirCompiler::minimalAssumptions);
+            if (pir::Parameter::OPT_WARMUP)
+                tier = FunctionSignature::OptimizationLevel::Quick;
+        } else if (tierUp) {
+            compile = true;
+        }
+        if (compile) {
 #ifdef DEBUG_DISPATCH
-                std::cout << "Optimizing for new context:";
-                std::cout << given << " vs " << fun->signature().assumptions
-                          << "\n";
+            std::cout << "Optimizing for new context:";
+            std::cout << given << " vs " << fun->signature().assumptions
+                      << "\n";
 #endif
-                SEXP lhs = CAR(call.ast);
-                SEXP name = R_NilValue;
-                if (TYPEOF(lhs) == SYMSXP)
-                    name = lhs;
-                ctx->closureOptimizer(call.callee, given, name);
-                fun = dispatch(call, table);
+            SEXP lhs = CAR(call.ast);
+            SEXP name = R_NilValue;
+            if (TYPEOF(lhs) == SYMSXP)
+                name = lhs;
+            if (pir::Parameter::DEFERRED_COMPILATION) {
+                // Keep running the current version, the new one gets
+                // installed at the next safe point.
+                compilationQueue().enqueue(call.callee, given, name, tier);
+            } else {
+                ctx->closureOptimizer(call.callee, given, name, tier);
+                fun = cachedDispatch(call, table);
             }
         }
     }
 
+    while (!bindingDependenciesHold(fun)) {
+        table->remove(fun->body());
+        // The module still holds the version and would hand it out again
+        pirInvalidateModules();
+        fun = cachedDispatch(call, table);
+    }
+
     bool needsEnv = fun->signature().envCreation ==
                     FunctionSignature::Environment::CallerProvided;
     SEXP result = nullptr;
@@ -852,6 +1006,61 @@ static RIR_INLINE SEXP specialCall(CallContext& call,
     return legacySpecialCall(call, ctx);
 }
 
+// Pushes the elements of a ... list as arguments and appends their names (0
+// for none). Like createLegacyArgsList, anything but a DOTSXP is empty.
+static size_t pushDotsArgs(SEXP dots, std::vector<Immediate>& names,
+                           bool& hasNames, InterpreterInstance* ctx) {
+    size_t n = 0;
+    if (TYPEOF(dots) != DOTSXP)
+        return n;
+    for (; dots != R_NilValue; dots = CDR(dots), ++n) {
+        ostack_push(ctx, CAR(dots));
+        if (TAG(dots) == R_NilValue) {
+            names.push_back(0);
+        } else {
+            names.push_back(Pool::insert(TAG(dots)));
+            hasNames = true;
+        }
+    }
+    return n;
+}
+
+// Implicit calls passing ... are turned into calls with the arguments on the
+// stack, thus optimized versions can be dispatched to. The assumptions of the
+// call site describe the unexpanded arguments, and the number of arguments
+// varies between calls, thus neither they nor the call site cache are used.
+static SEXP rirCallWithDots(CallContext& call, InterpreterInstance* ctx) {
+    std::vector<Immediate> names;
+    bool hasNames = false;
+    size_t n = 0;
+    for (size_t i = 0; i < call.suppliedArgs; ++i) {
+        auto argi = call.implicitArgIdx(i);
+        if (argi == DOTS_ARG_IDX) {
+            n += pushDotsArgs(Rf_findVar(R_DotsSymbol, call.callerEnv), names,
+                              hasNames, ctx);
+            continue;
+        }
+        if (argi == MISSING_ARG_IDX)
+            ostack_push(ctx, R_MissingArg);
+        else
+            ostack_push(ctx,
+                        createPromise(call.implicitArg(i), call.callerEnv));
+        Immediate name = call.hasNames() ? call.names[i] : 0;
+        if (cp_pool_at(ctx, name) != R_NilValue)
+            hasNames = true;
+        names.push_back(name);
+        n++;
+    }
+
+    CallContext expanded(call.caller, call.callee, n, call.ast,
+                         ostack_cell_at(ctx, n - 1), nullptr,
+                         hasNames ? names.data() : nullptr, call.callerEnv,
+                         Assumptions(), ctx);
+    SEXP res = rirCall(expanded, ctx);
+    ostack_popn(ctx, expanded.passedArgs);
+    return res;
+}
+
 static SEXP doCall(CallContext& call, InterpreterInstance* ctx) {
     assert(call.callee);
 
@@ -863,6 +1072,11 @@ static SEXP doCall(CallContext& call, InterpreterInstance* ctx) {
     case CLOSXP: {
         if (TYPEOF(BODY(call.callee)) != EXTERNALSXP)
             return legacyCall(call, ctx);
+        if (!call.hasStackArgs()) {
+            for (size_t i = 0; i < call.suppliedArgs; ++i)
+                if (call.implicitArgIdx(i) == DOTS_ARG_IDX)
+                    return rirCallWithDots(call, ctx);
+        }
         return rirCall(call, ctx);
     }
     default:
@@ -873,6 +1087,7 @@ static SEXP doCall(CallContext& call, InterpreterInstance* ctx) {
 
 static SEXP dispatchApply(SEXP ast, SEXP obj, SEXP actuals, SEXP selector,
                           SEXP callerEnv, InterpreterInstance* ctx) {
+    invalidateGlobalBindings();
     SEXP op = SYMVALUE(selector);
 
     // ===============================================
@@ -1002,10 +1217,11 @@ static SEXPREC createFakeCONS(SEXP cdr) {
             arglist2.u.listsxp.carval = rhs;                                   \
             res = blt(call, prim, &arglist, env);                              \
         } else {                                                               \
+            invalidateGlobalBindings();                                        \
             SEXP arglist = CONS_NR(lhs, CONS_NR(rhs, R_NilValue));             \
             ostack_push(ctx, arglist);                                         \
             res = blt(call, prim, arglist, env);                               \
-            ostack_pop(ctx);                                                   \
+            ostack_popn(ctx, 1);                                               \
         }                                                                      \
                                                                                \
         if (flag < 2)                                                          \
@@ -1063,15 +1279,16 @@ static SEXPREC createFakeCONS(SEXP cdr) {
         if (NO_REFERENCES(a)) {                                                \
             TYPEOF(a) = res_type;                                              \
             res = a;                                                           \
-            ostack_pop(ctx);                                                   \
-            ostack_at(ctx, 0) = a;                                             \
+            ostack_popn(ctx, 1);                                               \
+            ostack_set(ctx, 0, a);                                             \
         } else if (NO_REFERENCES(b)) {                                         \
             TYPEOF(b) = res_type;                                              \
             res = b;                                                           \
-            ostack_pop(ctx);                                                   \
+            ostack_popn(ctx, 1);                                               \
         } else {                                                               \
-            ostack_pop(ctx);                                                   \
-            ostack_at(ctx, 0) = res = Rf_allocVector(res_type, 1);             \
+            ostack_popn(ctx, 1);                                               \
+            res = Rf_allocVector(res_type, 1);                                 \
+            ostack_set(ctx, 0, res);                                           \
         }                                                                      \
         switch (res_type) {                                                    \
         case INTSXP:                                                           \
@@ -1083,22 +1300,284 @@ static SEXPREC createFakeCONS(SEXP cdr) {
         }                                                                      \
     } while (false)
 
-#define DO_BINOP(op, op2)                                                      \
+#define DO_BINOP(op, op2, vop)                                                 \
     do {                                                                       \
         int int_res = -1;                                                      \
         double real_res = -2.0;                                                \
         int res_type = 0;                                                      \
+        bool overflow = false;                                                 \
         DO_FAST_BINOP(op, op2);                                                \
         if (res_type) {                                                        \
             STORE_BINOP(res_type, int_res, real_res);                          \
             R_Visible = (Rboolean) true;                                       \
+        } else if ((res = vectorBinop(vop, lhs, rhs, overflow))) {             \
+            ostack_popn(ctx, 1);                                               \
+            ostack_set(ctx, 0, res);                                           \
+            R_Visible = (Rboolean) true;                                       \
+            CHECK_INTEGER_OVERFLOW(R_NilValue, overflow);                      \
         } else {                                                               \
             BINOP_FALLBACK(#op);                                               \
-            ostack_pop(ctx);                                                   \
+            ostack_popn(ctx, 1);                                               \
             ostack_set(ctx, 0, res);                                           \
         }                                                                      \
     } while (false)
 
+#ifdef TYPED_STACK
+// Reads a scalar int or real operand without boxing it. Returns the type of
+// the operand, 0 if it is anything else.
+static RIR_INLINE int ostack_scalar(R_bcstack_t* cell, int& i, double& d) {
+    switch (cell->tag) {
+    case INTSXP:
+        i = cell->u.ival;
+        return INTSXP;
+    case REALSXP:
+        d = cell->u.dval;
+        return REALSXP;
+    case 0:
+        if (IS_SIMPLE_SCALAR(cell->u.sxpval, INTSXP)) {
+            i = *INTEGER(cell->u.sxpval);
+            return INTSXP;
+        }
+        if (IS_SIMPLE_SCALAR(cell->u.sxpval, REALSXP)) {
+            d = *REAL(cell->u.sxpval);
+            return REALSXP;
+        }
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+static RIR_INLINE double scalarAsReal(int type, int i, double d) {
+    if (type == REALSXP)
+        return d;
+    return i == NA_INTEGER ? NA_REAL : i;
+}
+
+// Arithmetic on scalars, the result is pushed unboxed
+#define DO_UNBOXED_BINOP(op, op2)                                              \
+    do {                                                                       \
+        int li = 0, ri = 0;                                                    \
+        double ld = 0, rd = 0;                                                 \
+        int lt = ostack_scalar(ostack_cell_at(ctx, 1), li, ld);                \
+        int rt = lt ? ostack_scalar(ostack_cell_at(ctx, 0), ri, rd) : 0;       \
+        if (lt == INTSXP && rt == INTSXP) {                                    \
+            Rboolean naflag = FALSE;                                           \
+            int int_res = 0;                                                   \
+            switch (op2) {                                                     \
+            case PLUSOP:                                                       \
+                int_res = R_integer_plus(li, ri, &naflag);                     \
+                break;                                                         \
+            case MINUSOP:                                                      \
+                int_res = R_integer_minus(li, ri, &naflag);                    \
+                break;                                                         \
+            case TIMESOP:                                                      \
+                int_res = R_integer_times(li, ri, &naflag);                    \
+                break;                                                         \
+            }                                                                  \
+            CHECK_INTEGER_OVERFLOW(R_NilValue, naflag);                        \
+            ostack_popn(ctx, 2);                                               \
+            ostack_push_int(ctx, int_res);                                     \
+            R_Visible = (Rboolean) true;                                       \
+            NEXT();                                                            \
+        } else if (lt && rt) {                                                 \
+            ostack_popn(ctx, 2);                                               \
+            ostack_push_real(ctx, scalarAsReal(lt, li, ld)                     \
+                                      op scalarAsReal(rt, ri, rd));            \
+            R_Visible = (Rboolean) true;                                       \
+            NEXT();                                                            \
+        }                                                                      \
+    } while (false)
+
+// Comparison of scalars, without boxing the operands
+#define DO_UNBOXED_RELOP(op)                                                   \
+    do {                                                                       \
+        int li = 0, ri = 0;                                                    \
+        double ld = 0, rd = 0;                                                 \
+        int lt = ostack_scalar(ostack_cell_at(ctx, 1), li, ld);                \
+        int rt = lt ? ostack_scalar(ostack_cell_at(ctx, 0), ri, rd) : 0;       \
+        if (lt && rt) {                                                        \
+            if (lt == INTSXP && rt == INTSXP) {                                \
+                res = (li == NA_INTEGER || ri == NA_INTEGER)                   \
+                          ? R_LogicalNAValue                                   \
+                          : li op ri ? R_TrueValue : R_FalseValue;             \
+            } else {                                                           \
+                double l = scalarAsReal(lt, li, ld);                           \
+                double r = scalarAsReal(rt, ri, rd);                           \
+                res = (ISNAN(l) || ISNAN(r))                                   \
+                          ? R_LogicalNAValue                                   \
+                          : l op r ? R_TrueValue : R_FalseValue;               \
+            }                                                                  \
+            ostack_popn(ctx, 2);                                               \
+            ostack_push(ctx, res);                                             \
+            R_Visible = (Rboolean) true;                                       \
+            NEXT();                                                            \
+        }                                                                      \
+    } while (false)
+#else
+#define DO_UNBOXED_BINOP(op, op2)                                              \
+    do {                                                                       \
+    } while (false)
+#define DO_UNBOXED_RELOP(op)                                                   \
+    do {                                                                       \
+    } while (false)
+
+static RIR_INLINE int ostack_scalar(R_bcstack_t* cell, int& i, double& d) {
+    if (IS_SIMPLE_SCALAR(*cell, INTSXP)) {
+        i = *INTEGER(*cell);
+        return INTSXP;
+    }
+    if (IS_SIMPLE_SCALAR(*cell, REALSXP)) {
+        d = *REAL(*cell);
+        return REALSXP;
+    }
+    return 0;
+}
+#endif
+
+// Reads a scalar index into a vector of length n from a stack cell, without
+// boxing it. Fails for everything which needs the generic subset code: NA,
+// zero, negative and out of bounds indices, indices with attributes and non
+// numeric indices. The result is 0-based.
+static RIR_INLINE bool ostack_index(R_bcstack_t* cell, R_xlen_t n,
+                                    R_xlen_t& res) {
+    int i = 0;
+    double d = 0;
+    int type = ostack_scalar(cell, i, d);
+    if (type == INTSXP) {
+        if (i == NA_INTEGER || i < 1 || i > n)
+            return false;
+        res = i - 1;
+        return true;
+    }
+    // Fails for NA and NaN too
+    if (type == REALSXP && d >= 1 && d < (double)n + 1) {
+        res = (R_xlen_t)d - 1;
+        return true;
+    }
+    return false;
+}
+
+// Int, real and logical vectors, which store their elements in place (ie. no
+// ALTREP compact sequences)
+static RIR_INLINE bool isNumOrLgl(SEXP v) {
+    return (TYPEOF(v) == INTSXP || TYPEOF(v) == REALSXP ||
+            TYPEOF(v) == LGLSXP) &&
+           !ALTREP(v);
+}
+
+// The dim attribute of a matrix as above, without any other attributes,
+// nullptr for everything else
+static RIR_INLINE SEXP plainMatrixDim(SEXP v) {
+    SEXP a = ATTRIB(v);
+    if (!isNumOrLgl(v) || OBJECT(v) || a == R_NilValue ||
+        TAG(a) != R_DimSymbol || CDR(a) != R_NilValue)
+        return nullptr;
+    SEXP dim = CAR(a);
+    if (TYPEOF(dim) != INTSXP || XLENGTH(dim) != 2)
+        return nullptr;
+    return dim;
+}
+
+// Reads a scalar (row, column) index into a matrix with the given dim
+// attribute, see ostack_index. The result is the 0-based element index.
+static RIR_INLINE bool ostack_matrix_index(SEXP dim, R_bcstack_t* row,
+                                           R_bcstack_t* col, R_xlen_t& res) {
+    R_xlen_t i, j;
+    if (!dim || !ostack_index(row, INTEGER(dim)[0], i) ||
+        !ostack_index(col, INTEGER(dim)[1], j))
+        return false;
+    res = i + j * INTEGER(dim)[0];
+    return true;
+}
+
+// Replaces the n topmost stack cells by element i of an int, real or logical
+// vector. Ints and reals are pushed unboxed.
+static RIR_INLINE void ostack_replace_elt(SEXP vec, R_xlen_t i, unsigned n) {
+    switch (TYPEOF(vec)) {
+    case INTSXP: {
+        int v = INTEGER(vec)[i];
+        ostack_popn(ctx, n);
+        ostack_push_int(ctx, v);
+        break;
+    }
+    case REALSXP: {
+        double v = REAL(vec)[i];
+        ostack_popn(ctx, n);
+        ostack_push_real(ctx, v);
+        break;
+    }
+    case LGLSXP: {
+        int v = LOGICAL(vec)[i];
+        ostack_popn(ctx, n);
+        ostack_push(ctx, Rf_ScalarLogical(v));
+        break;
+    }
+    default:
+        assert(false);
+    }
+    R_Visible = (Rboolean) true;
+}
+
+// The dim attribute of a matrix, nullptr for vectors and other arrays
+static RIR_INLINE SEXP matrixDim(SEXP v) {
+    SEXP dim = Rf_getAttrib(v, R_DimSymbol);
+    return TYPEOF(dim) == INTSXP && XLENGTH(dim) == 2 ? dim : nullptr;
+}
+
+// Stores the scalar in a stack cell into element i of an int, real or logical
+// vector, in place and without boxing the value. Fails if the vector would
+// have to be coerced to a different type, or the value is not a scalar int,
+// real or logical without attributes.
+static RIR_INLINE bool ostack_store_elt(SEXP vec, R_xlen_t i,
+                                        R_bcstack_t* cell) {
+    int iv = 0;
+    double dv = 0;
+    int type = ostack_scalar(cell, iv, dv);
+    if (!type) {
+#ifdef TYPED_STACK
+        if (cell->tag)
+            return false;
+#endif
+        SEXP val = ostack_at_cell(cell);
+        if (!IS_SIMPLE_SCALAR(val, LGLSXP))
+            return false;
+        iv = *LOGICAL(val);
+        type = LGLSXP;
+    }
+    switch (TYPEOF(vec)) {
+    case REALSXP:
+        // NA_LOGICAL is NA_INTEGER
+        REAL(vec)[i] = type == REALSXP ? dv : iv == NA_INTEGER ? NA_REAL : iv;
+        return true;
+    case INTSXP:
+        if (type == REALSXP)
+            return false;
+        INTEGER(vec)[i] = iv;
+        return true;
+    case LGLSXP:
+        if (type != LGLSXP)
+            return false;
+        LOGICAL(vec)[i] = iv;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// x[[i]] <- val on an unshared list, NULL values remove the element and need
+// the generic code
+static RIR_INLINE bool storeListElt(SEXP vec, R_xlen_t i, SEXP val) {
+    if (val == R_NilValue)
+        return false;
+    // Avoid recursive vectors
+    if (val == vec)
+        val = Rf_shallow_duplicate(val);
+    INCREMENT_NAMED(val);
+    SET_VECTOR_ELT(vec, i, val);
+    return true;
+}
+
 static double myfloor(double x1, double x2) {
     double q = x1 / x2, tmp;
 
@@ -1143,6 +1622,8 @@ static R_INLINE int R_integer_uminus(int x, Rboolean* pnaflag) {
             flag = getFlag(prim);                                              \
         }                                                                      \
         SEXP call = getSrcForCall(c, pc - 1, ctx);                             \
+        if (isObject(val))                                                     \
+            invalidateGlobalBindings();                                        \
         SEXP argslist = CONS_NR(val, R_NilValue);                              \
         ostack_push(ctx, argslist);                                            \
         if (flag < 2)                                                          \
@@ -1150,7 +1631,7 @@ static R_INLINE int R_integer_uminus(int x, Rboolean* pnaflag) {
         res = blt(call, prim, argslist, env);                                  \
         if (flag < 2)                                                          \
             R_Visible = static_cast<Rboolean>(flag != 1);                      \
-        ostack_pop(ctx);                                                       \
+        ostack_popn(ctx, 1);                                                   \
     } while (false)
 
 #define DO_UNOP(op, op2)                                                       \
@@ -1178,7 +1659,7 @@ static R_INLINE int R_integer_uminus(int x, Rboolean* pnaflag) {
         ostack_set(ctx, 0, res);                                               \
     } while (false)
 
-#define DO_RELOP(op)                                                           \
+#define DO_RELOP(op, vop)                                                      \
     do {                                                                       \
         if (IS_SIMPLE_SCALAR(lhs, LGLSXP)) {                                   \
             if (IS_SIMPLE_SCALAR(rhs, LGLSXP)) {                               \
@@ -1229,6 +1710,11 @@ static R_INLINE int R_integer_uminus(int x, Rboolean* pnaflag) {
                 break;                                                         \
             }                                                                  \
         }                                                                      \
+        bool overflow;                                                         \
+        if ((res = vectorBinop(vop, lhs, rhs, overflow))) {                    \
+            R_Visible = (Rboolean) true;                                       \
+            break;                                                             \
+        }                                                                      \
         BINOP_FALLBACK(#op);                                                   \
     } while (false)
 
@@ -1246,53 +1732,184 @@ static SEXP seq_int(int n1, int n2) {
     return ans;
 }
 
-#define BINDING_CACHE_SIZE 5
-typedef struct {
+/*
+ * Per activation cache of binding cells, with room for all the variables the
+ * code object looks up (see Code::computeBindingCacheSize).
+ *
+ * Cells of the current frame (version 0) stay valid until the activation
+ * changes its environment, since rm leaves removed cells unbound. Bindings
+ * found further up the environment chain, in the global environment,
+ * namespaces or base, are tagged with the globalBindingVersion and thus
+ * dropped as soon as other code gets a chance to shadow or remove them.
+ * Active bindings and user databases are never cached.
+ *
+ * Keys are constant pool indices, function lookups (ldfun_) and lookups
+ * starting at the enclosing environment (ldvar_super_) are tagged, since
+ * they can find different bindings for the same symbol.
+ *
+ * The cache lives on the stack of the activation and starts out empty, also
+ * the entries of global bindings are not kept with the code object across
+ * calls. They would only be valid for frames and enclosing environments
+ * which do not shadow the binding: arguments are bound when the frame is
+ * created, without bumping globalBindingVersion, and closures created by
+ * the same function share their code but not their environment.
+ */
+#define BINDING_CACHE_PROBES 4
+#define BINDING_CACHE_FUN (1u << 31)
+#define BINDING_CACHE_SUPER (1u << 30)
+
+struct BindingCacheEntry {
+    Immediate key;
     SEXP loc;
-    Immediate idx;
-} BindingCache;
+    size_t version;
+};
+
+struct BindingCache {
+    BindingCacheEntry* entries;
+    unsigned mask;
+
+    // Returns the entry holding key, or the one to be replaced by it
+    RIR_INLINE BindingCacheEntry* slot(Immediate key) {
+        unsigned home = (key ^ (key >> 29)) & mask;
+        for (unsigned i = 0; i < BINDING_CACHE_PROBES; ++i) {
+            auto e = &entries[(home + i) & mask];
+            if (e->key == key || e->key == 0)
+                return e;
+        }
+        return &entries[home];
+    }
+
+    void clear() { memset(entries, 0, sizeof(*entries) * (mask + 1)); }
+};
+
+// Bindings in base are stored in the symbol itself
+static RIR_INLINE SEXP bindingCellValue(SEXP cell) {
+    return TYPEOF(cell) == SYMSXP ? SYMVALUE(cell) : CAR(cell);
+}
 
 static RIR_INLINE SEXP cachedGetBindingCell(SEXP env, Immediate idx,
                                             InterpreterInstance* ctx,
-                                            BindingCache* bindingCache) {
+                                            BindingCache& bindingCache) {
     if (env == R_BaseEnv || env == R_BaseNamespace)
         return NULL;
 
-    Immediate cidx = idx % BINDING_CACHE_SIZE;
-    if (bindingCache[cidx].idx == idx) {
-        return bindingCache[cidx].loc;
-    }
+    auto e = bindingCache.slot(idx);
+    if (e->key == idx && e->version == 0)
+        return e->loc;
 
     SEXP sym = cp_pool_at(ctx, idx);
     SLOWASSERT(TYPEOF(sym) == SYMSXP);
     R_varloc_t loc = R_findVarLocInFrame(env, sym);
     if (!R_VARLOC_IS_NULL(loc)) {
-        bindingCache[cidx].loc = loc.cell;
-        bindingCache[cidx].idx = idx;
+        *e = {idx, loc.cell, 0};
         return loc.cell;
     }
     return NULL;
 }
 
+// Like Rf_findVar, but remembers the binding found in the cache entry e
+static SEXP findVarAndCache(SEXP sym, SEXP env, Immediate key, bool isFrame,
+                            BindingCacheEntry* e) {
+    for (SEXP rho = env; rho != R_EmptyEnv; rho = ENCLOS(rho)) {
+        if (TYPEOF(rho) != ENVSXP || OBJECT(rho))
+            break;
+        R_varloc_t loc = R_findVarLocInFrame(rho, sym);
+        if (R_VARLOC_IS_NULL(loc))
+            continue;
+        if (IS_ACTIVE_BINDING(loc.cell))
+            break;
+        SEXP res = bindingCellValue(loc.cell);
+        if (res == R_UnboundValue)
+            break;
+        bool local = isFrame && rho == env && TYPEOF(loc.cell) != SYMSXP;
+        *e = {key, loc.cell, local ? 0 : globalBindingVersion};
+        return res;
+    }
+    return Rf_findVar(sym, env);
+}
+
 static SEXP cachedGetVar(SEXP env, Immediate idx, InterpreterInstance* ctx,
-                         BindingCache* bindingCache) {
-    SEXP loc = cachedGetBindingCell(env, idx, ctx, bindingCache);
-    if (loc) {
-        SEXP res = CAR(loc);
+                         BindingCache& bindingCache) {
+    auto e = bindingCache.slot(idx);
+    if (e->key == idx &&
+        (e->version == 0 || e->version == globalBindingVersion)) {
+        SEXP res = bindingCellValue(e->loc);
         if (res != R_UnboundValue)
             return res;
     }
     SEXP sym = cp_pool_at(ctx, idx);
     SLOWASSERT(TYPEOF(sym) == SYMSXP);
-    return Rf_findVar(sym, env);
+    return findVarAndCache(sym, env, idx, true, e);
+}
+
+// Lookup starting at the enclosing environment, as used by ldvar_super_
+static SEXP cachedGetSuperVar(SEXP env, Immediate idx, InterpreterInstance* ctx,
+                              BindingCache& bindingCache) {
+    Immediate key = idx | BINDING_CACHE_SUPER;
+    auto e = bindingCache.slot(key);
+    if (e->key == key && e->version == globalBindingVersion) {
+        SEXP res = bindingCellValue(e->loc);
+        if (res != R_UnboundValue)
+            return res;
+    }
+    SEXP sym = cp_pool_at(ctx, idx);
+    SLOWASSERT(TYPEOF(sym) == SYMSXP);
+    return findVarAndCache(sym, ENCLOS(env), key, false, e);
+}
+
+// Like Rf_findFun. Bindings to promises are cached once they are evaluated.
+static SEXP cachedGetFun(SEXP env, Immediate idx, InterpreterInstance* ctx,
+                         BindingCache& bindingCache) {
+    auto isFun = [](SEXP v) {
+        return TYPEOF(v) == CLOSXP || TYPEOF(v) == BUILTINSXP ||
+               TYPEOF(v) == SPECIALSXP;
+    };
+
+    Immediate key = idx | BINDING_CACHE_FUN;
+    auto e = bindingCache.slot(key);
+    if (e->key == key &&
+        (e->version == 0 || e->version == globalBindingVersion)) {
+        SEXP res = bindingCellValue(e->loc);
+        if (TYPEOF(res) == PROMSXP)
+            res = PRVALUE(res);
+        if (isFun(res))
+            return res;
+    }
+
+    SEXP sym = cp_pool_at(ctx, idx);
+    SLOWASSERT(TYPEOF(sym) == SYMSXP);
+    // Forcing promises might invalidate what we found so far
+    size_t version = globalBindingVersion;
+    // Skipped non-function bindings are overwritten in place by stvar_, which
+    // does not invalidate cached bindings, thus such lookups are not cached
+    bool shadowed = false;
+    for (SEXP rho = env; rho != R_EmptyEnv; rho = ENCLOS(rho)) {
+        if (TYPEOF(rho) != ENVSXP || OBJECT(rho))
+            break;
+        R_varloc_t loc = R_findVarLocInFrame(rho, sym);
+        if (R_VARLOC_IS_NULL(loc))
+            continue;
+        if (IS_ACTIVE_BINDING(loc.cell))
+            break;
+        SEXP res = bindingCellValue(loc.cell);
+        if (TYPEOF(res) == PROMSXP)
+            res = promiseValue(res, ctx);
+        if (isFun(res)) {
+            bool local = rho == env && TYPEOF(loc.cell) != SYMSXP;
+            if (!shadowed)
+                *e = {key, loc.cell, local ? 0 : version};
+            return res;
+        }
+        if (res == R_UnboundValue || res == R_MissingArg)
+            break;
+        shadowed = true;
+    }
+    // Reports errors
+    return Rf_findFun(sym, env);
 }
 
-#define ACTIVE_BINDING_MASK (1 << 15)
-#define BINDING_LOCK_MASK (1 << 14)
-#define IS_ACTIVE_BINDING(b) ((b)->sxpinfo.gp & ACTIVE_BINDING_MASK)
-#define BINDING_IS_LOCKED(b) ((b)->sxpinfo.gp & BINDING_LOCK_MASK)
 static void cachedSetVar(SEXP val, SEXP env, Immediate idx,
-                         InterpreterInstance* ctx, BindingCache* bindingCache,
+                         InterpreterInstance* ctx, BindingCache& bindingCache,
                          bool keepMissing = false) {
     SEXP loc = cachedGetBindingCell(env, idx, ctx, bindingCache);
     if (loc && !BINDING_IS_LOCKED(loc) && !IS_ACTIVE_BINDING(loc)) {
@@ -1310,8 +1927,17 @@ static void cachedSetVar(SEXP val, SEXP env, Immediate idx,
     SLOWASSERT(TYPEOF(sym) == SYMSXP);
     INCREMENT_NAMED(val);
     PROTECT(val);
+    // The new binding might shadow cached ones, also active bindings run
+    // arbitrary code
+    invalidateGlobalBindings();
     Rf_defineVar(sym, val, env);
     UNPROTECT(1);
+
+    if (env != R_BaseEnv && env != R_BaseNamespace) {
+        R_varloc_t cell = R_findVarLocInFrame(env, sym);
+        if (!R_VARLOC_IS_NULL(cell))
+            *bindingCache.slot(idx) = {idx, cell.cell, 0};
+    }
 }
 
 RIR_INLINE static void castInt(bool ceil_, Code* c, Opcode* pc,
@@ -1392,7 +2018,7 @@ RIR_INLINE static void castInt(bool ceil_, Code* c, Opcode* pc,
     }
     SEXP res = Rf_allocVector(INTSXP, 1);
     *INTEGER(res) = x;
-    ostack_pop(ctx);
+    ostack_popn(ctx, 1);
     ostack_push(ctx, res);
 }
 
@@ -1498,7 +2124,7 @@ void deoptFramesWithContext(InterpreterInstance* ctx,
         if (!innermostFrame)
             res = ostack_pop(ctx);
         assert(ostack_top() == deoptEnv);
-        ostack_pop(ctx);
+        ostack_popn(ctx, 1);
         if (!innermostFrame)
             ostack_push(ctx, res);
         code->registerInvocation();
@@ -1520,6 +2146,103 @@ void deoptFramesWithContext(InterpreterInstance* ctx,
     ostack_push(ctx, res);
 }
 
+unsigned pir::Parameter::OSR_THRESHOLD =
+    getenv("PIR_OSR_THRESHOLD") ? atoi(getenv("PIR_OSR_THRESHOLD")) : 10000;
+
+// On-stack replacement, the inverse of deoptFramesWithContext: a baseline
+// frame which keeps running around a loop continues in optimized code. The
+// continuation starts at the loop header pc, takes the operand stack of the
+// frame as arguments and runs in the environment of the frame. Continuations
+// are kept in the extra pool of the baseline body, there is at most one live
+// continuation per loop header.
+//
+// The result of the continuation is the result of the whole function. If it
+// deoptimizes, the baseline code finishes the function and returns through the
+// function context, skipping the frame we are called from. Dead continuations
+// are replaced by the next one compiled, thus running ones are protected.
+//
+// Returns nullptr if we have to stay in the baseline frame.
+static SEXP osr(Code* c, Opcode* pc, SEXP env, const CallContext* callCtxt,
+                R_bcstack_t* frameBase, InterpreterInstance* ctx) {
+    SEXP callee = callCtxt->callee;
+    if (TYPEOF(env) != ENVSXP || TYPEOF(callee) != CLOSXP ||
+        !DispatchTable::check(BODY(callee)))
+        return nullptr;
+    auto baseline = DispatchTable::unpack(BODY(callee))->baseline();
+    if (baseline->body() != c || baseline->unoptimizable || baseline->noOsr)
+        return nullptr;
+
+    size_t stackSize = R_BCNodeStackTop - frameBase;
+    ostack_box_n(ctx, stackSize);
+    // Continuations expect evaluated values on the stack
+    for (size_t i = 0; i < stackSize; ++i) {
+        SEXP v = ostack_at_cell(frameBase + i);
+        if (TYPEOF(v) == PROMSXP || v == R_MissingArg)
+            return nullptr;
+    }
+    CallContext call(c, callee, stackSize, callCtxt->ast, frameBase, nullptr,
+                     nullptr, callCtxt->callerEnv, Assumptions(), ctx);
+    addDynamicAssumptionsFromContext(call);
+    call.givenAssumptions.add(Assumption::NotTooManyArguments);
+
+    unsigned entry = pc - c->code();
+    for (unsigned i = 0; i < c->extraPoolSize; ++i) {
+        auto fun = Function::check(c->getExtraPoolEntry(i));
+        if (fun && !fun->dead && fun->signature().osrEntry == entry) {
+            // If the types on the stack changed, we stay in the baseline
+            if (!fun->signature().assumptions.subtype(call.givenAssumptions))
+                return nullptr;
+            // A builtin it relies on was redefined, compile a new one
+            if (!bindingDependenciesHold(fun)) {
+                fun->dead = true;
+                pirInvalidateModules();
+                break;
+            }
+            fun->registerInvocation();
+            PROTECT(fun->container());
+            SEXP res = evalRirCode(fun->body(), ctx, env, &call);
+            UNPROTECT(1);
+            return res;
+        }
+    }
+
+    SEXP name = CAR(callCtxt->ast);
+    if (TYPEOF(name) != SYMSXP)
+        name = R_NilValue;
+    Function* fun = ctx->continuationOptimizer(callee, call.givenAssumptions,
+                                               name, pc, stackSize);
+    if (!fun) {
+        baseline->noOsr = true;
+        return nullptr;
+    }
+    PROTECT(fun->container());
+    unsigned slot = 0;
+    for (; slot < c->extraPoolSize; ++slot) {
+        auto old = Function::check(c->getExtraPoolEntry(slot));
+        if (old && old->dead && old->signature().osrEntry == entry)
+            break;
+    }
+    if (slot < c->extraPoolSize)
+        c->setExtraPoolEntry(slot, fun->container());
+    else
+        c->addExtraPoolEntry(fun->container());
+
+    fun->registerInvocation();
+    SEXP res = evalRirCode(fun->body(), ctx, env, &call);
+    UNPROTECT(1);
+    return res;
+}
+
+// Continuations are not in the dispatch table, but in the extra pool of the
+// baseline body they belong to
+static void removeContinuation(Code* baseline, Code* funCode) {
+    for (unsigned i = 0; i < baseline->extraPoolSize; ++i) {
+        auto fun = Function::check(baseline->getExtraPoolEntry(i));
+        if (fun && fun->body() == funCode)
+            fun->dead = true;
+    }
+}
+
 SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
                  const CallContext* callCtxt, Opcode* initialPC,
                  R_bcstack_t* localsBase) {
@@ -1535,8 +2258,13 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
 
     assert(c->info.magic == CODE_MAGIC);
 
-    BindingCache bindingCache[BINDING_CACHE_SIZE];
-    memset(&bindingCache, 0, sizeof(bindingCache));
+    invalidateGlobalBindings();
+    assert(c->bindingCacheSize > 0);
+    BindingCache bindingCache;
+    bindingCache.mask = c->bindingCacheSize - 1;
+    bindingCache.entries = (BindingCacheEntry*)alloca(
+        sizeof(BindingCacheEntry) * c->bindingCacheSize);
+    bindingCache.clear();
 
     bool existingLocals = localsBase;
     if (!existingLocals) {
@@ -1559,6 +2287,13 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
     Opcode* pc = initialPC ? initialPC : c->code();
     SEXP res;
 
+    // Back-edges taken by this frame, see osr. Frames resumed inside a loop
+    // context (or after a deopt) are never replaced.
+    unsigned backedges = 0;
+    bool osrCandidate = pir::Parameter::OSR_THRESHOLD && callCtxt &&
+                        !initialPC && !existingLocals;
+    R_bcstack_t* frameBase = R_BCNodeStackTop;
+
     std::vector<LazyEnvironment*> envStubs;
 
     auto changeEnv = [&](SEXP e) {
@@ -1568,7 +2303,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             env = e;
             // We need to clear the bindings cache, when we change the
             // environment
-            memset(&bindingCache, 0, sizeof(bindingCache));
+            bindingCache.clear();
         }
     };
     R_Visible = TRUE;
@@ -1612,6 +2347,8 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             advanceImmediate();
             int contextPos = readSignedImmediate();
             advanceImmediate();
+            // Boxing allocates, thus box before popping anything
+            ostack_box_n(ctx, n + 1);
             SEXP parent = ostack_pop(ctx);
             PROTECT(parent);
             assert(TYPEOF(parent) == ENVSXP &&
@@ -1620,6 +2357,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             auto names = (Immediate*)pc;
             advanceImmediateN(n);
             bool hasMissing = false;
+            bool hasDots = false;
             for (long i = n - 1; i >= 0; --i) {
                 SEXP val = ostack_pop(ctx);
                 ENSURE_NAMED(val);
@@ -1627,6 +2365,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
                 arglist = CONS_NR(val, arglist);
                 SET_TAG(arglist, name);
                 hasMissing = hasMissing || val == R_MissingArg;
+                hasDots = hasDots || TYPEOF(val) == DOTSXP;
                 SET_MISSING(arglist, val == R_MissingArg ? 2 : 0);
             }
             res = Rf_NewEnvironment(R_NilValue, arglist, parent);
@@ -1636,25 +2375,13 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
                     cptr->cloenv = res;
                     if (cptr->promargs == symbol::delayedArglist) {
                         auto promargs = arglist;
-                        if (hasMissing) {
+                        if (hasMissing || hasDots) {
                             // For the promargs we need to strip missing
-                            // arguments from the list, otherwise nargs()
+                            // arguments and splice in ..., otherwise nargs()
                             // reports the wrong value.
-                            promargs = Rf_shallow_duplicate(arglist);
-                            // Need to test for R_MissingArg because
-                            // shallowDuplicate does not copy the missing flag.
-                            while (CAR(promargs) == R_MissingArg &&
-                                   promargs != R_NilValue) {
-                                promargs = CDR(promargs);
-                            }
-                            auto p = promargs;
-                            auto prev = p;
-                            while (p != R_NilValue) {
-                                if (CAR(p) == R_MissingArg)
-                                    SETCDR(prev, CDR(p));
-                                prev = p;
-                                p = CDR(p);
-                            }
+                            PROTECT(res);
+                            promargs = argsFromBindings(arglist);
+                            UNPROTECT(1);
                         }
                         cptr->promargs = promargs;
                     }
@@ -1676,6 +2403,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             int contextPos = readSignedImmediate();
             advanceImmediate();
             // Do we need to preserve parent and the arg vals?
+            ostack_box_n(ctx, n + 1);
             SEXP parent = ostack_pop(ctx);
             assert(TYPEOF(parent) == ENVSXP &&
                    "Non-environment used as environment parent.");
@@ -1722,9 +2450,10 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         }
 
         INSTRUCTION(ldfun_) {
-            SEXP sym = readConst(ctx, readImmediate());
+            Immediate id = readImmediate();
+            SEXP sym = readConst(ctx, id);
             advanceImmediate();
-            res = Rf_findFun(sym, env);
+            res = cachedGetFun(env, id, ctx, bindingCache);
 
             // TODO something should happen here
             if (res == R_UnboundValue)
@@ -1760,10 +2489,8 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
                     isLocal = false;
             }
 
-            if (!isLocal) {
-                SEXP sym = cp_pool_at(ctx, id);
-                res = Rf_findVar(sym, env);
-            }
+            if (!isLocal)
+                res = cachedGetVar(env, id, ctx, bindingCache);
 
             if (res == R_UnboundValue) {
                 SEXP sym = cp_pool_at(ctx, id);
@@ -1823,9 +2550,11 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
                 SEXP sym = cp_pool_at(ctx, id);
                 Rf_error("object \"%s\" not found", CHAR(PRINTNAME(sym)));
             } else if (res == R_MissingArg) {
+                // An empty ... is passed on as missing
                 SEXP sym = cp_pool_at(ctx, id);
-                Rf_error("argument \"%s\" is missing, with no default",
-                         CHAR(PRINTNAME(sym)));
+                if (sym != R_DotsSymbol)
+                    Rf_error("argument \"%s\" is missing, with no default",
+                             CHAR(PRINTNAME(sym)));
             }
 
             if (res != R_NilValue)
@@ -1836,9 +2565,10 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         }
 
         INSTRUCTION(ldvar_super_) {
-            SEXP sym = readConst(ctx, readImmediate());
+            Immediate id = readImmediate();
+            SEXP sym = readConst(ctx, id);
             advanceImmediate();
-            res = Rf_findVar(sym, ENCLOS(env));
+            res = cachedGetSuperVar(env, id, ctx, bindingCache);
 
             if (res == R_UnboundValue) {
                 Rf_error("object \"%s\" not found", CHAR(PRINTNAME(sym)));
@@ -1859,9 +2589,10 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         }
 
         INSTRUCTION(ldvar_noforce_super_) {
-            SEXP sym = readConst(ctx, readImmediate());
+            Immediate id = readImmediate();
+            SEXP sym = readConst(ctx, id);
             advanceImmediate();
-            res = Rf_findVar(sym, ENCLOS(env));
+            res = cachedGetSuperVar(env, id, ctx, bindingCache);
 
             if (res == R_UnboundValue) {
                 Rf_error("object \"%s\" not found", CHAR(PRINTNAME(sym)));
@@ -1919,11 +2650,61 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             NEXT();
         }
 
+        INSTRUCTION(ldarg_dots_) {
+            Immediate first = readImmediate();
+            advanceImmediate();
+            assert(callCtxt);
+
+            res = R_MissingArg;
+            if (first < callCtxt->suppliedArgs) {
+                res = R_NilValue;
+                for (size_t i = callCtxt->suppliedArgs; i > first; --i) {
+                    PROTECT(res);
+                    SEXP arg;
+                    if (callCtxt->hasStackArgs())
+                        arg = callCtxt->stackArg(i - 1);
+                    else if (callCtxt->missingArg(i - 1))
+                        arg = R_MissingArg;
+                    else
+                        arg = createPromise(callCtxt->implicitArg(i - 1),
+                                            callCtxt->callerEnv);
+                    PROTECT(arg);
+                    res = CONS_NR(arg, res);
+                    UNPROTECT(2);
+                    if (callCtxt->hasNames())
+                        SET_TAG(res, callCtxt->name(i - 1, ctx));
+                }
+                SET_TYPEOF(res, DOTSXP);
+            }
+            ostack_push(ctx, res);
+            NEXT();
+        }
+
+        INSTRUCTION(mk_dots_) {
+            Immediate n = readImmediate();
+            advanceImmediate();
+            ostack_box_n(ctx, n);
+            res = R_MissingArg;
+            if (n > 0) {
+                res = R_NilValue;
+                for (size_t i = 0; i < n; ++i) {
+                    PROTECT(res);
+                    SEXP val = ostack_at(ctx, i);
+                    ENSURE_NAMED(val);
+                    res = CONS_NR(val, res);
+                    UNPROTECT(1);
+                }
+                SET_TYPEOF(res, DOTSXP);
+            }
+            ostack_popn(ctx, n);
+            ostack_push(ctx, res);
+            NEXT();
+        }
+
         INSTRUCTION(ldloc_) {
             Immediate offset = readImmediate();
             advanceImmediate();
-            res = locals.load(offset);
-            ostack_push(ctx, res);
+            ostack_push_cell(ctx, locals.load(offset));
             NEXT();
         }
 
@@ -1957,6 +2738,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             SLOWASSERT(TYPEOF(sym) == SYMSXP);
             SEXP val = ostack_pop(ctx);
             INCREMENT_NAMED(val);
+            invalidateGlobalBindings();
             Rf_setVar(sym, val, ENCLOS(env));
             NEXT();
         }
@@ -1964,8 +2746,8 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         INSTRUCTION(stloc_) {
             Immediate offset = readImmediate();
             advanceImmediate();
-            locals.store(offset, ostack_top(ctx));
-            ostack_pop(ctx);
+            locals.store(offset, ostack_cell_at(ctx, 0));
+            ostack_popn(ctx, 1);
             NEXT();
         }
 
@@ -1992,14 +2774,17 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             advanceImmediate();
             Assumptions given(pc);
             pc += sizeof(Assumptions);
+            Opcode* cache = pc;
+            advanceImmediate();
             auto arguments = (Immediate*)pc;
             advanceImmediateN(n);
             auto names = (Immediate*)pc;
             advanceImmediateN(n);
             CallContext call(c, ostack_top(ctx), n, ast, arguments, names, env,
                              given, ctx);
+            call.cache = callSiteCache(c, cache, call.callee);
             res = doCall(call, ctx);
-            ostack_pop(ctx); // callee
+            ostack_popn(ctx, 1); // callee
             ostack_push(ctx, res);
 
             SLOWASSERT(ttt == R_PPStackTop);
@@ -2018,7 +2803,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         INSTRUCTION(record_type_) {
             ObservedValues* feedback = (ObservedValues*)pc;
             SEXP t = ostack_top(ctx);
-            feedback->record(t);
+            feedback->record(c, t);
             pc += sizeof(ObservedValues);
             NEXT();
         }
@@ -2037,12 +2822,15 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             advanceImmediate();
             Assumptions given(pc);
             pc += sizeof(Assumptions);
+            Opcode* cache = pc;
+            advanceImmediate();
             auto arguments = (Immediate*)pc;
             advanceImmediateN(n);
             CallContext call(c, ostack_top(ctx), n, ast, arguments, env, given,
                              ctx);
+            call.cache = callSiteCache(c, cache, call.callee);
             res = doCall(call, ctx);
-            ostack_pop(ctx); // callee
+            ostack_popn(ctx, 1); // callee
             ostack_push(ctx, res);
 
             SLOWASSERT(ttt == R_PPStackTop);
@@ -2063,8 +2851,12 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             advanceImmediate();
             Assumptions given(pc);
             pc += sizeof(Assumptions);
+            Opcode* cache = pc;
+            advanceImmediate();
+            ostack_box_n(ctx, n);
             CallContext call(c, ostack_at(ctx, n), n, ast,
                              ostack_cell_at(ctx, n - 1), env, given, ctx);
+            call.cache = callSiteCache(c, cache, call.callee);
             res = doCall(call, ctx);
             ostack_popn(ctx, call.passedArgs + 1);
             ostack_push(ctx, res);
@@ -2087,17 +2879,55 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             advanceImmediate();
             Assumptions given(pc);
             pc += sizeof(Assumptions);
+            Opcode* cache = pc;
+            advanceImmediate();
             auto names = (Immediate*)pc;
             advanceImmediateN(n);
-            CallContext call(c, ostack_at(ctx, n), n, ast,
-                             ostack_cell_at(ctx, n - 1), names, env, given,
-                             ctx);
-            res = doCall(call, ctx);
-            ostack_popn(ctx, call.passedArgs + 1);
+            ostack_box_n(ctx, n);
+
+            // Arguments named `...` are lists to be spliced in. The expanded
+            // arguments are pushed on top of the original ones, see
+            // rirCallWithDots for the assumptions and the cache.
+            static Immediate dotsIdx = Pool::insert(R_DotsSymbol);
+            bool hasDots = false;
+            for (size_t i = 0; i < n; ++i)
+                if (names[i] == dotsIdx)
+                    hasDots = true;
+            if (hasDots) {
+                std::vector<Immediate> expandedNames;
+                bool hasNames = false;
+                size_t expanded = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    SEXP arg = ostack_at(ctx, n - 1 + expanded - i);
+                    if (names[i] == dotsIdx) {
+                        expanded +=
+                            pushDotsArgs(arg, expandedNames, hasNames, ctx);
+                        continue;
+                    }
+                    ostack_push(ctx, arg);
+                    if (cp_pool_at(ctx, names[i]) != R_NilValue)
+                        hasNames = true;
+                    expandedNames.push_back(names[i]);
+                    expanded++;
+                }
+                CallContext call(c, ostack_at(ctx, n + expanded), expanded,
+                                 ast, ostack_cell_at(ctx, expanded - 1),
+                                 hasNames ? expandedNames.data() : nullptr,
+                                 env, Assumptions(), ctx);
+                res = doCall(call, ctx);
+                ostack_popn(ctx, call.passedArgs + n + 1);
+            } else {
+                CallContext call(c, ostack_at(ctx, n), n, ast,
+                                 ostack_cell_at(ctx, n - 1), names, env, given,
+                                 ctx);
+                call.cache = callSiteCache(c, cache, call.callee);
+                res = doCall(call, ctx);
+                ostack_popn(ctx, call.passedArgs + 1);
+            }
             ostack_push(ctx, res);
 
             SLOWASSERT(ttt == R_PPStackTop);
-            SLOWASSERT(lll - call.suppliedArgs == (unsigned)ostack_length(ctx));
+            SLOWASSERT(lll - n == (unsigned)ostack_length(ctx));
             NEXT();
         }
 
@@ -2114,6 +2944,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             advanceImmediate();
             SEXP callee = cp_pool_at(ctx, readImmediate());
             advanceImmediate();
+            ostack_box_n(ctx, n);
             CallContext call(c, callee, n, ast, ostack_cell_at(ctx, n - 1), env,
                              Assumptions(), ctx);
             res = builtinCall(call, ctx);
@@ -2139,15 +2970,24 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             advanceImmediate();
             Assumptions given(pc);
             pc += sizeof(Assumptions);
-            SEXP callee = cp_pool_at(ctx, readImmediate());
+            SEXP callee = c->getExtraPoolEntry(readImmediate());
             advanceImmediate();
-            SEXP version = cp_pool_at(ctx, readImmediate());
+            // The inline cache holds the version last called. Versions which
+            // were removed from the dispatch table are dead and released
+            // here, on the next call.
+            Immediate cache = readImmediate();
+            advanceImmediate();
+            SEXP version = c->getExtraPoolEntry(cache);
+            ostack_box_n(ctx, n);
             CallContext call(c, callee, n, ast, ostack_cell_at(ctx, n - 1), env,
                              given, ctx);
-            auto fun = Function::unpack(version);
+            auto fun = version == R_NilValue ? nullptr
+                                             : Function::unpack(version);
             addDynamicAssumptionsFromContext(call);
-            bool dispatchFail = !fun->dead && !matches(call, fun->signature());
-            if (fun->invocationCount() % pir::Parameter::RIR_WARMUP == 0) {
+            bool dispatchFail =
+                !fun || fun->dead || !matches(call, fun->signature());
+            if (!dispatchFail &&
+                fun->invocationCount() % pir::Parameter::RIR_WARMUP == 0) {
                 Assumptions assumptions =
                     addDynamicAssumptionsForOneTarget(call, fun->signature());
                 if (assumptions != fun->signature().assumptions)
@@ -2155,13 +2995,16 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
                     dispatchFail = true;
             }
 
-            if (dispatchFail) {
-                auto dt = DispatchTable::unpack(BODY(callee));
+            auto dt = DispatchTable::unpack(BODY(callee));
+            if (dispatchFail)
+                fun = dispatch(call, dt);
+            while (!bindingDependenciesHold(fun)) {
+                dt->remove(fun->body());
+                pirInvalidateModules();
                 fun = dispatch(call, dt);
-                // Patch inline cache
-                (*(Immediate*)pc) = Pool::insert(fun->container());
             }
-            advanceImmediate();
+            if (fun->container() != version)
+                c->setExtraPoolEntry(cache, fun->container());
 
             if (fun->signature().envCreation ==
                 FunctionSignature::Environment::CallerProvided) {
@@ -2250,18 +3093,18 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         }
 
         INSTRUCTION(dup_) {
-            ostack_push(ctx, ostack_top(ctx));
+            ostack_push_cell(ctx, ostack_cell_at(ctx, 0));
             NEXT();
         }
 
         INSTRUCTION(dup2_) {
-            ostack_push(ctx, ostack_at(ctx, 1));
-            ostack_push(ctx, ostack_at(ctx, 1));
+            ostack_push_cell(ctx, ostack_cell_at(ctx, 1));
+            ostack_push_cell(ctx, ostack_cell_at(ctx, 1));
             NEXT();
         }
 
         INSTRUCTION(pop_) {
-            ostack_pop(ctx);
+            ostack_popn(ctx, 1);
             NEXT();
         }
 
@@ -2273,10 +3116,9 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         }
 
         INSTRUCTION(swap_) {
-            SEXP lhs = ostack_pop(ctx);
-            SEXP rhs = ostack_pop(ctx);
-            ostack_push(ctx, lhs);
-            ostack_push(ctx, rhs);
+            R_bcstack_t lhs = *ostack_cell_at(ctx, 0);
+            *ostack_cell_at(ctx, 0) = *ostack_cell_at(ctx, 1);
+            *ostack_cell_at(ctx, 1) = lhs;
             NEXT();
         }
 
@@ -2284,21 +3126,13 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             Immediate i = readImmediate();
             advanceImmediate();
             R_bcstack_t* pos = ostack_cell_at(ctx, 0);
-#ifdef TYPED_STACK
-            SEXP val = pos->u.sxpval;
-            while (i--) {
-                pos->u.sxpval = (pos - 1)->u.sxpval;
-                pos--;
-            }
-            pos->u.sxpval = val;
-#else
-            SEXP val = *pos;
+            // Move whole cells, to keep unboxed values unboxed
+            R_bcstack_t val = *pos;
             while (i--) {
                 *pos = *(pos - 1);
                 pos--;
             }
             *pos = val;
-#endif
             NEXT();
         }
 
@@ -2306,36 +3140,28 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             Immediate i = readImmediate();
             advanceImmediate();
             R_bcstack_t* pos = ostack_cell_at(ctx, i);
-#ifdef TYPED_STACK
-            SEXP val = pos->u.sxpval;
-            while (i--) {
-                pos->u.sxpval = (pos + 1)->u.sxpval;
-                pos++;
-            }
-            pos->u.sxpval = val;
-#else
-            SEXP val = *pos;
+            // Move whole cells, to keep unboxed values unboxed
+            R_bcstack_t val = *pos;
             while (i--) {
                 *pos = *(pos + 1);
                 pos++;
             }
             *pos = val;
-#endif
             NEXT();
         }
 
         INSTRUCTION(pull_) {
             Immediate i = readImmediate();
             advanceImmediate();
-            SEXP val = ostack_at(ctx, i);
-            ostack_push(ctx, val);
+            ostack_push_cell(ctx, ostack_cell_at(ctx, i));
             NEXT();
         }
 
         INSTRUCTION(add_) {
+            DO_UNBOXED_BINOP(+, PLUSOP);
             SEXP lhs = ostack_at(ctx, 1);
             SEXP rhs = ostack_at(ctx, 0);
-            DO_BINOP(+, PLUSOP);
+            DO_BINOP(+, PLUSOP, VectorOp::Add);
             NEXT();
         }
 
@@ -2346,11 +3172,25 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         }
 
         INSTRUCTION(inc_) {
+#ifdef TYPED_STACK
+            R_bcstack_t* cell = ostack_cell_at(ctx, 0);
+            if (cell->tag == INTSXP) {
+                cell->u.ival++;
+                NEXT();
+            }
+            SLOWASSERT(TYPEOF(cell->u.sxpval) == INTSXP);
+            if (MAYBE_REFERENCED(cell->u.sxpval)) {
+                int i = INTEGER(cell->u.sxpval)[0];
+                cell->u.ival = i + 1;
+                cell->tag = INTSXP;
+                NEXT();
+            }
+#endif
             SEXP val = ostack_top(ctx);
             SLOWASSERT(TYPEOF(val) == INTSXP);
             if (MAYBE_REFERENCED(val)) {
                 int i = INTEGER(val)[0];
-                ostack_pop(ctx);
+                ostack_popn(ctx, 1);
                 SEXP n = Rf_allocVector(INTSXP, 1);
                 INTEGER(n)[0] = i + 1;
                 ostack_push(ctx, n);
@@ -2361,11 +3201,25 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         }
 
         INSTRUCTION(dec_) {
+#ifdef TYPED_STACK
+            R_bcstack_t* cell = ostack_cell_at(ctx, 0);
+            if (cell->tag == INTSXP) {
+                cell->u.ival--;
+                NEXT();
+            }
+            SLOWASSERT(TYPEOF(cell->u.sxpval) == INTSXP);
+            if (MAYBE_REFERENCED(cell->u.sxpval)) {
+                int i = INTEGER(cell->u.sxpval)[0];
+                cell->u.ival = i - 1;
+                cell->tag = INTSXP;
+                NEXT();
+            }
+#endif
             SEXP val = ostack_top(ctx);
             SLOWASSERT(TYPEOF(val) == INTSXP);
             if (MAYBE_REFERENCED(val)) {
                 int i = INTEGER(val)[0];
-                ostack_pop(ctx);
+                ostack_popn(ctx, 1);
                 SEXP n = Rf_allocVector(INTSXP, 1);
                 INTEGER(n)[0] = i - 1;
                 ostack_push(ctx, n);
@@ -2376,9 +3230,10 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         }
 
         INSTRUCTION(sub_) {
+            DO_UNBOXED_BINOP(-, MINUSOP);
             SEXP lhs = ostack_at(ctx, 1);
             SEXP rhs = ostack_at(ctx, 0);
-            DO_BINOP(-, MINUSOP);
+            DO_BINOP(-, MINUSOP, VectorOp::Sub);
             NEXT();
         }
 
@@ -2389,9 +3244,10 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         }
 
         INSTRUCTION(mul_) {
+            DO_UNBOXED_BINOP(*, TIMESOP);
             SEXP lhs = ostack_at(ctx, 1);
             SEXP rhs = ostack_at(ctx, 0);
-            DO_BINOP(*, TIMESOP);
+            DO_BINOP(*, TIMESOP, VectorOp::Mul);
             NEXT();
         }
 
@@ -2435,7 +3291,12 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
                     real_res = (double)l / (double)r;
                 STORE_BINOP(REALSXP, 0, real_res);
             } else {
-                BINOP_FALLBACK("/");
+                bool overflow;
+                res = vectorBinop(VectorOp::Div, lhs, rhs, overflow);
+                if (res)
+                    R_Visible = (Rboolean) true;
+                else
+                    BINOP_FALLBACK("/");
                 ostack_popn(ctx, 2);
                 ostack_push(ctx, res);
             }
@@ -2525,53 +3386,59 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         }
 
         INSTRUCTION(lt_) {
+            DO_UNBOXED_RELOP(<);
             SEXP lhs = ostack_at(ctx, 1);
             SEXP rhs = ostack_at(ctx, 0);
-            DO_RELOP(<);
+            DO_RELOP(<, VectorOp::Lt);
             ostack_popn(ctx, 2);
             ostack_push(ctx, res);
             NEXT();
         }
 
         INSTRUCTION(gt_) {
+            DO_UNBOXED_RELOP(>);
             SEXP lhs = ostack_at(ctx, 1);
             SEXP rhs = ostack_at(ctx, 0);
-            DO_RELOP(>);
+            DO_RELOP(>, VectorOp::Gt);
             ostack_popn(ctx, 2);
             ostack_push(ctx, res);
             NEXT();
         }
 
         INSTRUCTION(le_) {
+            DO_UNBOXED_RELOP(<=);
             SEXP lhs = ostack_at(ctx, 1);
             SEXP rhs = ostack_at(ctx, 0);
-            DO_RELOP(<=);
+            DO_RELOP(<=, VectorOp::Le);
             ostack_popn(ctx, 2);
             ostack_push(ctx, res);
             NEXT();
         }
 
         INSTRUCTION(ge_) {
+            DO_UNBOXED_RELOP(>=);
             SEXP lhs = ostack_at(ctx, 1);
             SEXP rhs = ostack_at(ctx, 0);
-            DO_RELOP(>=);
+            DO_RELOP(>=, VectorOp::Ge);
             ostack_popn(ctx, 2);
             ostack_push(ctx, res);
             NEXT();
         }
 
         INSTRUCTION(eq_) {
+            DO_UNBOXED_RELOP(==);
             SEXP lhs = ostack_at(ctx, 1);
             SEXP rhs = ostack_at(ctx, 0);
-            DO_RELOP(==);
+            DO_RELOP(==, VectorOp::Eq);
             ostack_popn(ctx, 2);
             ostack_push(ctx, res);
             NEXT();
         }
 
         INSTRUCTION(identical_noforce_) {
-            SEXP rhs = ostack_pop(ctx);
-            SEXP lhs = ostack_pop(ctx);
+            SEXP rhs = ostack_at(ctx, 0);
+            SEXP lhs = ostack_at(ctx, 1);
+            ostack_popn(ctx, 2);
             // This instruction does not force, but we should still compare
             // the actual promise value if it is already forced.
             // Especially important since all the inlined functions are probably
@@ -2595,9 +3462,10 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
 
         INSTRUCTION(ne_) {
             assert(R_PPStackTop >= 0);
+            DO_UNBOXED_RELOP(!=);
             SEXP lhs = ostack_at(ctx, 1);
             SEXP rhs = ostack_at(ctx, 0);
-            DO_RELOP(!=);
+            DO_RELOP(!=, VectorOp::Ne);
             ostack_popn(ctx, 2);
             ostack_push(ctx, res);
             NEXT();
@@ -2674,7 +3542,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             int x1 = Rf_asLogical(val);
             assert(x1 == 1 || x1 == 0 || x1 == NA_LOGICAL);
             res = Rf_ScalarLogical(x1);
-            ostack_pop(ctx);
+            ostack_popn(ctx, 1);
             ostack_push(ctx, res);
             NEXT();
         }
@@ -2712,7 +3580,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
                 Rf_errorcall(getSrcAt(c, pc - 1, ctx), msg);
             }
 
-            ostack_pop(ctx);
+            ostack_popn(ctx, 1);
             ostack_push(ctx, cond ? R_TrueValue : R_FalseValue);
             NEXT();
         }
@@ -2751,6 +3619,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             case NILSXP:
             case LGLSXP:
             case REALSXP:
+            case CLOSXP:
                 res = TYPEOF(val) == i;
                 break;
 
@@ -2877,11 +3746,27 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             checkUserInterrupt();
             pc += offset;
             PC_BOUNDSCHECK(pc, c);
+            if (offset < 0 && osrCandidate &&
+                ++backedges == pir::Parameter::OSR_THRESHOLD) {
+                osrCandidate = false;
+                res = osr(c, pc, env, callCtxt, frameBase, ctx);
+                if (res) {
+                    ostack_popn(ctx, R_BCNodeStackTop - frameBase);
+                    ostack_push(ctx, res);
+                    goto eval_done;
+                }
+            }
             NEXT();
         }
 
         INSTRUCTION(extract1_1_) {
             SEXP val = ostack_at(ctx, 1);
+            R_xlen_t i;
+            if (isNumOrLgl(val) && ATTRIB(val) == R_NilValue &&
+                ostack_index(ostack_cell_at(ctx, 0), XLENGTH(val), i)) {
+                ostack_replace_elt(val, i, 2);
+                NEXT();
+            }
             SEXP idx = ostack_at(ctx, 0);
 
             SEXP args = CONS_NR(val, CONS_NR(idx, R_NilValue));
@@ -2905,6 +3790,12 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
 
         INSTRUCTION(extract1_2_) {
             SEXP val = ostack_at(ctx, 2);
+            R_xlen_t i;
+            if (ostack_matrix_index(plainMatrixDim(val), ostack_cell_at(ctx, 1),
+                                    ostack_cell_at(ctx, 0), i)) {
+                ostack_replace_elt(val, i, 3);
+                NEXT();
+            }
             SEXP idx = ostack_at(ctx, 1);
             SEXP idx2 = ostack_at(ctx, 0);
 
@@ -2929,73 +3820,22 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
 
         INSTRUCTION(extract2_1_) {
             SEXP val = ostack_at(ctx, 1);
-            SEXP idx = ostack_at(ctx, 0);
-            int i = -1;
-
-            if (ATTRIB(val) != R_NilValue || ATTRIB(idx) != R_NilValue)
-                goto fallback;
-
-            switch (TYPEOF(idx)) {
-            case REALSXP:
-                if (STDVEC_LENGTH(idx) != 1 || *REAL(idx) == NA_REAL)
-                    goto fallback;
-                i = (int)*REAL(idx) - 1;
-                break;
-            case INTSXP:
-                if (STDVEC_LENGTH(idx) != 1 || *INTEGER(idx) == NA_INTEGER)
-                    goto fallback;
-                i = *INTEGER(idx) - 1;
-                break;
-            case LGLSXP:
-                if (STDVEC_LENGTH(idx) != 1 || *LOGICAL(idx) == NA_LOGICAL)
-                    goto fallback;
-                i = (int)*LOGICAL(idx) - 1;
-                break;
-            default:
-                goto fallback;
-            }
-
-            if (i >= XLENGTH(val) || i < 0)
-                goto fallback;
-
-            switch (TYPEOF(val)) {
-
-#define SIMPLECASE(vectype, vecaccess)                                         \
-    case vectype: {                                                            \
-        if (XLENGTH(val) == 1 && NO_REFERENCES(val)) {                         \
-            res = val;                                                         \
-        } else if (XLENGTH(idx) == 1 && NO_REFERENCES(idx)) {                  \
-            TYPEOF(idx) = vectype;                                             \
-            res = idx;                                                         \
-            vecaccess(res)[0] = vecaccess(val)[i];                             \
-        } else {                                                               \
-            res = Rf_allocVector(vectype, 1);                                  \
-            vecaccess(res)[0] = vecaccess(val)[i];                             \
-        }                                                                      \
-        break;                                                                 \
-    }
-
-                SIMPLECASE(REALSXP, REAL);
-                SIMPLECASE(INTSXP, INTEGER);
-                SIMPLECASE(LGLSXP, LOGICAL);
-#undef SIMPLECASE
-
-            case VECSXP: {
-                res = VECTOR_ELT(val, i);
-                break;
-            }
-
-            default:
-                goto fallback;
+            R_xlen_t i;
+            if ((isNumOrLgl(val) || TYPEOF(val) == VECSXP) &&
+                ATTRIB(val) == R_NilValue &&
+                ostack_index(ostack_cell_at(ctx, 0), XLENGTH(val), i)) {
+                if (TYPEOF(val) == VECSXP) {
+                    res = VECTOR_ELT(val, i);
+                    ostack_popn(ctx, 2);
+                    ostack_push(ctx, res);
+                    R_Visible = (Rboolean) true;
+                } else {
+                    ostack_replace_elt(val, i, 2);
+                }
+                NEXT();
             }
+            SEXP idx = ostack_at(ctx, 0);
 
-            ostack_popn(ctx, 2);
-            ostack_push(ctx, res);
-            R_Visible = (Rboolean) true;
-            NEXT();
-
-        // ---------
-        fallback : {
             SEXP args = CONS_NR(val, CONS_NR(idx, R_NilValue));
             ostack_push(ctx, args);
             if (isObject(val)) {
@@ -3014,10 +3854,15 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             ostack_push(ctx, res);
             NEXT();
         }
-        }
 
         INSTRUCTION(extract2_2_) {
             SEXP val = ostack_at(ctx, 2);
+            R_xlen_t i;
+            if (ostack_matrix_index(plainMatrixDim(val), ostack_cell_at(ctx, 1),
+                                    ostack_cell_at(ctx, 0), i)) {
+                ostack_replace_elt(val, i, 3);
+                NEXT();
+            }
             SEXP idx = ostack_at(ctx, 1);
             SEXP idx2 = ostack_at(ctx, 0);
 
@@ -3042,8 +3887,20 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         }
 
         INSTRUCTION(subassign1_1_) {
-            SEXP idx = ostack_at(ctx, 0);
             SEXP vec = ostack_at(ctx, 1);
+            R_xlen_t i;
+
+            // Fast case: a scalar stored into an unshared vector, in place and
+            // without argument list and context
+            if (NOT_SHARED(vec) && isNumOrLgl(vec) && !OBJECT(vec) &&
+                ostack_index(ostack_cell_at(ctx, 0), XLENGTH(vec), i) &&
+                ostack_store_elt(vec, i, ostack_cell_at(ctx, 2))) {
+                ostack_popn(ctx, 3);
+                ostack_push(ctx, vec);
+                NEXT();
+            }
+
+            SEXP idx = ostack_at(ctx, 0);
             SEXP val = ostack_at(ctx, 2);
 
             // Destructively modifies TOS, even if the refcount is 1. This is
@@ -3082,9 +3939,21 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         }
 
         INSTRUCTION(subassign1_2_) {
+            SEXP mtx = ostack_at(ctx, 2);
+            R_xlen_t i;
+
+            // Fast case, see subassign1_1_
+            if (NOT_SHARED(mtx) && isNumOrLgl(mtx) && !OBJECT(mtx) &&
+                ostack_matrix_index(matrixDim(mtx), ostack_cell_at(ctx, 1),
+                                    ostack_cell_at(ctx, 0), i) &&
+                ostack_store_elt(mtx, i, ostack_cell_at(ctx, 3))) {
+                ostack_popn(ctx, 4);
+                ostack_push(ctx, mtx);
+                NEXT();
+            }
+
             SEXP idx2 = ostack_at(ctx, 0);
             SEXP idx1 = ostack_at(ctx, 1);
-            SEXP mtx = ostack_at(ctx, 2);
             SEXP val = ostack_at(ctx, 3);
 
             // Destructively modifies TOS, even if the refcount is 1. This is
@@ -3125,65 +3994,24 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         }
 
         INSTRUCTION(subassign2_1_) {
-            SEXP idx = ostack_at(ctx, 0);
             SEXP vec = ostack_at(ctx, 1);
-            SEXP val = ostack_at(ctx, 2);
-
-            // Fast case
-            if (NOT_SHARED(vec) && !isObject(vec)) {
-                SEXPTYPE vectorT = TYPEOF(vec);
-                SEXPTYPE valT = TYPEOF(val);
-                SEXPTYPE idxT = TYPEOF(idx);
-
-                // Fast case only if
-                // 1. index is numerical and scalar
-                // 2. vector is real and shape of value fits into real
-                //      or vector is int and shape of value is int
-                //      or vector is generic
-                // 3. value fits into one cell of the vector
-                if ((idxT == INTSXP || idxT == REALSXP) &&
-                    (XLENGTH(idx) == 1) && // 1
-                    ((vectorT == REALSXP &&
-                      (valT == REALSXP || valT == INTSXP)) || // 2
-                     (vectorT == INTSXP && (valT == INTSXP)) ||
-                     (vectorT == VECSXP)) &&
-                    (XLENGTH(val) == 1 || vectorT == VECSXP)) { // 3
-
-                    int idx_ = -1;
-
-                    if (idxT == REALSXP) {
-                        if (*REAL(idx) != NA_REAL)
-                            idx_ = (int)*REAL(idx) - 1;
-                    } else {
-                        if (*INTEGER(idx) != NA_INTEGER)
-                            idx_ = *INTEGER(idx) - 1;
-                    }
-
-                    if (idx_ >= 0 && idx_ < XLENGTH(vec)) {
-                        switch (vectorT) {
-                        case REALSXP:
-                            REAL(vec)
-                            [idx_] = valT == REALSXP ? *REAL(val)
-                                                     : (double)*INTEGER(val);
-                            break;
-                        case INTSXP:
-                            INTEGER(vec)[idx_] = *INTEGER(val);
-                            break;
-                        case VECSXP:
-                            // Avoid recursive vectors
-                            if (val == vec)
-                                val = Rf_shallow_duplicate(val);
-                            SET_VECTOR_ELT(vec, idx_, val);
-                            break;
-                        }
-                        ostack_popn(ctx, 3);
-
-                        ostack_push(ctx, vec);
-                        NEXT();
-                    }
-                }
+            R_xlen_t i;
+
+            // Fast case, see subassign1_1_
+            if (NOT_SHARED(vec) && !OBJECT(vec) &&
+                (isNumOrLgl(vec) || TYPEOF(vec) == VECSXP) &&
+                ostack_index(ostack_cell_at(ctx, 0), XLENGTH(vec), i) &&
+                (TYPEOF(vec) == VECSXP
+                     ? storeListElt(vec, i, ostack_at(ctx, 2))
+                     : ostack_store_elt(vec, i, ostack_cell_at(ctx, 2)))) {
+                ostack_popn(ctx, 3);
+                ostack_push(ctx, vec);
+                NEXT();
             }
 
+            SEXP idx = ostack_at(ctx, 0);
+            SEXP val = ostack_at(ctx, 2);
+
             // Destructively modifies TOS, even if the refcount is 1. This is
             // intended, to avoid copying. Care need to be taken if `vec` is
             // used multiple times as a temporary.
@@ -3223,81 +4051,26 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         }
 
         INSTRUCTION(subassign2_2_) {
+            SEXP mtx = ostack_at(ctx, 2);
+            R_xlen_t i;
+
+            // Fast case, see subassign1_1_
+            if (NOT_SHARED(mtx) && !OBJECT(mtx) &&
+                (isNumOrLgl(mtx) || TYPEOF(mtx) == VECSXP) &&
+                ostack_matrix_index(matrixDim(mtx), ostack_cell_at(ctx, 1),
+                                    ostack_cell_at(ctx, 0), i) &&
+                (TYPEOF(mtx) == VECSXP
+                     ? storeListElt(mtx, i, ostack_at(ctx, 3))
+                     : ostack_store_elt(mtx, i, ostack_cell_at(ctx, 3)))) {
+                ostack_popn(ctx, 4);
+                ostack_push(ctx, mtx);
+                NEXT();
+            }
+
             SEXP idx2 = ostack_at(ctx, 0);
             SEXP idx1 = ostack_at(ctx, 1);
-            SEXP mtx = ostack_at(ctx, 2);
             SEXP val = ostack_at(ctx, 3);
 
-            // Fast case
-            if (NOT_SHARED(mtx) && !isObject(mtx)) {
-                SEXPTYPE matrixT = TYPEOF(mtx);
-                SEXPTYPE valT = TYPEOF(val);
-                SEXPTYPE idx1T = TYPEOF(idx1);
-                SEXPTYPE idx2T = TYPEOF(idx2);
-
-                // Fast case only if
-                // 1. index is numerical and scalar
-                // 2. matrix is real and shape of value fits into real
-                //      or matrix is int and shape of value is int
-                //      or matrix is generic
-                // 3. value fits into one cell of the matrix
-                if ((idx1T == INTSXP || idx1T == REALSXP) &&
-                    (XLENGTH(idx1) == 1) && // 1
-                    (idx2T == INTSXP || idx2T == REALSXP) &&
-                    (XLENGTH(idx2) == 1) &&
-                    ((matrixT == REALSXP &&
-                      (valT == REALSXP || valT == INTSXP)) || // 2
-                     (matrixT == INTSXP && (valT == INTSXP)) ||
-                     (matrixT == VECSXP)) &&
-                    (XLENGTH(val) == 1 || matrixT == VECSXP)) { // 3
-
-                    int idx1_ = -1;
-                    int idx2_ = -1;
-
-                    if (idx1T == REALSXP) {
-                        if (*REAL(idx1) != NA_REAL)
-                            idx1_ = (int)*REAL(idx1) - 1;
-                    } else {
-                        if (*INTEGER(idx1) != NA_INTEGER)
-                            idx1_ = *INTEGER(idx1) - 1;
-                    }
-
-                    if (idx2T == REALSXP) {
-                        if (*REAL(idx2) != NA_REAL)
-                            idx2_ = (int)*REAL(idx1) - 1;
-                    } else {
-                        if (*INTEGER(idx2) != NA_INTEGER)
-                            idx2_ = *INTEGER(idx2) - 1;
-                    }
-
-                    if (idx1_ >= 0 && idx1_ < Rf_ncols(mtx) && idx2_ >= 0 &&
-                        idx2_ < Rf_nrows(mtx)) {
-                        int idx_ = idx1_ + (idx2_ * Rf_nrows(mtx));
-                        SEXPTYPE mtxT = TYPEOF(mtx);
-                        switch (mtxT) {
-                        case REALSXP:
-                            REAL(mtx)
-                            [idx_] = valT == REALSXP ? *REAL(val)
-                                                     : (double)*INTEGER(val);
-                            break;
-                        case INTSXP:
-                            INTEGER(mtx)[idx_] = *INTEGER(val);
-                            break;
-                        case VECSXP:
-                            // Avoid recursive vectors
-                            if (val == mtx)
-                                val = Rf_shallow_duplicate(val);
-                            SET_VECTOR_ELT(mtx, idx_, val);
-                            break;
-                        }
-                        ostack_popn(ctx, 4);
-
-                        ostack_push(ctx, mtx);
-                        NEXT();
-                    }
-                }
-            }
-
             // Destructively modifies TOS, even if the refcount is 1. This is
             // intended, to avoid copying. Care need to be taken if `vec` is
             // used multiple times as a temporary.
@@ -3337,14 +4110,18 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         }
 
         INSTRUCTION(guard_fun_) {
-            SEXP sym = readConst(ctx, readImmediate());
+            Immediate name = readImmediate();
             advanceImmediate();
             res = readConst(ctx, readImmediate());
             advanceImmediate();
             advanceImmediate();
 #ifndef UNSOUND_OPTS
-            if (res != Rf_findFun(sym, env))
+            // Shares the binding cache with ldfun_, as long as no binding
+            // changed the guard does not walk the environments again
+            if (res != cachedGetFun(env, name, ctx, bindingCache))
                 Rf_error("Invalid Callee");
+#else
+            (void)name;
 #endif
             NEXT();
         }
@@ -3371,14 +4148,19 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
 #endif
 
             if (!pir::Parameter::DEOPT_CHAOS) {
-                // TODO: this version is still reachable from static call inline
-                // caches. Thus we need to preserve it forever. We need some
-                // dependency management here.
-                Pool::insert(c->container());
                 // remove the deoptimized function. Unless on deopt chaos,
-                // always recompiling would just blow testing time...
+                // always recompiling would just blow testing time... Running
+                // activations protect their version, static call inline
+                // caches drop it on their next call, since it is dead.
                 auto dt = DispatchTable::unpack(BODY(callCtxt->callee));
                 dt->remove(c);
+                removeContinuation(dt->baseline()->body(), c);
+                // Avoid deopt loops: do not speculate on the same feedback
+                // again and wait longer before the next optimization
+                m->reason.record();
+                dt->recordDeopt(m->reason, pir::Parameter::RIR_WARMUP);
+                // The optimizer kept the failed speculation for reuse
+                pirInvalidateModules();
             }
             assert(m->numFrames >= 1);
             size_t stackHeight = 0;
@@ -3432,8 +4214,9 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
                 SEXP argslist =
                     CONS_NR(from, CONS_NR(to, CONS_NR(by, R_NilValue)));
                 ostack_push(ctx, argslist);
+                invalidateGlobalBindings();
                 res = Rf_applyClosure(call, prim, argslist, env, R_NilValue);
-                ostack_pop(ctx);
+                ostack_popn(ctx, 1);
             }
 
             ostack_popn(ctx, 3);
@@ -3498,6 +4281,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         }
 
         INSTRUCTION(set_names_) {
+            ostack_box_n(ctx, 2);
             SEXP val = ostack_pop(ctx);
             if (!isNull(val))
                 Rf_setAttrib(ostack_top(ctx), R_NamesSymbol, val);
@@ -3526,11 +4310,11 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
             SEXP seq = ostack_at(ctx, 0);
             // TODO: we should extract the length just once at the begining of
             // the loop and generally have somthing more clever here...
-            SEXP value = Rf_allocVector(INTSXP, 1);
+            int size;
             if (Rf_isVector(seq)) {
-                INTEGER(value)[0] = LENGTH(seq);
+                size = LENGTH(seq);
             } else if (Rf_isList(seq) || isNull(seq)) {
-                INTEGER(value)[0] = Rf_length(seq);
+                size = Rf_length(seq);
             } else {
                 Rf_errorcall(R_NilValue, "invalid for() loop sequence");
             }
@@ -3544,7 +4328,7 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
                 SET_OBJECT(seq, 0);
                 ostack_set(ctx, 0, seq);
             }
-            ostack_push(ctx, value);
+            ostack_push_int(ctx, size);
             NEXT();
         }
 
@@ -3559,6 +4343,9 @@ SEXP evalRirCode(Code* c, InterpreterInstance* ctx, SEXP env,
         }
 
         INSTRUCTION(ensure_named_) {
+            // Unboxed values are never shared
+            if (ostack_tag_at(ctx, 0))
+                NEXT();
             SEXP val = ostack_top(ctx);
             ENSURE_NAMED(val);
             NEXT();
@@ -12,6 +12,7 @@
 #define MAX_ARG_IDX ((unsigned)-3)
 
 const static uint32_t NO_DEOPT_INFO = (uint32_t)-1;
+const static uint32_t NO_CALL_SITE_CACHE = (uint32_t)-1;
 
 namespace rir {
 
@@ -0,0 +1,251 @@
+#include "vector_arith.h"
+
+#include <climits>
+
+// The kernels below are plain loops, which the compiler vectorizes (this file
+// is built with -ftree-vectorize). On x86_64 we additionally get an AVX2 clone
+// of every kernel, the dynamic loader picks the best one for the host cpu.
+#if defined(__x86_64__) && defined(__ELF__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define VECTOR_KERNEL __attribute__((target_clones("avx2", "default")))
+#endif
+#endif
+#ifndef VECTOR_KERNEL
+#define VECTOR_KERNEL
+#endif
+
+// Everything called from a kernel has to be inlined into it, such that it is
+// compiled for the target of the clone.
+#define KERNEL_INLINE inline __attribute__((always_inline))
+
+namespace rir {
+
+namespace {
+
+// Int and logical vectors both store int, NA_INTEGER == NA_LOGICAL
+template <typename T>
+KERNEL_INLINE T* elements(SEXP v);
+template <>
+KERNEL_INLINE int* elements<int>(SEXP v) {
+    return static_cast<int*>(DATAPTR(v));
+}
+template <>
+KERNEL_INLINE double* elements<double>(SEXP v) {
+    return static_cast<double*>(DATAPTR(v));
+}
+
+// Like GNU R, integer arithmetic is computed in 64 bit. Results outside of
+// the int range (INT_MIN is NA) become NA and set the overflow flag.
+KERNEL_INLINE int checkedInt(int a, int b, long long r, int& overflow) {
+    bool na = a == NA_INTEGER || b == NA_INTEGER;
+    bool out = r > INT_MAX || r < -INT_MAX;
+    overflow |= out && !na;
+    return na || out ? NA_INTEGER : static_cast<int>(r);
+}
+
+// NA_REAL is a global, keeping a copy in the operation allows the compiler to
+// keep it in a register.
+struct Op {
+    const double naReal;
+    Op() : naReal(NA_REAL) {}
+    KERNEL_INLINE double real(int a) const {
+        return a == NA_INTEGER ? naReal : static_cast<double>(a);
+    }
+};
+
+#define ARITH_OP(Name, op)                                                     \
+    struct Name : public Op {                                                  \
+        KERNEL_INLINE int operator()(int a, int b, int& overflow) const {      \
+            return checkedInt(a, b, static_cast<long long>(a) op b, overflow); \
+        }                                                                      \
+        KERNEL_INLINE double operator()(double a, double b, int&) const {      \
+            return a op b;                                                     \
+        }                                                                      \
+        KERNEL_INLINE double operator()(int a, double b, int&) const {         \
+            return real(a) op b;                                               \
+        }                                                                      \
+        KERNEL_INLINE double operator()(double a, int b, int&) const {         \
+            return a op real(b);                                               \
+        }                                                                      \
+    }
+ARITH_OP(Add, +);
+ARITH_OP(Sub, -);
+ARITH_OP(Mul, *);
+#undef ARITH_OP
+
+struct Div : public Op {
+    KERNEL_INLINE double operator()(int a, int b, int&) const {
+        return a == NA_INTEGER || b == NA_INTEGER
+                   ? naReal
+                   : static_cast<double>(a) / static_cast<double>(b);
+    }
+    KERNEL_INLINE double operator()(double a, double b, int&) const {
+        return a / b;
+    }
+    KERNEL_INLINE double operator()(int a, double b, int&) const {
+        return real(a) / b;
+    }
+    KERNEL_INLINE double operator()(double a, int b, int&) const {
+        return a / real(b);
+    }
+};
+
+#define REL_OP(Name, op)                                                       \
+    struct Name : public Op {                                                  \
+        KERNEL_INLINE int operator()(int a, int b, int&) const {               \
+            return a == NA_INTEGER || b == NA_INTEGER                          \
+                       ? NA_LOGICAL                                            \
+                       : static_cast<int>(a op b);                             \
+        }                                                                      \
+        KERNEL_INLINE int operator()(double a, double b, int&) const {         \
+            return ISNAN(a) || ISNAN(b) ? NA_LOGICAL                           \
+                                        : static_cast<int>(a op b);            \
+        }                                                                      \
+        KERNEL_INLINE int operator()(int a, double b, int& o) const {          \
+            return (*this)(real(a), b, o);                                     \
+        }                                                                      \
+        KERNEL_INLINE int operator()(double a, int b, int& o) const {          \
+            return (*this)(a, real(b), o);                                     \
+        }                                                                      \
+    }
+REL_OP(Lt, <);
+REL_OP(Gt, >);
+REL_OP(Le, <=);
+REL_OP(Ge, >=);
+REL_OP(Eq, ==);
+REL_OP(Ne, !=);
+#undef REL_OP
+
+// The result may be one of the operands (see vectorBinop), which is fine
+// since every element is read before it is written.
+template <typename O, typename A, typename B>
+KERNEL_INLINE int zip(const O& op, const A* x, R_xlen_t nx, const B* y,
+                      R_xlen_t ny, SEXP res) {
+    int overflow = 0;
+    typedef decltype(op(*x, *y, overflow)) Res;
+    Res* r = elements<Res>(res);
+    if (nx == ny) {
+        for (R_xlen_t i = 0; i < nx; ++i)
+            r[i] = op(x[i], y[i], overflow);
+    } else if (nx == 1) {
+        A a = *x;
+        for (R_xlen_t i = 0; i < ny; ++i)
+            r[i] = op(a, y[i], overflow);
+    } else {
+        B b = *y;
+        for (R_xlen_t i = 0; i < nx; ++i)
+            r[i] = op(x[i], b, overflow);
+    }
+    return overflow;
+}
+
+template <typename O>
+KERNEL_INLINE int apply(const O& op, SEXP x, SEXP y, SEXP res) {
+    R_xlen_t nx = XLENGTH(x);
+    R_xlen_t ny = XLENGTH(y);
+    if (TYPEOF(x) == REALSXP) {
+        if (TYPEOF(y) == REALSXP)
+            return zip(op, elements<double>(x), nx, elements<double>(y), ny,
+                       res);
+        return zip(op, elements<double>(x), nx, elements<int>(y), ny, res);
+    }
+    if (TYPEOF(y) == REALSXP)
+        return zip(op, elements<int>(x), nx, elements<double>(y), ny, res);
+    return zip(op, elements<int>(x), nx, elements<int>(y), ny, res);
+}
+
+#define KERNEL(Name)                                                           \
+    VECTOR_KERNEL static int kernel##Name(SEXP x, SEXP y, SEXP res) {          \
+        return apply(Name(), x, y, res);                                       \
+    }
+KERNEL(Add)
+KERNEL(Sub)
+KERNEL(Mul)
+KERNEL(Div)
+KERNEL(Lt)
+KERNEL(Gt)
+KERNEL(Le)
+KERNEL(Ge)
+KERNEL(Eq)
+KERNEL(Ne)
+#undef KERNEL
+
+// Int, real and logical vectors without attributes, which store their
+// elements in place (ie. no ALTREP compact sequences)
+static bool isPlainVector(SEXP v) {
+    return (TYPEOF(v) == INTSXP || TYPEOF(v) == REALSXP ||
+            TYPEOF(v) == LGLSXP) &&
+           !ALTREP(v) && ATTRIB(v) == R_NilValue;
+}
+
+} // namespace
+
+SEXP vectorBinop(VectorOp op, SEXP lhs, SEXP rhs, bool& overflow) {
+    if (!isPlainVector(lhs) || !isPlainVector(rhs))
+        return nullptr;
+
+    // Operands of different length would need the warning about recycling
+    // when the longer one is not a multiple, and are rare anyway.
+    R_xlen_t nl = XLENGTH(lhs);
+    R_xlen_t nr = XLENGTH(rhs);
+    if (nl == 0 || nr == 0 || (nl != nr && nl != 1 && nr != 1))
+        return nullptr;
+    R_xlen_t n = nl > nr ? nl : nr;
+
+    bool real = TYPEOF(lhs) == REALSXP || TYPEOF(rhs) == REALSXP;
+    SEXPTYPE type;
+    if (op >= VectorOp::Lt)
+        type = LGLSXP;
+    else if (real || op == VectorOp::Div)
+        type = REALSXP;
+    else
+        type = INTSXP;
+
+    // Reuse an operand for the result when nobody else can observe it, like
+    // GNU R's arithmetic does
+    SEXP res;
+    if (TYPEOF(lhs) == type && nl == n && NO_REFERENCES(lhs))
+        res = lhs;
+    else if (TYPEOF(rhs) == type && nr == n && NO_REFERENCES(rhs))
+        res = rhs;
+    else
+        res = Rf_allocVector(type, n);
+
+    int ovf = 0;
+    switch (op) {
+    case VectorOp::Add:
+        ovf = kernelAdd(lhs, rhs, res);
+        break;
+    case VectorOp::Sub:
+        ovf = kernelSub(lhs, rhs, res);
+        break;
+    case VectorOp::Mul:
+        ovf = kernelMul(lhs, rhs, res);
+        break;
+    case VectorOp::Div:
+        kernelDiv(lhs, rhs, res);
+        break;
+    case VectorOp::Lt:
+        kernelLt(lhs, rhs, res);
+        break;
+    case VectorOp::Gt:
+        kernelGt(lhs, rhs, res);
+        break;
+    case VectorOp::Le:
+        kernelLe(lhs, rhs, res);
+        break;
+    case VectorOp::Ge:
+        kernelGe(lhs, rhs, res);
+        break;
+    case VectorOp::Eq:
+        kernelEq(lhs, rhs, res);
+        break;
+    case VectorOp::Ne:
+        kernelNe(lhs, rhs, res);
+        break;
+    }
+    overflow = ovf != 0;
+    return res;
+}
+
+} // namespace rir
@@ -0,0 +1,19 @@
+#ifndef RIR_VECTOR_ARITH_H
+#define RIR_VECTOR_ARITH_H
+
+#include <R/r.h>
+
+namespace rir {
+
+enum class VectorOp { Add, Sub, Mul, Div, Lt, Gt, Le, Ge, Eq, Ne };
+
+// Element-wise arithmetic and comparisons on int, real and logical vectors
+// without attributes, where both operands have the same length or one of them
+// is a scalar. Returns nullptr for all other operands, the caller has to fall
+// back to the builtin then. Integer results which overflow are NA and set
+// overflow, the caller is responsible for the warning.
+SEXP vectorBinop(VectorOp op, SEXP lhs, SEXP rhs, bool& overflow);
+
+} // namespace rir
+
+#endif
@@ -29,9 +29,14 @@ BC_NOARGS(V, _)
         cs.insert(immediate.callFeedback);
         return;
 
-    case Opcode::record_type_:
-        cs.insert(immediate.typeFeedback);
+    case Opcode::record_type_: {
+        // Like the call targets, constants and classes are in the extra pool
+        // of the code the feedback was recorded in, thus they are dropped
+        ObservedValues feedback = immediate.typeFeedback;
+        feedback.stableValue = feedback.stableClass = false;
+        cs.insert(feedback);
         break;
+    }
 
     case Opcode::push_:
     case Opcode::deopt_:
@@ -107,6 +112,7 @@ BC_NOARGS(V, _)
         return;
 
     case Opcode::popn_:
+    case Opcode::mk_dots_:
     case Opcode::pick_:
     case Opcode::pull_:
     case Opcode::is_:
@@ -116,6 +122,7 @@ BC_NOARGS(V, _)
         return;
 
     case Opcode::ldarg_:
+    case Opcode::ldarg_dots_:
         cs.insert(immediate.arg_idx);
         return;
 
@@ -180,6 +187,15 @@ void BC::print(std::ostream& out) const {
         } else {
             out << "<?>";
         }
+        if (prof.numTypes) {
+            out << " len<=";
+            if (prof.maxLength == ObservedValues::LengthOverflow)
+                out << "*";
+            else
+                out << prof.maxLength;
+            if (!prof.maybeNA)
+                out << " noNA";
+        }
     };
 
     switch (bc) {
@@ -219,14 +235,11 @@ void BC::print(std::ostream& out) const {
         break;
     }
     case Opcode::static_call_: {
+        // The target is printed by Code::disassemble, it lives in the extra
+        // pool of the code
         auto args = immediate.staticCallFixedArgs;
         BC::NumArgs nargs = args.nargs;
-        auto target = Pool::get(args.targetClosure);
-        auto targetV = Pool::get(args.versionHint);
-        out << nargs << " : ";
-        if (targetV != R_NilValue)
-            out << "(" << Function::unpack(targetV) << ") ";
-        out << dumpSexp(target).c_str();
+        out << nargs;
         break;
     }
     case Opcode::mk_stub_env_:
@@ -265,12 +278,14 @@ void BC::print(std::ostream& out) const {
         break;
     }
     case Opcode::popn_:
+    case Opcode::mk_dots_:
     case Opcode::pick_:
     case Opcode::pull_:
     case Opcode::put_:
         out << immediate.i;
         break;
     case Opcode::ldarg_:
+    case Opcode::ldarg_dots_:
         out << immediate.arg_idx;
         break;
     case Opcode::ldloc_:
@@ -306,6 +321,10 @@ void BC::print(std::ostream& out) const {
     case Opcode::record_type_: {
         out << "[ ";
         printTypeFeedback(immediate.typeFeedback);
+        if (auto v = typeFeedbackExtra().value)
+            out << " = " << dumpSexp(v);
+        if (auto k = typeFeedbackExtra().klass)
+            out << " class " << dumpSexp(k);
         out << " ]";
         break;
     }
@@ -330,4 +349,63 @@ BC_NOARGS(V, _)
     out << "\n";
 }
 
+void BC::poolImmediates(Opcode* pc, std::vector<size_t>& res) {
+    auto imm = [](size_t i) { return 1 + i * sizeof(Immediate); };
+    auto nargs = [&]() {
+        Immediate n;
+        memcpy(&n, (uint8_t*)pc + imm(0), sizeof(Immediate));
+        return n;
+    };
+
+    switch (*pc) {
+    case Opcode::deopt_:
+    case Opcode::push_:
+    case Opcode::ldfun_:
+    case Opcode::ldvar_:
+    case Opcode::ldvar_for_update_:
+    case Opcode::ldvar_noforce_:
+    case Opcode::ldvar_super_:
+    case Opcode::ldvar_noforce_super_:
+    case Opcode::ldddvar_:
+    case Opcode::stvar_:
+    case Opcode::starg_:
+    case Opcode::stvar_super_:
+    case Opcode::missing_:
+        res.push_back(imm(0));
+        break;
+    case Opcode::call_:
+    case Opcode::call_implicit_:
+        res.push_back(imm(1));
+        break;
+    case Opcode::named_call_:
+        res.push_back(imm(1));
+        for (size_t i = 0; i < nargs(); ++i)
+            res.push_back(imm(5 + i));
+        break;
+    case Opcode::named_call_implicit_:
+        // the names follow the promise indices
+        res.push_back(imm(1));
+        for (size_t i = 0; i < nargs(); ++i)
+            res.push_back(imm(5 + nargs() + i));
+        break;
+    case Opcode::static_call_:
+        res.push_back(imm(1));
+        break;
+    case Opcode::call_builtin_:
+        res.push_back(imm(1));
+        res.push_back(imm(2));
+        break;
+    case Opcode::guard_fun_:
+        res.push_back(imm(0));
+        res.push_back(imm(1));
+        break;
+    case Opcode::mk_env_:
+    case Opcode::mk_stub_env_:
+        for (size_t i = 0; i < nargs(); ++i)
+            res.push_back(imm(2 + i));
+        break;
+    default: {}
+    }
+}
+
 } // namespace rir
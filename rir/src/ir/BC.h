@@ -103,6 +103,16 @@ BC BC::ldarg(uint32_t offset) {
     i.arg_idx = offset;
     return BC(Opcode::ldarg_, i);
 }
+BC BC::ldargDots(uint32_t offset) {
+    ImmediateArguments i;
+    i.arg_idx = offset;
+    return BC(Opcode::ldarg_dots_, i);
+}
+BC BC::mkDots(unsigned n) {
+    ImmediateArguments i;
+    i.i = n;
+    return BC(Opcode::mk_dots_, i);
+}
 BC BC::ldloc(uint32_t offset) {
     ImmediateArguments im;
     im.loc = offset;
@@ -233,6 +243,7 @@ BC BC::callImplicit(const std::vector<FunIdx>& args, SEXP ast,
     im.callFixedArgs.nargs = args.size();
     im.callFixedArgs.ast = Pool::insert(ast);
     im.callFixedArgs.given = given;
+    im.callFixedArgs.cache = NO_CALL_SITE_CACHE;
     BC cur(Opcode::call_implicit_, im);
     cur.callExtra().immediateCallArguments = args;
     return cur;
@@ -244,6 +255,7 @@ BC BC::callImplicit(const std::vector<FunIdx>& args,
     im.callFixedArgs.nargs = args.size();
     im.callFixedArgs.ast = Pool::insert(ast);
     im.callFixedArgs.given = given;
+    im.callFixedArgs.cache = NO_CALL_SITE_CACHE;
     std::vector<PoolIdx> nameIdxs;
     for (auto n : names)
         nameIdxs.push_back(Pool::insert(n));
@@ -257,6 +269,7 @@ BC BC::call(size_t nargs, SEXP ast, const Assumptions& given) {
     im.callFixedArgs.nargs = nargs;
     im.callFixedArgs.ast = Pool::insert(ast);
     im.callFixedArgs.given = given;
+    im.callFixedArgs.cache = NO_CALL_SITE_CACHE;
     return BC(Opcode::call_, im);
 }
 BC BC::call(size_t nargs, const std::vector<SEXP>& names, SEXP ast,
@@ -265,6 +278,7 @@ BC BC::call(size_t nargs, const std::vector<SEXP>& names, SEXP ast,
     im.callFixedArgs.nargs = nargs;
     im.callFixedArgs.ast = Pool::insert(ast);
     im.callFixedArgs.given = given;
+    im.callFixedArgs.cache = NO_CALL_SITE_CACHE;
     std::vector<PoolIdx> nameIdxs;
     for (auto n : names)
         nameIdxs.push_back(Pool::insert(n));
@@ -272,17 +286,13 @@ BC BC::call(size_t nargs, const std::vector<SEXP>& names, SEXP ast,
     cur.callExtra().callArgumentNames = nameIdxs;
     return cur;
 }
-BC BC::staticCall(size_t nargs, SEXP ast, SEXP targetClosure,
-                  SEXP targetVersion, const Assumptions& given) {
-    assert(!targetVersion || Function::unpack(targetVersion));
-    assert(TYPEOF(targetClosure) == CLOSXP);
-    auto target =
-        targetVersion ? Pool::insert(targetVersion) : Pool::makeSpace();
+BC BC::staticCall(size_t nargs, SEXP ast, Immediate targetClosure,
+                  Immediate version, const Assumptions& given) {
     ImmediateArguments im;
     im.staticCallFixedArgs.nargs = nargs;
     im.staticCallFixedArgs.ast = Pool::insert(ast);
-    im.staticCallFixedArgs.targetClosure = Pool::insert(targetClosure);
-    im.staticCallFixedArgs.versionHint = target;
+    im.staticCallFixedArgs.targetClosure = targetClosure;
+    im.staticCallFixedArgs.version = version;
     im.staticCallFixedArgs.given = given;
     return BC(Opcode::static_call_, im);
 }
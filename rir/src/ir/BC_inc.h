@@ -88,13 +88,17 @@ class BC {
         NumArgs nargs;
         Immediate ast;
         Assumptions given;
+        // extra pool index of the CallSiteCache, allocated on first use
+        Immediate cache;
     };
     struct StaticCallFixedArgs {
         NumArgs nargs;
         Immediate ast;
         Assumptions given;
+        // extra pool indices of the callee and of the version last called,
+        // they are released together with the calling code
         Immediate targetClosure;
-        Immediate versionHint;
+        Immediate version;
     };
     struct CallBuiltinFixedArgs {
         NumArgs nargs;
@@ -203,7 +207,7 @@ class BC {
             return immediate.callBuiltinFixedArgs.nargs;
         if (bc == Opcode::mk_env_ || bc == Opcode::mk_stub_env_)
             return immediate.mkEnvFixedArgs.nargs + 1;
-        if (bc == Opcode::popn_)
+        if (bc == Opcode::popn_ || bc == Opcode::mk_dots_)
             return immediate.i;
         return popCount(bc);
     }
@@ -281,7 +285,7 @@ class BC {
         switch (bc) {
         // First handle the varlength BCs. In all three cases the number of
         // call arguments is the 2nd immediate argument and the
-        // instructions have 4 fixed length immediates. After that there are
+        // instructions have 5 fixed length immediates. After that there are
         // narg varlen immediates for the first two and 2*narg varlen
         // immediates in the last case.
         case Opcode::call_implicit_:
@@ -289,13 +293,13 @@ class BC {
             pc++;
             Immediate nargs;
             memcpy(&nargs, pc, sizeof(Immediate));
-            return 1 + (4 + nargs) * sizeof(Immediate);
+            return 1 + (5 + nargs) * sizeof(Immediate);
         }
         case Opcode::named_call_implicit_: {
             pc++;
             Immediate nargs;
             memcpy(&nargs, pc, sizeof(Immediate));
-            return 1 + (4 + 2 * nargs) * sizeof(Immediate);
+            return 1 + (5 + 2 * nargs) * sizeof(Immediate);
         }
         case Opcode::mk_stub_env_:
         case Opcode::mk_env_: {
@@ -311,6 +315,10 @@ class BC {
 
     RIR_INLINE static Opcode* next(rir::Opcode* pc) { return pc + size(pc); }
 
+    // Offsets (relative to the opcode) of all constant pool immediates of the
+    // instruction at pc
+    static void poolImmediates(Opcode* pc, std::vector<size_t>& res);
+
     // If the decoded BC is not needed, you should use next, since it is much
     // faster.
     inline static BC advance(Opcode** pc, Code* code)
@@ -342,6 +350,8 @@ BC_NOARGS(V, _)
     inline static BC ldvarNoForceSuper(SEXP sym);
     inline static BC ldddvar(SEXP sym);
     inline static BC ldarg(uint32_t offset);
+    inline static BC ldargDots(uint32_t offset);
+    inline static BC mkDots(unsigned n);
     inline static BC ldloc(uint32_t offset);
     inline static BC stloc(uint32_t offset);
     inline static BC copyloc(uint32_t target, uint32_t source);
@@ -375,8 +385,8 @@ BC_NOARGS(V, _)
     inline static BC call(size_t nargs, SEXP ast, const Assumptions& given);
     inline static BC call(size_t nargs, const std::vector<SEXP>& names,
                           SEXP ast, const Assumptions& given);
-    inline static BC staticCall(size_t nargs, SEXP ast, SEXP targetClosure,
-                                SEXP targetVersion, const Assumptions& given);
+    inline static BC staticCall(size_t nargs, SEXP ast, Immediate targetClosure,
+                                Immediate version, const Assumptions& given);
     inline static BC callBuiltin(size_t nargs, SEXP ast, SEXP target);
 
     inline static BC mkEnv(const std::vector<SEXP>& names,
@@ -409,6 +419,10 @@ BC_NOARGS(V, _)
     struct CallFeedbackExtraInformation : public ExtraInformation {
         std::vector<SEXP> targets;
     };
+    struct TypeFeedbackExtraInformation : public ExtraInformation {
+        SEXP value = nullptr;
+        SEXP klass = nullptr;
+    };
     struct MkEnvExtraInformation : public ExtraInformation {
         std::vector<BC::PoolIdx> names;
     };
@@ -446,6 +460,14 @@ BC_NOARGS(V, _)
             extraInformation.get());
     }
 
+    TypeFeedbackExtraInformation& typeFeedbackExtra() const {
+        assert(bc == Opcode::record_type_ && "not a record type instruction");
+        assert(extraInformation.get() &&
+               "missing extra information. created through decodeShallow?");
+        return *static_cast<TypeFeedbackExtraInformation*>(
+            extraInformation.get());
+    }
+
   private:
     void allocExtraInformation() {
         assert(extraInformation == nullptr);
@@ -465,6 +487,10 @@ BC_NOARGS(V, _)
             extraInformation.reset(new CallFeedbackExtraInformation);
             break;
         }
+        case Opcode::record_type_: {
+            extraInformation.reset(new TypeFeedbackExtraInformation);
+            break;
+        }
         case Opcode::mk_stub_env_:
         case Opcode::mk_env_: {
             extraInformation.reset(new MkEnvExtraInformation);
@@ -515,6 +541,15 @@ BC_NOARGS(V, _)
                     immediate.callFeedback.getTarget(code, i));
             break;
         }
+        case Opcode::record_type_: {
+            // Read the constant and class feedback from the extra pool
+            auto& feedback = immediate.typeFeedback;
+            if (feedback.stableValue)
+                typeFeedbackExtra().value = feedback.getValue(code);
+            if (feedback.stableClass)
+                typeFeedbackExtra().klass = feedback.getClass(code);
+            break;
+        }
         default: {}
         }
     }
@@ -645,6 +680,7 @@ BC_NOARGS(V, _)
             memcpy(&immediate.offset, pc, sizeof(Jmp));
             break;
         case Opcode::popn_:
+        case Opcode::mk_dots_:
         case Opcode::pick_:
         case Opcode::pull_:
         case Opcode::is_:
@@ -653,6 +689,7 @@ BC_NOARGS(V, _)
             memcpy(&immediate.i, pc, sizeof(uint32_t));
             break;
         case Opcode::ldarg_:
+        case Opcode::ldarg_dots_:
             memcpy(&immediate.arg_idx, pc, sizeof(ArgIdx));
             break;
         case Opcode::ldloc_:
@@ -18,7 +18,8 @@ class CodeStream {
     friend class Compiler;
 
     std::vector<char>* code;
-    std::vector<Code*> promises;
+    // Promises and other objects owned by the code, see Code::extraPool
+    std::vector<SEXP> extraPool;
 
     typedef unsigned PcOffset;
     PcOffset pos = 0;
@@ -52,9 +53,14 @@ class CodeStream {
     CodeStream& operator=(const CodeStream& other) = delete;
 
     size_t addPromise(Code* code) {
-        preserve(code->container());
-        auto s = promises.size();
-        promises.push_back(code);
+        return addExtraPoolEntry(code->container());
+    }
+
+    size_t addExtraPoolEntry(SEXP value) {
+        if (value != R_NilValue)
+            preserve(value);
+        auto s = extraPool.size();
+        extraPool.push_back(value);
         return s;
     }
 
@@ -120,7 +126,7 @@ class CodeStream {
         pos += s;
     }
 
-    void addSrc(SEXP src) { sources[pos] = src_pool_add(globalContext(), src); }
+    void addSrc(SEXP src) { sources[pos] = Pool::insertSrc(src); }
 
     void addSrcIdx(unsigned idx) { sources[pos] = idx; }
 
@@ -153,8 +159,8 @@ class CodeStream {
                                        patchpoints, labels, localsCnt, nops);
         assert(res->extraPoolSize == 0 &&
                "promise indices and src pool idx need to be aligned");
-        for (auto c : promises)
-            res->addExtraPoolEntry(c->container());
+        for (auto e : extraPool)
+            res->addExtraPoolEntry(e);
 
         labels.clear();
         patchpoints.clear();
@@ -166,6 +172,7 @@ class CodeStream {
         pos = 0;
 
         CodeVerifier::calculateAndVerifyStack(res);
+        res->computeBindingCacheSize();
         return res;
     }
 };
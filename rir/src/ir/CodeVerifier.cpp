@@ -137,6 +137,8 @@ static Sources hasSources(Opcode bc) {
     case Opcode::put_:
     case Opcode::alloc_:
     case Opcode::ldarg_:
+    case Opcode::ldarg_dots_:
+    case Opcode::mk_dots_:
     case Opcode::stloc_:
     case Opcode::movloc_:
     case Opcode::nop_:
@@ -313,7 +315,7 @@ void CodeVerifier::verifyFunctionLayout(SEXP sexp, InterpreterInstance* ctx) {
                 unsigned* promidx = reinterpret_cast<Immediate*>(cptr + 1);
                 objs.push_back(c->getPromise(*promidx));
             }
-            if (*cptr == Opcode::ldarg_) {
+            if (*cptr == Opcode::ldarg_ || *cptr == Opcode::ldarg_dots_) {
                 unsigned idx = *reinterpret_cast<Immediate*>(cptr + 1);
                 if (idx >= MAX_ARG_IDX)
                     Rf_error("RIR Verifier: Loading out of index argument");
@@ -16,6 +16,7 @@
 
 #include "simple_instruction_list.h"
 
+#include <algorithm>
 #include <stack>
 
 namespace rir {
@@ -149,6 +150,7 @@ Code* compilePromise(CompilerContext& ctx, SEXP exp);
 // in a void context, since the loop as an expression is always nil.
 void compileExpr(CompilerContext& ctx, SEXP exp, bool voidContext = false);
 void compileCall(CompilerContext& ctx, SEXP ast, SEXP fun, SEXP args, bool voidContext);
+void compileCallArgs(CompilerContext& ctx, SEXP ast, SEXP args);
 
 void compileWhile(CompilerContext& ctx, std::function<void()> compileCond,
                   std::function<void()> compileBody) {
@@ -278,6 +280,233 @@ Else({ return false; })
 assert(false);
 } // namespace rir
 
+// The closure bound to `sym` in base, or nullptr. Lazy loaded bindings are
+// not forced, that is left to the first call.
+static SEXP baseClosure(SEXP sym) {
+    SEXP fun = Rf_findVarInFrame(R_BaseEnv, sym);
+    if (TYPEOF(fun) == PROMSXP)
+        fun = PRVALUE(fun);
+    return TYPEOF(fun) == CLOSXP ? fun : nullptr;
+}
+
+// Does the expression only call primitives of base, by name? Closures could
+// look at the stack (sys.call, parent.frame, match.call and the like, also
+// when called indirectly), which differs when FUN is called from the loop.
+// Primitives only see the frame of FUN, except for the ones below which call
+// back into closures or dispatch on the caller.
+static bool callsOnlyPrimitives(SEXP e) {
+    static std::vector<SEXP> excluded;
+    if (excluded.empty())
+        for (auto n : {"UseMethod", "NextMethod", "standardGeneric",
+                       "forceAndCall", ".Call", ".External", ".External2",
+                       ".Internal"})
+            excluded.push_back(Rf_install(n));
+
+    switch (TYPEOF(e)) {
+    case LANGSXP: {
+        SEXP head = CAR(e);
+        if (TYPEOF(head) != SYMSXP ||
+            std::find(excluded.begin(), excluded.end(), head) !=
+                excluded.end())
+            return false;
+        SEXP fun = Rf_findVarInFrame(R_BaseEnv, head);
+        if (TYPEOF(fun) != BUILTINSXP && TYPEOF(fun) != SPECIALSXP)
+            return false;
+        return callsOnlyPrimitives(CDR(e));
+    }
+    case LISTSXP:
+        for (; e != R_NilValue; e = CDR(e))
+            if (!callsOnlyPrimitives(CAR(e)))
+                return false;
+        return true;
+    default:
+        return true;
+    }
+}
+
+// lapply(X, FUN) and sapply(X, FUN) go through the .Internal, which calls back
+// into FUN for every element. If the binding is still the one from base, we
+// loop here instead. The call in the loop has its own call feedback, thus the
+// optimizer can call FUN statically and inline it.
+//
+// FUN is called from the frame of the caller instead of the one of lapply,
+// thus the stack misses the frame of lapply. To keep that unobservable, FUN
+// has to be an anonymous function which only calls primitives (see
+// callsOnlyPrimitives). Those bindings are checked here, not at runtime: if a
+// primitive is shadowed by a closure, or dispatches to an S3 or S4 method for
+// an object, that closure sees sys.calls() and sys.frames() without lapply.
+// Everything else, functions given by name, vapply and Map, calls the base
+// function.
+bool compileApply(CompilerContext& ctx, SEXP ast, SEXP fun, SEXP args_,
+                  bool voidContext) {
+    bool sapply = fun == symbol::sapply;
+    SEXP base = baseClosure(fun);
+    SEXP simplify = sapply ? baseClosure(symbol::simplify2array) : nullptr;
+    if (!base || (sapply && !simplify))
+        return false;
+
+    SEXP x = nullptr;
+    SEXP f = nullptr;
+    std::vector<SEXP> positional;
+    RList args(args_);
+    for (RListIter a = args.begin(); a != args.end(); ++a) {
+        if (*a == R_DotsSymbol || *a == R_MissingArg)
+            return false;
+        if (!a.hasTag())
+            positional.push_back(*a);
+        else if (a.tag() == symbol::X && !x)
+            x = *a;
+        else if (a.tag() == symbol::FUN && !f)
+            f = *a;
+        else
+            return false;
+    }
+    for (auto a : positional) {
+        if (!x)
+            x = a;
+        else if (!f)
+            f = a;
+        else
+            return false;
+    }
+    if (!x || !f)
+        return false;
+    if (TYPEOF(f) != LANGSXP || CAR(f) != symbol::Function ||
+        !callsOnlyPrimitives(f))
+        return false;
+
+    // lapply(X, FUN)
+    // =>
+    // if (!identical(lapply, <base lapply>))
+    //   goto generic
+    // FUN' <- FUN
+    // X' <- X
+    // if (is.object(X') || !is.vector(X', "any"))
+    //   goto fallback
+    // n' <- length(X')
+    // res' <- vector("list", n')
+    // i' <- 0L
+    // while ((i' <- i' + 1L) <= n')
+    //   res'[i'] <- list(FUN'(X'[[i']], ...))
+    // names(res') <- names(X')
+    // sapply only:
+    //   if (is.character(X') && is.null(names(res')))
+    //     names(res') <- X'
+    //   if (n' > 0)
+    //     res' <- simplify2array(res', higher = FALSE)
+    // goto join
+    // fallback:
+    //   res' <- <base lapply>(X', FUN')
+    //   goto join
+    // generic:
+    //   res' <- lapply(X, FUN)
+    // join:
+
+    // The ASTs of the call in the loop are the ones base uses, thus
+    // substitute and error messages in FUN see the same expressions. The
+    // ... is never passed, since there are no further arguments.
+    SEXP any = PROTECT(Rf_mkString("any"));
+    SEXP list = PROTECT(Rf_mkString("list"));
+    SEXP elt = PROTECT(Rf_lang3(symbol::DoubleBracket, symbol::X, symbol::i));
+    SEXP call = PROTECT(Rf_lang3(symbol::FUN, elt, R_DotsSymbol));
+    SEXP simplifyCall =
+        PROTECT(Rf_lang3(symbol::simplify2array, symbol::answer, R_FalseValue));
+    SET_TAG(CDDR(simplifyCall), symbol::higher);
+
+    CodeStream& cs = ctx.cs();
+    BC::Label genericBranch = cs.mkLabel();
+    BC::Label fallbackBranch = cs.mkLabel();
+    BC::Label loopBranch = cs.mkLabel();
+    BC::Label endLoopBranch = cs.mkLabel();
+    BC::Label joinBranch = cs.mkLabel();
+
+    Assumptions given;
+    given.add(Assumption::CorrectOrderOfArguments);
+
+    cs << BC::ldfun(fun) << BC::dup() << BC::push(base)
+       << BC::identicalNoforce() << BC::brfalse(genericBranch) << BC::pop();
+
+    compileExpr(ctx, f);
+    compileExpr(ctx, x);
+    cs << BC::brobj(fallbackBranch) << BC::dup() << BC::push(any)
+       << BC::callBuiltin(2, ast, symbol::isvector->u.symsxp.internal)
+       << BC::brfalse(fallbackBranch);
+
+    // n' <- length(X')
+    cs << BC::dup() << BC::callBuiltin(1, ast, SYMVALUE(symbol::Length));
+    // res' <- vector("list", n')
+    cs << BC::push(list) << BC::pull(1)
+       << BC::callBuiltin(2, ast, symbol::Vector->u.symsxp.internal);
+    // i' <- 0L
+    cs << BC::push((int)0);
+
+    // while ((i' <- i' + 1L) <= n')
+    cs << loopBranch << BC::inc() << BC::ensureNamed() << BC::pull(0)
+       << BC::pull(3) << BC::gt();
+    cs.addSrc(R_NilValue);
+    cs << BC::brtrue(endLoopBranch);
+
+    // FUN'(X'[[i']])
+    cs << BC::pull(4);
+    if (Compiler::profile)
+        cs << BC::recordCall();
+    cs << BC::pull(4) << BC::pull(2) << BC::extract2_1();
+    cs.addSrc(R_NilValue);
+    size_t prom = cs.addPromise(compilePromise(ctx, elt));
+    cs << BC::promise(prom) << BC::call(1, call, given);
+
+    // res'[i'] <- list(...), which keeps NULL results
+    cs << BC::callBuiltin(1, ast, SYMVALUE(symbol::List)) << BC::pick(2)
+       << BC::pull(2) << BC::subassign1_1();
+    cs.addSrc(ast);
+    cs << BC::swap() << BC::br(loopBranch);
+
+    // names(res') <- names(X')
+    cs << endLoopBranch << BC::pop() << BC::pull(2)
+       << BC::callBuiltin(1, ast, SYMVALUE(symbol::names))
+       << BC::callBuiltin(2, ast, SYMVALUE(symbol::NamesAssign));
+
+    if (sapply) {
+        BC::Label namedBranch = cs.mkLabel();
+        BC::Label simplifiedBranch = cs.mkLabel();
+
+        cs << BC::pull(2)
+           << BC::callBuiltin(1, ast, SYMVALUE(symbol::ischaracter))
+           << BC::brfalse(namedBranch) << BC::dup()
+           << BC::callBuiltin(1, ast, SYMVALUE(symbol::names))
+           << BC::is(NILSXP) << BC::brfalse(namedBranch) << BC::pull(2)
+           << BC::callBuiltin(2, ast, SYMVALUE(symbol::NamesAssign))
+           << namedBranch;
+
+        cs << BC::pull(1) << BC::push((int)0) << BC::gt();
+        cs.addSrc(R_NilValue);
+        cs << BC::brfalse(simplifiedBranch) << BC::push(simplify)
+           << BC::swap() << BC::push(R_FalseValue)
+           << BC::call(2, {R_NilValue, symbol::higher}, simplifyCall,
+                       Assumptions())
+           << simplifiedBranch;
+    }
+    cs << BC::put(3) << BC::popn(3) << BC::visible() << BC::br(joinBranch);
+
+    // <base lapply>(X', FUN')
+    cs << fallbackBranch << BC::push(base) << BC::pull(1) << BC::pull(3)
+       << BC::call(2, ast, given) << BC::put(2) << BC::popn(2)
+       << BC::br(joinBranch);
+
+    // lapply(X, FUN)
+    cs << genericBranch;
+    compileCallArgs(ctx, ast, args_);
+
+    cs << joinBranch;
+    if (voidContext)
+        cs << BC::pop();
+    else if (Compiler::profile)
+        cs << BC::recordType();
+
+    UNPROTECT(5);
+    return true;
+}
+
 // Inline some specials
 // TODO: once we have sufficiently powerful analysis this should (maybe?) go
 //       away and move to an optimization phase.
@@ -883,6 +1112,10 @@ bool compileSpecialCall(CompilerContext& ctx, SEXP ast, SEXP fun, SEXP args_, bo
         }
     }
 
+    if ((fun == symbol::lapply || fun == symbol::sapply) &&
+        compileApply(ctx, ast, fun, args_, voidContext))
+        return true;
+
     if (fun == symbol::Internal) {
         SEXP inAst = args[0];
         SEXP args_ = CDR(inAst);
@@ -968,6 +1201,17 @@ void compileCall(CompilerContext& ctx, SEXP ast, SEXP fun, SEXP args, bool voidC
         });
     }
 
+    compileCallArgs(ctx, ast, args);
+    if (voidContext)
+        cs << BC::pop();
+    else if (Compiler::profile)
+        cs << BC::recordType();
+}
+
+// Arguments and call to the callee on top of the stack
+void compileCallArgs(CompilerContext& ctx, SEXP ast, SEXP args) {
+    CodeStream& cs = ctx.cs();
+
     // Process arguments:
     // Arguments can be optionally named
     std::vector<BC::FunIdx> callArgs;
@@ -1025,10 +1269,6 @@ void compileCall(CompilerContext& ctx, SEXP ast, SEXP fun, SEXP args, bool voidC
         assumptions.add(Assumption::CorrectOrderOfArguments);
         cs << BC::callImplicit(callArgs, ast, assumptions);
     }
-    if (voidContext)
-        cs << BC::pop();
-    else if (Compiler::profile)
-        cs << BC::recordType();
 }
 
 // Lookup
@@ -1121,6 +1361,8 @@ SEXP Compiler::finalize() {
             function.addDefaultArg(compiled);
         }
         signature.pushDefaultArgument();
+        if (arg.tag() == R_DotsSymbol)
+            signature.hasDotsFormals = true;
     }
 
     ctx.push(exp, closureEnv);
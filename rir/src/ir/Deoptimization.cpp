@@ -1,8 +1,47 @@
 #include "Deoptimization.h"
 #include "runtime/Code.h"
+#include "runtime/TypeFeedback.h"
 
 namespace rir {
+
+constexpr size_t DeoptReason::NumReasons;
+
+void DeoptReason::record() const {
+    // Failed call target guards deopt before the record_call_, the baseline
+    // records the new target itself. The value a typecheck failed on is not
+    // available anymore, thus we can only widen the feedback.
+    if (reason != Typecheck || !origin.pc ||
+        *origin.pc != Opcode::record_type_)
+        return;
+    auto feedback = (ObservedValues*)(origin.pc + 1);
+    feedback->widen();
+}
+
+const char* DeoptReason::name(Reason reason) {
+    switch (reason) {
+    case Unknown:
+        return "unknown";
+    case Typecheck:
+        return "typecheck";
+    case Calltarget:
+        return "calltarget";
+    case EnvStubMaterialized:
+        return "envstub";
+    }
+    assert(false);
+    return "";
+}
+
+void DeoptReason::print(std::ostream& out) const {
+    out << name(reason);
+    if (origin.pc)
+        out << "@" << origin.srcCode << "+"
+            << origin.pc - origin.srcCode->code();
+}
+
 void DeoptMetadata::print(std::ostream& out) const {
+    reason.print(out);
+    out << " ";
     for (size_t i = 0; i < numFrames; ++i) {
         auto f = frames[i];
         out << f.code << "+" << f.pc - f.code->code() << " s" << f.stackSize;
@@ -1,6 +1,7 @@
 #ifndef RIR_DEOPTIMIZATION_H
 #define RIR_DEOPTIMIZATION_H
 
+#include <cstdint>
 #include <iostream>
 
 namespace rir {
@@ -16,8 +17,46 @@ struct FrameInfo {
     size_t stackSize;
 };
 
+// Position of a record_ instruction in the baseline code, ie. of the feedback
+// a speculation was based on
+struct FeedbackOrigin {
+    Code* srcCode;
+    Opcode* pc;
+
+    bool operator==(const FeedbackOrigin& other) const {
+        return srcCode == other.srcCode && pc == other.pc;
+    }
+};
+
+struct DeoptReason {
+    enum Reason : uint32_t {
+        Unknown,
+        Typecheck,
+        Calltarget,
+        EnvStubMaterialized,
+    };
+    static constexpr size_t NumReasons = EnvStubMaterialized + 1;
+
+    Reason reason;
+    FeedbackOrigin origin;
+
+    static DeoptReason unknown() { return {Unknown, {nullptr, nullptr}}; }
+
+    bool operator==(const DeoptReason& other) const {
+        return reason == other.reason && origin == other.origin;
+    }
+
+    // Updates the feedback at the origin, such that the compiler does not
+    // speculate on it again
+    void record() const;
+
+    static const char* name(Reason reason);
+    void print(std::ostream& out) const;
+};
+
 struct DeoptMetadata {
     void print(std::ostream& out) const;
+    DeoptReason reason;
     size_t numFrames;
     FrameInfo frames[];
 };
@@ -86,6 +86,16 @@ DEF_INSTR(ldddvar_, 1, 0, 1, 0)
  */
 DEF_INSTR(ldarg_, 1, 0, 1, 0)
 
+/**
+ * ldarg_dots_:: load the arguments from the immediate index on as a ... list
+ */
+DEF_INSTR(ldarg_dots_, 1, 0, 1, 0)
+
+/**
+ * mk_dots_:: create a ... list of n values from the stack
+ */
+DEF_INSTR(mk_dots_, 1, -1, 1, 1)
+
 /**
  * ldloc_:: push local variable on stack
  */
@@ -127,21 +137,21 @@ DEF_INSTR(movloc_, 2, 0, 0, 1)
  *                  THIS IS A VARIABLE LENGTH INSTRUCTION
  *                  the actual number of immediates is 3 + nargs
  */
-DEF_INSTR(call_implicit_, 4, 1, 1, 0)
+DEF_INSTR(call_implicit_, 5, 1, 1, 0)
 /*
  * Same as above, but with names for the arguments as immediates
  *
  *                  THIS IS A VARIABLE LENGTH INSTRUCTION
  *                  the actual number of immediates is 3 + 2 * nargs
  */
-DEF_INSTR(named_call_implicit_, 4, 1, 1, 0)
+DEF_INSTR(named_call_implicit_, 5, 1, 1, 0)
 
 /**
  * call_:: Like call_implicit_, but expects arguments on stack
  *         on top of the callee; these arguments can be both
  *         values and promises (even preseeded w/ a value)
  */
-DEF_INSTR(call_, 4, -1, 1, 0)
+DEF_INSTR(call_, 5, -1, 1, 0)
 
 /*
  * Same as above, but with names for the arguments as immediates
@@ -149,7 +159,7 @@ DEF_INSTR(call_, 4, -1, 1, 0)
  *                  THIS IS A VARIABLE LENGTH INSTRUCTION
  *                  the actual number of immediates is 3 + nargs
  */
-DEF_INSTR(named_call_, 4, -1, 1, 0)
+DEF_INSTR(named_call_, 5, -1, 1, 0)
 
 /**
  * static_call_:: Like call_, but the callee is statically known
@@ -518,7 +528,7 @@ DEF_INSTR(deopt_, 1, -1, 0, 0)
  * heavy in size.
  */
 DEF_INSTR(record_call_, 4, 1, 1, 0)
-DEF_INSTR(record_type_, 1, 1, 1, 0)
+DEF_INSTR(record_type_, 4, 1, 1, 0)
 
 DEF_INSTR(int3_, 0, 0, 0, 0)
 DEF_INSTR(printInvocation_, 0, 0, 0, 0)
@@ -0,0 +1,74 @@
+#ifndef RIR_CALL_SITE_CACHE_H
+#define RIR_CALL_SITE_CACHE_H
+
+#include "DispatchTable.h"
+#include "Function.h"
+#include "RirRuntimeObject.h"
+
+namespace rir {
+
+#define CALL_SITE_CACHE_MAGIC (unsigned)0xca11cace
+
+/*
+ * Per call site cache of dispatch results (polymorphic inline cache).
+ *
+ * Which version of a closure is called only depends on the content of its
+ * dispatch table and the assumptions available at the call. A call site
+ * remembers the last few (table version, assumptions) pairs it saw, together
+ * with the version selected for them, and skips the dispatch on a hit. Since
+ * table versions are unique, entries never match a modified or different
+ * table. Closures created from the same function share their dispatch table,
+ * thus they also share cache entries.
+ *
+ * The cache lives in the extra pool of the calling code object.
+ */
+#pragma pack(push)
+#pragma pack(1)
+struct CallSiteCache
+    : public RirRuntimeObject<CallSiteCache, CALL_SITE_CACHE_MAGIC> {
+    static constexpr size_t NumEntries = 4;
+
+    Function* lookup(DispatchTable* table, const Assumptions& given) const {
+        for (size_t i = 0; i < NumEntries; ++i)
+            if (keys[i].version == table->version() && keys[i].given == given)
+                return Function::unpack(getEntry(i));
+        return nullptr;
+    }
+
+    void insert(DispatchTable* table, const Assumptions& given,
+                Function* fun) {
+        keys[next] = {table->version(), given};
+        setEntry(next, fun->container());
+        next = (next + 1) % NumEntries;
+    }
+
+    static CallSiteCache* create() {
+        SEXP s = Rf_allocVector(EXTERNALSXP, sizeof(CallSiteCache));
+        return new (INTEGER(s)) CallSiteCache;
+    }
+
+  private:
+    CallSiteCache()
+        : RirRuntimeObject(
+              // GC area are the cached versions at the end
+              (intptr_t)&versions - (intptr_t)this, NumEntries) {
+        // Table versions start at 1
+        for (auto& k : keys)
+            k.version = 0;
+    }
+
+    struct Key {
+        size_t version;
+        Assumptions given;
+    };
+    Key keys[NumEntries];
+    unsigned next = 0;
+
+    // !!! SEXPs traceable by the GC must be declared here !!!
+    SEXP versions[NumEntries];
+};
+#pragma pack(pop)
+
+} // namespace rir
+
+#endif
@@ -5,6 +5,7 @@
 #include "utils/Pool.h"
 
 #include <iomanip>
+#include <set>
 #include <sstream>
 
 namespace rir {
@@ -17,7 +18,8 @@ Code::Code(FunctionSEXP fun, unsigned src, unsigned cs, unsigned sourceLength,
           // GC area has only 1 pointer
           NumLocals),
       funInvocationCount(0), src(src), stackLength(0), localsCount(localsCnt),
-      codeSize(cs), srcLength(sourceLength), extraPoolSize(0) {
+      codeSize(cs), srcLength(sourceLength), extraPoolSize(0),
+      bindingCacheSize(1) {
     setEntry(0, R_NilValue);
 }
 
@@ -60,6 +62,44 @@ unsigned Code::getSrcIdxAt(const Opcode* pc, bool allowMissing) const {
     return sidx;
 }
 
+void Code::computeBindingCacheSize() {
+    // Lookups of functions and super assignment lookups of the same symbol
+    // get their own entries
+    std::set<std::pair<Opcode, BC::PoolIdx>> lookups;
+    for (Opcode* pc = code(); pc < endCode(); pc = BC::next(pc)) {
+        Opcode kind;
+        switch (*pc) {
+        case Opcode::ldvar_:
+        case Opcode::ldvar_for_update_:
+        case Opcode::ldvar_noforce_:
+        case Opcode::stvar_:
+        case Opcode::starg_:
+            kind = Opcode::ldvar_;
+            break;
+        case Opcode::ldvar_super_:
+        case Opcode::ldvar_noforce_super_:
+            kind = Opcode::ldvar_super_;
+            break;
+        case Opcode::ldfun_:
+            kind = Opcode::ldfun_;
+            break;
+        case Opcode::guard_fun_:
+            // Guards look up the function, just like ldfun_
+            lookups.emplace(
+                Opcode::ldfun_,
+                BC::decodeShallow(pc).immediate.guard_fun_args.name);
+            continue;
+        default:
+            continue;
+        }
+        lookups.emplace(kind, BC::decodeShallow(pc).immediate.pool);
+    }
+    bindingCacheSize = 1;
+    while (bindingCacheSize < 2 * lookups.size() &&
+           bindingCacheSize < MaxBindingCacheSize)
+        bindingCacheSize *= 2;
+}
+
 void Code::disassemble(std::ostream& out, const std::string& prefix) const {
     Opcode* pc = code();
     size_t label = 0;
@@ -113,13 +153,17 @@ void Code::disassemble(std::ostream& out, const std::string& prefix) const {
                 << "\n"
                 << std::setw(OFFSET_WIDTH) << "";
             break;
-        case Opcode::static_call_:
-            out << "   ; "
-                << dumpSexp(Pool::get(bc.immediate.staticCallFixedArgs.ast))
-                       .c_str()
-                << "\n"
-                << std::setw(OFFSET_WIDTH) << "";
+        case Opcode::static_call_: {
+            auto& args = bc.immediate.staticCallFixedArgs;
+            SEXP version = getExtraPoolEntry(args.version);
+            out << "   ; " << dumpSexp(Pool::get(args.ast)).c_str() << "\n"
+                << std::setw(OFFSET_WIDTH) << "" << "   ; "
+                << dumpSexp(getExtraPoolEntry(args.targetClosure)).c_str();
+            if (version != R_NilValue)
+                out << " (" << Function::unpack(version) << ")";
+            out << "\n" << std::setw(OFFSET_WIDTH) << "";
             break;
+        }
         default: {}
         }
 
@@ -154,6 +198,8 @@ void Code::print(std::ostream& out) const {
         << std::dec << " (hex)\n";
     out << std::left << std::setw(20) << "   Stack (o): " << stackLength
         << "\n";
+    out << std::left << std::setw(20) << "   Bindings: " << bindingCacheSize
+        << " (cache slots)\n";
     out << std::left << std::setw(20) << "   Code size: " << codeSize
         << "[B]\n";
 
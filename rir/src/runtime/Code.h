@@ -45,6 +45,8 @@ static unsigned pad4(unsigned sizeInBytes) {
 struct Code : public RirRuntimeObject<Code, CODE_MAGIC> {
     friend class FunctionWriter;
     friend class CodeVerifier;
+    friend class CodeCache;
+    friend class Pool;
     static constexpr size_t NumLocals = 1;
 
     Code() = delete;
@@ -81,6 +83,8 @@ struct Code : public RirRuntimeObject<Code, CODE_MAGIC> {
 
     unsigned extraPoolSize; /// Number of elements in the per code constant pool
 
+    unsigned bindingCacheSize; /// Slots of the interpreter's binding cache
+
     uint8_t data[]; /// the instructions
 
     /*
@@ -114,6 +118,10 @@ struct Code : public RirRuntimeObject<Code, CODE_MAGIC> {
         assert(i < extraPoolSize);
         return VECTOR_ELT(getEntry(0), i);
     }
+    void setExtraPoolEntry(unsigned i, SEXP v) {
+        assert(i < extraPoolSize);
+        SET_VECTOR_ELT(getEntry(0), i, v);
+    }
 
     Code* getPromise(size_t idx) const {
         return unpack(getExtraPoolEntry(idx));
@@ -129,6 +137,14 @@ struct Code : public RirRuntimeObject<Code, CODE_MAGIC> {
 
     unsigned getSrcIdxAt(const Opcode* pc, bool allowMissing) const;
 
+    // The interpreter caches the bindings of all variables (and functions)
+    // this code looks up. The cache is an open addressing table, big enough
+    // to hold all of them with a low load factor, but at most
+    // MaxBindingCacheSize entries. Needs to be recomputed whenever pool
+    // immediates change.
+    static constexpr unsigned MaxBindingCacheSize = 64;
+    void computeBindingCacheSize();
+
     void disassemble(std::ostream&, const std::string& promPrefix) const;
     void disassemble(std::ostream& out) const { disassemble(out, ""); }
     void print(std::ostream&) const;
@@ -3,6 +3,9 @@
 
 #include "Function.h"
 #include "RirRuntimeObject.h"
+#include "ir/Deoptimization.h"
+
+#include <algorithm>
 
 namespace rir {
 
@@ -13,6 +16,15 @@ typedef SEXP DispatchTableEntry;
 /*
  * A dispatch table (vtable) for functions.
  *
+ * The versions are kept in an R vector ordered by increasing number of
+ * assumptions, the vector is reallocated when it is full. Dispatch results
+ * are cached in a small hash table, keyed by the assumptions available at the
+ * call and the number of supplied arguments, which is flushed whenever the
+ * table changes.
+ *
+ * The table also counts the deopts of its optimized versions. After a deopt
+ * the function is not optimized again for a number of calls, which doubles
+ * with every further deopt.
  */
 #pragma pack(push)
 #pragma pack(1)
@@ -23,25 +35,51 @@ struct DispatchTable
 
     Function* get(size_t i) {
         assert(i < capacity());
-        return Function::unpack(getEntry(i));
+        return Function::unpack(VECTOR_ELT(entries(), i));
     }
 
-    Function* baseline() { return Function::unpack(getEntry(0)); }
+    Function* baseline() { return get(0); }
     Function* best() { return get(size() - 1); }
 
     void baseline(Function* f) {
         assert(f->signature().optimization ==
                FunctionSignature::OptimizationLevel::Baseline);
-        setEntry(0, f->container());
+        SET_VECTOR_ELT(entries(), 0, f->container());
         if (size() == 0)
             size_++;
+        changed();
     }
 
-    bool contains(const Assumptions& assumptions) {
+    // Changes whenever the content of the table changes. Versions are unique
+    // across all tables, thus (version, assumptions) fully determines the
+    // dispatch target.
+    size_t version() const { return version_; }
+
+    // Returns the cached dispatch target for a call with the given assumptions
+    // and number of supplied arguments, or nullptr.
+    Function* cachedTarget(const Assumptions& given, size_t nargs) {
+        auto& e = dispatchCache[cacheSlot(given, nargs)];
+        if (e.target != NO_TARGET && e.nargs == nargs && e.given == given)
+            return get(e.target);
+        return nullptr;
+    }
+
+    void cacheTarget(const Assumptions& given, size_t nargs, size_t target) {
+        assert(target < size());
+        dispatchCache[cacheSlot(given, nargs)] = {given, (uint32_t)nargs,
+                                                  (uint32_t)target};
+    }
+
+    // The optimized version with exactly these assumptions, or nullptr
+    Function* find(const Assumptions& assumptions) {
         for (size_t i = 1; i < size(); ++i)
             if (get(i)->signature().assumptions == assumptions)
-                return true;
-        return false;
+                return get(i);
+        return nullptr;
+    }
+
+    bool contains(const Assumptions& assumptions) {
+        return find(assumptions);
     }
 
     void remove(Code* funCode) {
@@ -53,24 +91,32 @@ struct DispatchTable
         if (i == size())
             return;
         get(i)->dead = true;
+        SEXP e = entries();
         for (; i < size() - 1; ++i) {
-            setEntry(i, getEntry(i + 1));
+            SET_VECTOR_ELT(e, i, VECTOR_ELT(e, i + 1));
         }
-        setEntry(i, nullptr);
+        SET_VECTOR_ELT(e, i, R_NilValue);
         size_--;
+        changed();
     }
 
     // insert function ordered by increasing number of assumptions
     void insert(Function* fun) {
-        // TODO: we might need to grow the DT here!
         assert(size() > 0);
         assert(fun->signature().optimization !=
                FunctionSignature::OptimizationLevel::Baseline);
         auto assumptions = fun->signature().assumptions;
+        changed();
         size_t i = 1;
         for (; i < size(); ++i) {
             if (get(i)->signature().assumptions == assumptions) {
-                setEntry(i, fun->container());
+                // Never replace a version by one of a lower tier. The old one
+                // is dead, such that inline caches let go of it.
+                if (get(i)->signature().optimization <=
+                    fun->signature().optimization) {
+                    get(i)->dead = true;
+                    SET_VECTOR_ELT(entries(), i, fun->container());
+                }
                 return;
             }
             if (!(get(i)->signature().assumptions < assumptions)) {
@@ -78,32 +124,20 @@ struct DispatchTable
             }
         }
         assert(!contains(fun->signature().assumptions));
-        if (size() == capacity()) {
-            std::cout << "Tried to insert into a full Dispatch table. Have: \n";
-            for (size_t i = 0; i < size(); ++i) {
-                auto e = getEntry(i);
-                std::cout << "* "
-                          << Function::unpack(e)->signature().assumptions
-                          << "\n";
-            }
-            std::cout << "\n";
-            std::cout << "Tried to insert: " << assumptions << "\n";
-            Rf_error("failed");
-            return;
-        }
+        if (size() == capacity())
+            grow(fun);
 
         size_++;
+        SEXP e = entries();
         for (size_t j = size() - 1; j > i; --j) {
-            setEntry(j, getEntry(j - 1));
+            SET_VECTOR_ELT(e, j, VECTOR_ELT(e, j - 1));
         }
-        setEntry(i, fun->container());
+        SET_VECTOR_ELT(e, i, fun->container());
 
 #ifdef DEBUG_DISPATCH
         std::cout << "Added version to DT, new order is: \n";
         for (size_t i = 0; i < size(); ++i) {
-            auto e = getEntry(i);
-            std::cout << "* " << Function::unpack(e)->signature().assumptions
-                      << "\n";
+            std::cout << "* " << get(i)->signature().assumptions << "\n";
         }
         std::cout << "\n";
 
@@ -117,25 +151,100 @@ struct DispatchTable
 #endif
     }
 
+    unsigned deoptCount(DeoptReason::Reason reason) const {
+        return deopts_[reason];
+    }
+
+    void recordDeopt(const DeoptReason& reason, unsigned warmup) {
+        deopts_[reason.reason]++;
+        unsigned total = 0;
+        for (auto n : deopts_)
+            total += n;
+        compileBackoff_ = warmup
+                          << std::min(total - 1, (unsigned)MAX_BACKOFF);
+    }
+
+    // Calls left until the closure may be optimized again
+    unsigned compileBackoff() const { return compileBackoff_; }
+
+    // True while optimizing is delayed, counts down one call
+    bool backingOff() {
+        if (!compileBackoff_)
+            return false;
+        compileBackoff_--;
+        return true;
+    }
+
     static DispatchTable* create(size_t capacity = 20) {
-        size_t size =
-            sizeof(DispatchTable) + (capacity * sizeof(DispatchTableEntry));
-        SEXP s = Rf_allocVector(EXTERNALSXP, size);
-        return new (INTEGER(s)) DispatchTable(capacity);
+        SEXP entries = PROTECT(Rf_allocVector(VECSXP, capacity));
+        SEXP s = Rf_allocVector(EXTERNALSXP, sizeof(DispatchTable));
+        auto table = new (INTEGER(s)) DispatchTable;
+        table->setEntry(0, entries);
+        UNPROTECT(1);
+        return table;
     }
 
-    size_t capacity() const { return info.gc_area_length; }
+    size_t capacity() const { return XLENGTH(entries()); }
 
   private:
-    DispatchTable() = delete;
-    explicit DispatchTable(size_t cap)
+    DispatchTable()
         : RirRuntimeObject(
-              // GC area starts at the end of the DispatchTable
-              sizeof(DispatchTable),
-              // GC area is just the pointers in the entry array
-              cap) {}
+              // GC area is just the vector of versions
+              (intptr_t)&entries_ - (intptr_t)this, 1) {
+        flushCache();
+    }
+
+    SEXP entries() const { return getEntry(0); }
+
+    // Doubles the capacity, fun is the version about to be inserted and
+    // needs to be protected during the allocation.
+    void grow(Function* fun) {
+        PROTECT(fun->container());
+        SEXP old = entries();
+        SEXP bigger = Rf_allocVector(VECSXP, 2 * XLENGTH(old));
+        for (size_t i = 0; i < size(); ++i)
+            SET_VECTOR_ELT(bigger, i, VECTOR_ELT(old, i));
+        setEntry(0, bigger);
+        UNPROTECT(1);
+    }
+
+    void changed() {
+        version_ = freshVersion();
+        flushCache();
+    }
+
+    static size_t freshVersion() {
+        static size_t counter = 0;
+        return ++counter;
+    }
+
+    static constexpr unsigned MAX_BACKOFF = 10;
+    static constexpr size_t CACHE_SIZE = 16;
+    static constexpr uint32_t NO_TARGET = (uint32_t)-1;
+
+    struct CacheEntry {
+        Assumptions given;
+        uint32_t nargs;
+        uint32_t target;
+    };
+
+    static size_t cacheSlot(const Assumptions& given, size_t nargs) {
+        return (std::hash<Assumptions>()(given) + nargs * 31) % CACHE_SIZE;
+    }
+
+    void flushCache() {
+        for (auto& e : dispatchCache)
+            e.target = NO_TARGET;
+    }
 
     size_t size_ = 0;
+    size_t version_ = freshVersion();
+    CacheEntry dispatchCache[CACHE_SIZE];
+    unsigned deopts_[DeoptReason::NumReasons] = {};
+    unsigned compileBackoff_ = 0;
+
+    // !!! SEXPs traceable by the GC must be declared here !!!
+    SEXP entries_;
 };
 #pragma pack(pop)
 } // namespace rir
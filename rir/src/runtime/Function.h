@@ -39,7 +39,7 @@ struct Function : public RirRuntimeObject<Function, FUNCTION_MAGIC> {
     friend class FunctionCodeIterator;
     friend class ConstFunctionCodeIterator;
 
-    static constexpr size_t NUM_PTRS = 1;
+    static constexpr size_t NUM_PTRS = 2;
 
     Function(size_t functionSize, SEXP body_,
              const std::vector<SEXP>& defaultArgs,
@@ -50,7 +50,8 @@ struct Function : public RirRuntimeObject<Function, FUNCTION_MAGIC> {
               NUM_PTRS + defaultArgs.size()),
           size(functionSize), deopt(false), markOpt(false),
           unoptimizable(false), uninlinable(false), dead(false),
-          numArgs(defaultArgs.size()), signature_(signature) {
+          noOsr(false), numArgs(defaultArgs.size()), bindingsCheckedAt(0),
+          signature_(signature) {
         for (size_t i = 0; i < numArgs; ++i)
             setEntry(NUM_PTRS + i, defaultArgs[i]);
         body(body_);
@@ -59,6 +60,11 @@ struct Function : public RirRuntimeObject<Function, FUNCTION_MAGIC> {
     Code* body() { return Code::unpack(getEntry(0)); }
     void body(SEXP body) { setEntry(0, body); }
 
+    // Bindings of builtins this version relies on, instead of guarding them.
+    // A vector of (symbol, environment, expected value) triples, or null.
+    SEXP bindingDependencies() const { return getEntry(1); }
+    void bindingDependencies(SEXP deps) { setEntry(1, deps); }
+
     void disassemble(std::ostream&);
 
     Code* defaultArg(size_t i) const {
@@ -78,16 +84,21 @@ struct Function : public RirRuntimeObject<Function, FUNCTION_MAGIC> {
     unsigned unoptimizable : 1;
     unsigned uninlinable : 1;
     unsigned dead : 1;
+    unsigned noOsr : 1;
 
     unsigned numArgs;
 
+    // Value of the interpreter's global binding version when the binding
+    // dependencies were last found to hold
+    size_t bindingsCheckedAt;
+
     const FunctionSignature& signature() const { return signature_; }
 
   private:
     FunctionSignature signature_; /// pointer to this version's signature
 
     // !!! SEXPs traceable by the GC must be declared here !!!
-    // locals contains: origin, next, body
+    // locals contains: body, binding dependencies
     CodeSEXP locals[NUM_PTRS];
     CodeSEXP defaultArg_[];
 };
@@ -16,8 +16,10 @@ struct FunctionSignature {
         CalleeCreated,
     };
 
+    // Ordered from the cheapest to the most optimized tier
     enum class OptimizationLevel {
         Baseline,
+        Quick,
         Optimized,
         Contextual,
     };
@@ -70,10 +72,14 @@ struct FunctionSignature {
             }
             out << ") ";
         }
+        if (optimization == OptimizationLevel::Quick)
+            out << "quick ";
         if (optimization != OptimizationLevel::Baseline)
             out << "optimized code ";
         if (envCreation == Environment::CallerProvided)
             out << "needsEnv ";
+        if (isContinuation())
+            out << "continuation@" << osrEntry << " ";
         if (!assumptions.empty()) {
             out << "| assumptions: [" << assumptions << "]";
         }
@@ -87,6 +93,8 @@ struct FunctionSignature {
         : envCreation(envCreation), optimization(optimization),
           assumptions(assumptions) {}
 
+    bool isContinuation() const { return osrEntry != NO_OSR_ENTRY; }
+
     size_t formalNargs() const { return arguments.size(); }
     size_t expectedNargs() const {
         return arguments.size() - assumptions.numMissing();
@@ -96,6 +104,15 @@ struct FunctionSignature {
     const OptimizationLevel optimization;
     std::vector<ArgumentType> arguments;
     const Assumptions assumptions;
+
+    // Surplus arguments are matched by the ... formal
+    bool hasDotsFormals = false;
+
+    // Continuations (see OSR in the interpreter) do not start at the beginning
+    // of the function, but at this pc offset into the baseline body. Their
+    // arguments are the operand stack of the baseline frame at that point.
+    static constexpr unsigned NO_OSR_ENTRY = (unsigned)-1;
+    unsigned osrEntry = NO_OSR_ENTRY;
 };
 
 } // namespace rir
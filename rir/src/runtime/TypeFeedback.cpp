@@ -11,4 +11,14 @@ SEXP ObservedCallees::getTarget(const Code* code, size_t pos) const {
     return code->getExtraPoolEntry(targets[pos]);
 }
 
+SEXP ObservedValues::getValue(const Code* code) const {
+    assert(stableValue);
+    return code->getExtraPoolEntry(value);
+}
+
+SEXP ObservedValues::getClass(const Code* code) const {
+    assert(stableClass);
+    return code->getExtraPoolEntry(klass);
+}
+
 } // namespace rir
@@ -51,25 +51,49 @@ static_assert(sizeof(ObservedCallees) == 4 * sizeof(uint32_t),
 
 struct ObservedValues {
     static constexpr unsigned MaxTypes = 3;
-    uint8_t numTypes;
+    static constexpr unsigned LengthBits = 28;
+    static constexpr unsigned LengthOverflow = (1 << LengthBits) - 1;
 
+    uint8_t numTypes;
     std::array<ObservedType, MaxTypes> seen;
 
-    ObservedValues() : numTypes(0) {}
-
-    RIR_INLINE void record(SEXP e) {
-        ObservedType type(e);
-        if (numTypes < MaxTypes) {
-            int i = 0;
-            for (; i < numTypes; ++i)
-                if (seen[i] == type)
-                    break;
-            if (i == numTypes)
-                seen[numTypes++] = type;
+    // Longest vector seen, saturating at LengthOverflow
+    uint32_t maxLength : LengthBits;
+    // NA is only looked for in scalars, longer vectors always set it
+    uint32_t maybeNA : 1;
+    // All values seen were the same simple scalar, respectively had the same
+    // class attribute. Those are stored in the code extra pool, the entries
+    // below are only valid if the bits are set.
+    uint32_t stableValue : 1;
+    uint32_t stableClass : 1;
+    uint32_t unused : 1;
+    uint32_t value;
+    uint32_t klass;
+
+    ObservedValues()
+        : numTypes(0), maxLength(0), maybeNA(0), stableValue(0),
+          stableClass(0), unused(0), value(0), klass(0) {}
+
+    RIR_INLINE void record(Code* code, SEXP e);
+    SEXP getValue(const Code* code) const;
+    SEXP getClass(const Code* code) const;
+
+    // Fill the remaining slots with "anything", such that the feedback is
+    // considered polymorphic
+    void widen() {
+        for (; numTypes < MaxTypes; ++numTypes) {
+            auto& t = seen[numTypes];
+            t.sexptype = ANYSXP;
+            t.scalar = false;
+            t.object = true;
+            t.attribs = true;
         }
+        maxLength = LengthOverflow;
+        maybeNA = true;
+        stableValue = stableClass = false;
     }
 };
-static_assert(sizeof(ObservedValues) == sizeof(uint32_t),
+static_assert(sizeof(ObservedValues) == 4 * sizeof(uint32_t),
               "Size needs to fit inside a record_ bc immediate args");
 
 #pragma pack(pop)
@@ -10,6 +10,110 @@ ObservedType::ObservedType(SEXP s)
     : sexptype((uint8_t)TYPEOF(s)), scalar(IS_SCALAR(s, TYPEOF(s))),
       object(OBJECT(s)), attribs(ATTRIB(s) != R_NilValue) {}
 
+static RIR_INLINE bool isVectorType(SEXPTYPE t) {
+    switch (t) {
+    case LGLSXP:
+    case INTSXP:
+    case REALSXP:
+    case CPLXSXP:
+    case STRSXP:
+    case RAWSXP:
+    case VECSXP:
+    case EXPRSXP:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static RIR_INLINE bool isNAScalar(SEXP s) {
+    switch (TYPEOF(s)) {
+    case LGLSXP:
+        return LOGICAL(s)[0] == NA_LOGICAL;
+    case INTSXP:
+        return INTEGER(s)[0] == NA_INTEGER;
+    case REALSXP:
+        return ISNAN(REAL(s)[0]);
+    case CPLXSXP:
+        return ISNAN(COMPLEX(s)[0].r) || ISNAN(COMPLEX(s)[0].i);
+    case STRSXP:
+        return STRING_ELT(s, 0) == NA_STRING;
+    default:
+        return false;
+    }
+}
+
+// Only simple logical, integer and real scalars are recorded as constants,
+// they are compared by value
+static RIR_INLINE bool isConstantCandidate(SEXP s) {
+    return IS_SIMPLE_SCALAR(s, LGLSXP) || IS_SIMPLE_SCALAR(s, INTSXP) ||
+           IS_SIMPLE_SCALAR(s, REALSXP);
+}
+
+static RIR_INLINE bool sameConstant(SEXP a, SEXP b) {
+    if (TYPEOF(a) != TYPEOF(b))
+        return false;
+    switch (TYPEOF(a)) {
+    case LGLSXP:
+        return LOGICAL(a)[0] == LOGICAL(b)[0];
+    case INTSXP:
+        return INTEGER(a)[0] == INTEGER(b)[0];
+    case REALSXP:
+        return memcmp(REAL(a), REAL(b), sizeof(double)) == 0;
+    default:
+        assert(false);
+        return false;
+    }
+}
+
+void ObservedValues::record(Code* code, SEXP e) {
+    bool first = numTypes == 0;
+
+    ObservedType type(e);
+    if (numTypes < MaxTypes) {
+        int i = 0;
+        for (; i < numTypes; ++i)
+            if (seen[i] == type)
+                break;
+        if (i == numTypes)
+            seen[numTypes++] = type;
+    }
+
+    if (isVectorType(TYPEOF(e))) {
+        R_xlen_t length = XLENGTH(e);
+        if (length > (R_xlen_t)maxLength)
+            maxLength = length < LengthOverflow ? length : LengthOverflow;
+        if (length > 1 || (length == 1 && isNAScalar(e)))
+            maybeNA = true;
+    }
+
+    if (first) {
+        if (isConstantCandidate(e)) {
+            value = code->addExtraPoolEntry(e);
+            stableValue = true;
+        }
+        if (OBJECT(e)) {
+            klass = code->addExtraPoolEntry(Rf_getAttrib(e, R_ClassSymbol));
+            stableClass = true;
+        }
+        return;
+    }
+
+    if (stableValue &&
+        (!isConstantCandidate(e) || !sameConstant(e, getValue(code))))
+        stableValue = false;
+    if (stableClass) {
+        if (!OBJECT(e)) {
+            stableClass = false;
+        } else {
+            SEXP k = Rf_getAttrib(e, R_ClassSymbol);
+            SEXP old = getClass(code);
+            if (k != old && !R_compute_identical(k, old, 16))
+                stableClass = false;
+        }
+    }
+}
+
 void ObservedCallees::record(Code* caller, SEXP callee) {
     if (taken < CounterOverflow)
         taken++;
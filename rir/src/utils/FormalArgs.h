@@ -10,6 +10,7 @@ class FormalArgs {
     std::vector<SEXP> names_;
     std::vector<SEXP> defaultArgs_;
     bool hasDefaultArgs_, hasDots_;
+    size_t dotsPosition_;
     SEXP original_;
 
   public:
@@ -19,14 +20,19 @@ class FormalArgs {
     explicit FormalArgs(SEXP formals)
         : hasDefaultArgs_(false), hasDots_(false), original_(formals) {
         for (auto it = RList(formals).begin(); it != RList::end(); ++it) {
+            if (it.tag() == R_DotsSymbol && !hasDots_) {
+                hasDots_ = true;
+                dotsPosition_ = names_.size();
+            }
+
             names_.push_back(it.tag());
             defaultArgs_.push_back(*it);
 
-            if (it.tag() == R_DotsSymbol)
-                hasDots_ = true;
             if (*it != R_MissingArg)
                 hasDefaultArgs_ = true;
         }
+        if (!hasDots_)
+            dotsPosition_ = names_.size();
     }
 
     const std::vector<SEXP>& names() const { return names_; }
@@ -37,6 +43,13 @@ class FormalArgs {
 
     bool hasDots() const { return hasDots_; }
 
+    // Index of the ... formal, nargs() if there is none
+    size_t dotsPosition() const { return dotsPosition_; }
+
+    // Positional arguments are matched up to the ... formal, which takes all
+    // the remaining ones. Formals after it are only ever matched by name.
+    bool isPositional(size_t i) const { return i <= dotsPosition_; }
+
     size_t nargs() const { return names_.size(); }
 
     SEXP original() const { return original_; }
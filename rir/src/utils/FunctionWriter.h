@@ -67,7 +67,7 @@ class FunctionWriter {
         unsigned codeSize = originalCodeSize - nops;
         unsigned totalSize = Code::size(codeSize, sources.size());
 
-        auto src = src_pool_add(globalContext(), ast);
+        auto src = Pool::insertSrc(ast);
         SEXP store = Rf_allocVector(EXTERNALSXP, totalSize);
         void* payload = DATAPTR(store);
         Code* code = new (payload)
@@ -187,6 +187,7 @@ class FunctionWriter {
         }
 
         assert(numberOfSources == sources.size());
+        Pool::retain(code);
 
         return code;
     }
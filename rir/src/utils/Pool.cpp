@@ -2,12 +2,43 @@
 #include "R/r.h"
 #include "R/Protect.h"
 #include "ir/BC.h"
+#include "runtime/Code.h"
 
 namespace rir {
 
 std::unordered_map<double, unsigned> Pool::numbers;
 std::unordered_map<int, unsigned> Pool::ints;
 std::unordered_map<SEXP, size_t> Pool::contents;
+Pool::Slots Pool::constants;
+Pool::Slots Pool::sources;
+
+void Pool::Slots::retain(unsigned i) {
+    // Slot 0 is reserved
+    if (i == 0)
+        return;
+    if (i >= refs.size())
+        refs.resize(i + 1, 0);
+    refs[i]++;
+}
+
+bool Pool::Slots::release(unsigned i) {
+    if (i == 0)
+        return false;
+    assert(i < refs.size() && refs[i] > 0);
+    return --refs[i] == 0;
+}
+
+unsigned Pool::Slots::reuse(SEXP e, ResizeableList* l, size_t index) {
+    if (!unused.empty()) {
+        unsigned i = unused.back();
+        unused.pop_back();
+        rl_set(l, i, e);
+        return i;
+    }
+    unsigned i = rl_length(l);
+    rl_append(l, e, globalContext()->list, index);
+    return i;
+}
 
 BC::PoolIdx Pool::getNum(double n) {
     if (numbers.count(n))
@@ -19,7 +50,7 @@ BC::PoolIdx Pool::getNum(double n) {
     REAL(s)[0] = n;
     SET_NAMED(s, 2);
 
-    size_t i = cp_pool_add(globalContext(), s);
+    size_t i = add(s);
     assert(i < BC::MAX_POOL_IDX);
 
     numbers[n] = i;
@@ -36,10 +67,74 @@ BC::PoolIdx Pool::getInt(int n) {
     INTEGER(s)[0] = n;
     SET_NAMED(s, 2);
 
-    size_t i = cp_pool_add(globalContext(), s);
+    size_t i = add(s);
     assert(i < BC::MAX_POOL_IDX);
 
     ints[n] = i;
     return i;
 }
+
+template <typename F>
+static void forEachConstant(Code* code, F f) {
+    std::vector<size_t> offsets;
+    for (Opcode* pc = code->code(); pc < code->endCode(); pc = BC::next(pc)) {
+        offsets.clear();
+        BC::poolImmediates(pc, offsets);
+        for (auto o : offsets) {
+            Immediate idx;
+            memcpy(&idx, (uint8_t*)pc + o, sizeof(Immediate));
+            f(idx);
+        }
+    }
+}
+
+void Pool::retain(Code* code) {
+    forEachConstant(code, [](BC::PoolIdx i) { constants.retain(i); });
+    sources.retain(code->src);
+    for (unsigned i = 0; i < code->srcLength; ++i)
+        sources.retain(code->srclist()[i].srcIdx);
+    R_RegisterCFinalizerEx(code->container(), release, FALSE);
+}
+
+void Pool::release(SEXP container) {
+    auto ctx = globalContext();
+    Code* code = Code::unpack(container);
+    forEachConstant(code, releaseConstant);
+    auto releaseSrc = [&](unsigned i) {
+        if (!sources.release(i))
+            return;
+        src_pool_set(ctx, i, R_NilValue);
+        sources.unused.push_back(i);
+    };
+    releaseSrc(code->src);
+    for (unsigned i = 0; i < code->srcLength; ++i)
+        releaseSrc(code->srclist()[i].srcIdx);
+}
+
+void Pool::releaseConstant(BC::PoolIdx i) {
+    if (!constants.release(i))
+        return;
+
+    // The same value might be in the pool more than once (eg. a number which
+    // was inserted as a constant and by getNum), only drop the entries which
+    // refer to this slot
+    SEXP e = get(i);
+    if (TYPEOF(e) == SYMSXP)
+        return;
+    auto c = contents.find(e);
+    if (c != contents.end() && c->second == i)
+        contents.erase(c);
+    if (TYPEOF(e) == REALSXP && XLENGTH(e) == 1) {
+        auto n = numbers.find(REAL(e)[0]);
+        if (n != numbers.end() && n->second == i)
+            numbers.erase(n);
+    }
+    if (TYPEOF(e) == INTSXP && XLENGTH(e) == 1) {
+        auto n = ints.find(INTEGER(e)[0]);
+        if (n != ints.end() && n->second == i)
+            ints.erase(n);
+    }
+    cp_pool_set(globalContext(), i, R_NilValue);
+    constants.unused.push_back(i);
+}
 }
@@ -11,15 +11,51 @@
 #include "R/r.h"
 
 #include <unordered_map>
+#include <vector>
 
 #include "interpreter/instance.h"
 
 namespace rir {
 
+struct Code;
+
+/** The constant pool (and source pool), shared by all code objects.
+
+ Entries are reference counted by the code objects using them. Once the
+ bytecode of a code object is final, retain registers it, and its finalizer
+ releases the entries again when the code is collected. The slots of released
+ entries are reused by later inserts. Indices are baked into the bytecode, thus
+ the pool cannot be compacted by moving entries.
+
+ Symbols are never collected by R and the interpreter inserts argument names at
+ runtime, thus their slots are kept. Entries never referenced by a code object
+ (eg. constants of PIR instructions which were optimized away) are kept too,
+ thus indices handed out while compiling stay valid until the code is written.
+ This relies on finalizers not running while compiling.
+ */
 class Pool {
+    struct Slots {
+        std::vector<unsigned> refs;
+        std::vector<unsigned> unused;
+
+        void retain(unsigned i);
+        // Returns true if no code references the entry anymore
+        bool release(unsigned i);
+        unsigned reuse(SEXP e, ResizeableList* l, size_t index);
+    };
+
     static std::unordered_map<double, BC::PoolIdx> numbers;
     static std::unordered_map<int, BC::PoolIdx> ints;
     static std::unordered_map<SEXP, size_t> contents;
+    static Slots constants;
+    static Slots sources;
+
+    static BC::PoolIdx add(SEXP e) {
+        auto ctx = globalContext();
+        return constants.reuse(e, &ctx->cp, CONTEXT_INDEX_CP);
+    }
+
+    static void release(SEXP code);
 
   public:
     static BC::PoolIdx insert(SEXP e) {
@@ -27,28 +63,35 @@ class Pool {
             return contents.at(e);
 
         SET_NAMED(e, 2);
-        size_t i = cp_pool_add(globalContext(), e);
+        auto i = add(e);
         contents[e] = i;
         return i;
     }
 
-    static BC::PoolIdx makeSpace() {
-        size_t i = cp_pool_add(globalContext(), R_NilValue);
-        return i;
-    }
-
-    static void patch(BC::PoolIdx idx, SEXP e) {
-        assert(get(idx) == R_NilValue || get(idx) == e);
-        SET_NAMED(e, 2);
-        cp_pool_set(globalContext(), idx, e);
-        if (!contents.count(e))
-            contents[e] = idx;
-    }
-
     static BC::PoolIdx getNum(double n);
     static BC::PoolIdx getInt(int n);
 
     static SEXP get(BC::PoolIdx i) { return cp_pool_at(globalContext(), i); }
+
+    static unsigned insertSrc(SEXP ast) {
+        auto ctx = globalContext();
+        return sources.reuse(ast, &ctx->src, CONTEXT_INDEX_SRC);
+    }
+
+    static void retain(Code* code);
+
+    // For users of constant pool entries other than code objects (eg. PIR
+    // kept across compilations)
+    static void retainConstant(BC::PoolIdx i) { constants.retain(i); }
+    static void releaseConstant(BC::PoolIdx i);
+
+    // Number of slots in use (including the reserved slot 0)
+    static size_t size() {
+        return cp_pool_length(globalContext()) - constants.unused.size();
+    }
+    static size_t srcSize() {
+        return src_pool_length(globalContext()) - sources.unused.size();
+    }
 };
 }
 
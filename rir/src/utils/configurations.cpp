@@ -52,6 +52,7 @@ void Configurations::defaultOptimizations() {
         optimizations.push_back(new pir::Cleanup());
         optimizations.push_back(new pir::DelayInstr());
         optimizations.push_back(new pir::HoistInstruction());
+        optimizations.push_back(new pir::LoopInvariantCodeMotion());
         optimizations.push_back(new pir::ElideEnv());
         optimizations.push_back(new pir::DelayEnv());
         optimizations.push_back(new pir::Cleanup());
@@ -92,6 +93,7 @@ void Configurations::defaultOptimizations() {
     //
     // After this phase it is no longer possible to add assumptions at any point
     optimizations.push_back(new pir::CleanupCheckpoints());
+    optimizations.push_back(new pir::BoundsCheckElimination());
     for (size_t i = 0; i < 2; ++i)
         addDefaultOpt();
 
@@ -108,11 +110,26 @@ void Configurations::defaultOptimizations() {
 
     // ==== Phase 4) Final round of default opts
     for (size_t i = 0; i < 3; ++i) {
+        optimizations.push_back(new pir::ScalarReplacement());
         addDefaultOpt();
+        optimizations.push_back(new pir::BoundsCheckElimination());
         optimizations.push_back(new pir::CleanupCheckpoints());
     }
 
     phasemarker("Phase 4: finished");
 }
 
+void Configurations::defaultQuickOptimizations() {
+    // Only the passes which remove most of the interpretation overhead, no
+    // speculation and no inlining. Functions which stay hot get recompiled
+    // with the full pipeline later.
+    quickOptimizations.push_back(new pir::PhaseMarker("Initial"));
+    quickOptimizations.push_back(new pir::ScopeResolution());
+    quickOptimizations.push_back(new pir::ForceDominance());
+    quickOptimizations.push_back(new pir::EagerCalls());
+    quickOptimizations.push_back(new pir::Cleanup());
+    quickOptimizations.push_back(new pir::CleanupCheckpoints());
+    quickOptimizations.push_back(new pir::PhaseMarker("Quick: finished"));
+}
+
 } // namespace rir
@@ -10,18 +10,29 @@ namespace rir {
 
 class Configurations {
   public:
-    Configurations() { parseINIFile(); }
+    Configurations() {
+        parseINIFile();
+        defaultQuickOptimizations();
+    }
     const std::vector<const pir::PirTranslator*>& pirOptimizations() {
         return optimizations;
     }
+    // Short pass list for the quick tier, see Parameter::OPT_WARMUP
+    const std::vector<const pir::PirTranslator*>& pirQuickOptimizations() {
+        return quickOptimizations;
+    }
     ~Configurations() {
         for (auto o : optimizations)
             delete o;
+        for (auto o : quickOptimizations)
+            delete o;
     }
 
   private:
     std::vector<const pir::PirTranslator*> optimizations;
+    std::vector<const pir::PirTranslator*> quickOptimizations;
     void defaultOptimizations();
+    void defaultQuickOptimizations();
     void parseINIFile();
 };
 